@@ -1,21 +1,72 @@
 #include <codegen.hpp>
+#include <constfold.hpp>
+#include <emitter.hpp>
+#include <inliner.hpp>
+#include <irgen.hpp>
+#include <peephole.hpp>
+#include <strength.hpp>
 
 /*
  * compute sizes and offsets and place them in the symbol tables and entries
  * */
 void computeSizes(ASTNode &root) {
+    // a struct is sized once its parents and member types are, so no size is computed twice
+    for (auto *structTable : structsInDependencyOrder(root.symbolTable)) {
+        sizeofTable(structTable, true);
+        layoutStruct(structTable);
+    }
+
     ComputeMemSizeVisitor memSizeVisitor = ComputeMemSizeVisitor();
     root.accept(memSizeVisitor);
 }
 
 
-void generateCode(ASTNode &root, std::ostream &out) {
-    std::ostringstream moonExecCode;
-    std::ostringstream moonDataCode;
-    CodeGenerationVisitor codeGenVisitor = CodeGenerationVisitor(moonExecCode, moonDataCode);
-    root.accept(codeGenVisitor);
+/*
+ * lower the program to IR, optimize it, emit moon code from it and clean that up
+ * */
+static void lowerProgram(ASTNode &root, const CodegenOptions &options, MoonEmitter &emitter) {
+    IRProgram program;
+    IRGenerationVisitor irGenerationVisitor = IRGenerationVisitor(program);
+    root.accept(irGenerationVisitor);
+
+    if (options.inlineThreshold > 0) {
+        inlineCalls(program, options.inlineThreshold, options.inlineReport);
+    }
+    for (auto &function : program.functions) {
+        if (options.foldConstants) foldConstants(*function);
+        if (options.reduceStrength) reduceStrength(*function);
+    }
+
+    if (options.dumpIR != nullptr) {
+        dumpIR(program, *options.dumpIR);
+    }
+
+    emitter.emit(program);
 
-    out << moonExecCode.str() << moonDataCode.str() << std::endl;
+    if (options.peepholeWindow > 0) {
+        // the emitter reads a value loaded in a scratch register once
+        PeepholeContext context{options.peepholeWindow, 1u << 10 | 1u << 11};
+        std::vector<size_t> hits;
+        peephole(emitter.code.instrs, context, hits);
+        if (options.peepholeReport != nullptr) {
+            for (size_t r = 0; r < peepholeRules.size(); r++) {
+                *options.peepholeReport << peepholeRules[r].name << ": " << hits[r] << "\n";
+            }
+        }
+    }
+}
+
+void generateCode(ASTNode &root, std::ostream &out, const CodegenOptions &options) {
+    MoonEmitter emitter(options.callingConvention);
+    lowerProgram(root, options, emitter);
+    printMoon(emitter.code, out);
+    out.flush();
+}
+
+void generateCode(ASTNode &root, int fd, const CodegenOptions &options) {
+    MoonEmitter emitter(options.callingConvention);
+    lowerProgram(root, options, emitter);
+    writeMoon(emitter.code, fd);
 }
 
 
@@ -38,10 +89,7 @@ int sizeofTable(SymbolTable *table, bool isStruct) {
         // recurse through inherited structs
         std::vector<std::string> inheritNames = table->lookupAllNamesOfKind("inherit");
         if (!inheritNames.empty()) {
-            auto *globalScope = table;
-            while (globalScope->upperScope) {
-                globalScope = globalScope->upperScope;
-            }
+            auto *globalScope = table->global;
 
             for (const auto &name : inheritNames) {
                 auto *structEntry = globalScope->lookup(name, "struct");
@@ -49,10 +97,10 @@ int sizeofTable(SymbolTable *table, bool isStruct) {
             }
         }
 
-        //table->size = structSize;
+        table->size = structSize;
         return structSize;
     } else  {
-        // params, vars and tempvars ; i.e. all entries
+        // params and vars ; i.e. all entries
         std::vector<SymbolTableEntry*> allEntries = table->symList;
         int funcSize = 0;
         for (auto *entry : allEntries) {
@@ -64,93 +112,87 @@ int sizeofTable(SymbolTable *table, bool isStruct) {
 }
 
 /*
- * sizeof entry
+ * byte offsets of the data members of a struct subobject starting at base: its own members in declaration order, then
+ * the subobject of each struct it inherits from, in the same order as sizeofTable counts them
  * */
-int sizeofEntry(SymbolTableEntry *entry, SymbolTable *currentScope) {
-    if (entry->size > 0) {
-        return entry->size;
+static void layoutSubobject(SymbolTable *structTable, SymbolTable *subobject, int base) {
+    int offset = base;
+    for (auto *entry : subobject->lookupAllOfKind("var")) {
+        auto *member = structTable->lookupMember(entry->name);
+        // a member hidden by one declared earlier along the linearization keeps no offset of its own
+        if (member->entry == entry && member->offset < 0) {
+            member->offset = offset;
+        }
+        offset += sizeofEntry(entry, subobject);
     }
 
-    if (entry->type == "integer") {
-        entry->size = INT_SIZE;
-        return INT_SIZE;
-    } else if (entry->type == "float") {
-        entry->size = FLOAT_SIZE;
-        return FLOAT_SIZE;
-    } else if (entry->type.find('[') == std::string::npos) {
-        auto *globalScope = currentScope;
-        while (globalScope->upperScope) {
-            globalScope = globalScope->upperScope;
-        }
+    for (const auto &name : subobject->lookupAllNamesOfKind("inherit")) {
+        auto *structEntry = structTable->global->lookup(name, "struct");
+        layoutSubobject(structTable, structEntry->link, offset);
+        offset += sizeofTable(structEntry->link, true);
+    }
+}
 
-        auto *structEntry = globalScope->lookup(entry->type, "struct");
-        entry->size = sizeofTable(structEntry->link, true);
+/*
+ * fill in the offset of every member slot of a struct, inherited members included
+ * */
+void layoutStruct(SymbolTable *structTable) {
+    layoutSubobject(structTable, structTable, 0);
+}
 
-        return entry->size;
+/*
+ * byte offset of the subobject of an ancestor within a struct, -1 if the struct does not inherit from it ; the first
+ * one in layout order when it is inherited along several paths
+ * */
+int subobjectOffset(SymbolTable *structTable, SymbolTable *ancestor) {
+    if (structTable == ancestor) {
+        return 0;
     }
 
-    // must be an array
-    int dimSize = getDimsSize(entry->type);
-    std::string trimmedType = trimVariableType(entry->type);
-
-    if (trimmedType == "integer") {
-        int size = INT_SIZE * dimSize;
-        entry->size = size;
-        return size;
-    } else if (trimmedType == "float") {
-        int size = FLOAT_SIZE * dimSize;
-        entry->size = size;
-        return size;
-    } else {
-        auto *globalScope = currentScope;
-        while (globalScope->upperScope) {
-            globalScope = globalScope->upperScope;
+    int offset = 0;
+    for (auto *entry : structTable->lookupAllOfKind("var")) {
+        offset += sizeofEntry(entry, structTable);
+    }
+    for (const auto &name : structTable->lookupAllNamesOfKind("inherit")) {
+        auto *structEntry = structTable->global->lookup(name, "struct");
+        int inner = subobjectOffset(structEntry->link, ancestor);
+        if (inner >= 0) {
+            return offset + inner;
         }
+        offset += sizeofTable(structEntry->link, true);
+    }
+    return -1;
+}
 
-        auto *structEntry = globalScope->lookup(trimmedType, "struct");
-        int tableSize = sizeofTable(structEntry->link, true);
-        entry->size = tableSize * dimSize;
-        return tableSize * dimSize;
+/*
+ * sizeof entry
+ * */
+int sizeofEntry(SymbolTableEntry *entry, SymbolTable *currentScope) {
+    if (entry->size > 0) {
+        return entry->size;
     }
+
+    entry->size = sizeofType(entry->type, currentScope);
+    return entry->size;
 }
 
 /*
  * sizeof type
  * */
-int sizeofType(std::string &type, SymbolTable *currentScope) {
-    if (type == "void") {
+int sizeofType(TypeId type, SymbolTable *currentScope) {
+    if (type == TypeId::voidType()) {
         return 4; // idk
-    } else if (type == "integer") {
-        return INT_SIZE;
-    } else if (type == "float") {
-        return FLOAT_SIZE;
-    } else if (type.find('[') == std::string::npos) {
-        auto *globalScope = currentScope;
-        while (globalScope->upperScope) {
-            globalScope = globalScope->upperScope;
-        }
-
-        auto *structEntry = globalScope->lookup(type, "struct");
-        return sizeofTable(structEntry->link, true);
     }
 
-    // must be an array
-    int dimSize = getDimsSize(type);
-    std::string trimmedType = trimVariableType(type);
-    if (trimmedType == "integer") {
-        int size = INT_SIZE * dimSize;
-        return size;
-    } else if (trimmedType == "float") {
-        int size = FLOAT_SIZE * dimSize;
-        return size;
-    } else {
-        auto *globalScope = currentScope;
-        while (globalScope->upperScope) {
-            globalScope = globalScope->upperScope;
-        }
+    const TypeInfo &info = type.info();
+    int elementSize = info.baseSize;
+    if (elementSize == 0) {
+        // struct element type, its size is the size of its table
+        auto *globalScope = currentScope->global;
 
-        auto *structEntry = globalScope->lookup(trimmedType, "struct");
-        int tableSize = sizeofTable(structEntry->link, true);
-        return tableSize * dimSize;
+        auto *structEntry = globalScope->lookup(type.element(), "struct");
+        elementSize = sizeofTable(structEntry->link, true);
     }
+
+    return elementSize * info.elementCount;
 }
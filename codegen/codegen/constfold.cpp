@@ -0,0 +1,280 @@
+#include <constfold.hpp>
+#include <climits>
+#include <unordered_map>
+
+namespace {
+
+/* what is known of a virtual register at a point: nothing yet, its constant value, or that it varies */
+struct Value {
+    enum Kind : unsigned char { Undefined, Constant, Varying };
+
+    Kind kind;
+    int constant;
+
+    bool operator==(const Value &other) const {
+        return kind == other.kind && (kind != Constant || constant == other.constant);
+    }
+
+    bool operator!=(const Value &other) const {
+        return !(*this == other);
+    }
+};
+
+using State = std::vector<Value>;
+
+const Value undefined{Value::Undefined, 0};
+const Value varying{Value::Varying, 0};
+
+Value meet(const Value &a, const Value &b) {
+    if (a.kind == Value::Undefined) return b;
+    if (b.kind == Value::Undefined) return a;
+    return a == b ? a : varying;
+}
+
+/* wraps around like moon does, and refuses what moon would trap on */
+bool evaluate(IROp op, int a, int b, int &value) {
+    auto ua = (unsigned)a;
+    auto ub = (unsigned)b;
+    switch (op) {
+        case IROp::Copy: value = a; return true;
+        case IROp::Add: value = (int)(ua + ub); return true;
+        case IROp::Sub: value = (int)(ua - ub); return true;
+        case IROp::Mul: value = (int)(ua * ub); return true;
+        case IROp::Div:
+            if (b == 0 || (a == INT_MIN && b == -1)) return false;
+            value = a / b;
+            return true;
+        case IROp::And: value = a & b; return true;
+        case IROp::Or: value = a | b; return true;
+        case IROp::Shl:
+            if (b < 0 || b > 31) return false;
+            value = (int)(ua << b);
+            return true;
+        case IROp::Eq: value = a == b; return true;
+        case IROp::Ne: value = a != b; return true;
+        case IROp::Lt: value = a < b; return true;
+        case IROp::Le: value = a <= b; return true;
+        case IROp::Gt: value = a > b; return true;
+        case IROp::Ge: value = a >= b; return true;
+        case IROp::Not: value = a == 0; return true;
+        case IROp::Neg: value = (int)(0u - ua); return true;
+        default: return false;
+    }
+}
+
+/* an operand as an immediate, if it is known to be one */
+IROperand known(const State &state, const IROperand &operand) {
+    if (operand.isVReg() && state[operand.value].kind == Value::Constant) {
+        return IROperand::imm(state[operand.value].constant);
+    }
+    return operand;
+}
+
+/* the value an instruction gives its destination */
+Value result(const State &state, const IRInstr &instr) {
+    IROperand a = known(state, instr.a);
+    IROperand b = known(state, instr.b);
+    bool unary = instr.op == IROp::Copy || instr.op == IROp::Not || instr.op == IROp::Neg;
+    int value;
+    if (a.isImm() && (unary || b.isImm()) && evaluate(instr.op, a.value, b.value, value)) {
+        return Value{Value::Constant, value};
+    }
+    return varying;
+}
+
+/* the successors a block may go to once its instructions ran in state */
+std::vector<int> successors(const State &state, const IRInstr &last) {
+    if (last.op == IROp::Jump) return {last.target};
+    if (last.op != IROp::Branch) return {};
+    IROperand condition = known(state, last.a);
+    if (condition.isImm()) return {condition.value != 0 ? last.target : last.alt};
+    return {last.target, last.alt};
+}
+
+void toCopy(IRInstr &instr, IROperand value) {
+    instr.op = IROp::Copy;
+    instr.a = value;
+    instr.b = IROperand();
+    instr.imm = 0;
+}
+
+/* x + 0, x - 0, x * 1, x / 1 and x * 0 */
+void simplify(IRInstr &instr) {
+    const IROperand &a = instr.a;
+    const IROperand &b = instr.b;
+    switch (instr.op) {
+        case IROp::Add:
+            if (b.isImm() && b.value == 0) toCopy(instr, a);
+            else if (a.isImm() && a.value == 0) toCopy(instr, b);
+            break;
+        case IROp::Sub:
+            if (b.isImm() && b.value == 0) toCopy(instr, a);
+            break;
+        case IROp::Mul:
+            if ((a.isImm() && a.value == 0) || (b.isImm() && b.value == 0)) toCopy(instr, IROperand::imm(0));
+            else if (b.isImm() && b.value == 1) toCopy(instr, a);
+            else if (a.isImm() && a.value == 1) toCopy(instr, b);
+            break;
+        case IROp::Div:
+            if (b.isImm() && b.value == 1) toCopy(instr, a);
+            break;
+        default:
+            break;
+    }
+}
+
+/* ((k - %x) - c) as (k - c) - %x, and the like, when %x did not change in between: a chain of constants added to and
+ * subtracted from a register within a block takes one instruction */
+void reassociate(IRFunction &function) {
+    // %t = sign * %x + constant
+    struct Linear {
+        int x;
+        bool negated;
+        int constant;
+    };
+    std::unordered_map<int, Linear> linear;
+
+    for (auto &block : function.blocks) {
+        linear.clear();
+        for (auto &instr : block.instrs) {
+            if (instr.dst < 0) continue;
+
+            bool isLinear = false;
+            Linear value{};
+            bool adds = instr.op == IROp::Add;
+            if ((adds || instr.op == IROp::Sub) && instr.a.isVReg() && instr.b.isImm()) {
+                auto it = linear.find(instr.a.value);
+                value = it != linear.end() ? it->second : Linear{instr.a.value, false, 0};
+                unsigned c = (unsigned)instr.b.value;
+                value.constant = (int)(adds ? (unsigned)value.constant + c : (unsigned)value.constant - c);
+                isLinear = true;
+                if (it != linear.end()) {
+                    if (value.negated) {
+                        instr.op = IROp::Sub;
+                        instr.a = IROperand::imm(value.constant);
+                        instr.b = IROperand::vreg(value.x);
+                    } else {
+                        instr.op = value.constant >= 0 ? IROp::Add : IROp::Sub;
+                        instr.a = IROperand::vreg(value.x);
+                        instr.b = IROperand::imm(value.constant >= 0 ? value.constant : (int)(0u - (unsigned)value.constant));
+                    }
+                }
+            } else if (instr.op == IROp::Sub && instr.a.isImm() && instr.b.isVReg() && linear.count(instr.b.value) == 0) {
+                value = Linear{instr.b.value, true, instr.a.value};
+                isLinear = true;
+            }
+
+            for (auto it = linear.begin(); it != linear.end();) {
+                if (it->first == instr.dst || it->second.x == instr.dst) {
+                    it = linear.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            if (isLinear && value.x != instr.dst) linear[instr.dst] = value;
+        }
+    }
+}
+
+/* [%b + k] for a load or a store whose address %a = add %b, k was computed earlier in the block */
+void foldAddresses(IRFunction &function) {
+    struct Offset {
+        int base;
+        int offset;
+    };
+    std::unordered_map<int, Offset> offsets;
+
+    for (auto &block : function.blocks) {
+        offsets.clear();
+        for (auto &instr : block.instrs) {
+            if ((instr.op == IROp::Load || instr.op == IROp::Store) && instr.a.isVReg()) {
+                auto it = offsets.find(instr.a.value);
+                if (it != offsets.end()) {
+                    instr.a = IROperand::vreg(it->second.base);
+                    instr.imm += it->second.offset;
+                }
+            }
+            if (instr.dst < 0) continue;
+
+            for (auto it = offsets.begin(); it != offsets.end();) {
+                if (it->first == instr.dst || it->second.base == instr.dst) {
+                    it = offsets.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            bool addsConstant = instr.op == IROp::Add || instr.op == IROp::Sub;
+            if (addsConstant && instr.a.isVReg() && instr.b.isImm() && instr.a.value != instr.dst) {
+                offsets[instr.dst] = Offset{instr.a.value, instr.op == IROp::Add ? instr.b.value : -instr.b.value};
+            }
+        }
+    }
+}
+
+}
+
+void foldConstants(IRFunction &function) {
+    size_t blockCount = function.blocks.size();
+    std::vector<State> in(blockCount, State(function.vregs.size(), undefined));
+    std::vector<bool> reached(blockCount, false);
+    std::vector<int> work{0};
+    reached[0] = true;
+
+    while (!work.empty()) {
+        int b = work.back();
+        work.pop_back();
+        State state = in[b];
+        for (const auto &instr : function.blocks[b].instrs) {
+            if (instr.dst >= 0) state[instr.dst] = result(state, instr);
+        }
+
+        for (int successor : successors(state, function.blocks[b].instrs.back())) {
+            bool changed = !reached[successor];
+            State &successorIn = in[successor];
+            for (size_t vreg = 0; vreg < state.size(); vreg++) {
+                Value merged = meet(successorIn[vreg], state[vreg]);
+                if (merged != successorIn[vreg]) {
+                    successorIn[vreg] = merged;
+                    changed = true;
+                }
+            }
+            if (changed) {
+                reached[successor] = true;
+                work.push_back(successor);
+            }
+        }
+    }
+
+    for (size_t b = 0; b < blockCount; b++) {
+        if (!reached[b]) continue;
+        State &state = in[b];
+        for (auto &instr : function.blocks[b].instrs) {
+            Value value = instr.dst >= 0 ? result(state, instr) : undefined;
+            if (instr.op == IROp::Branch) {
+                std::vector<int> taken = successors(state, instr);
+                if (taken.size() == 1 || instr.target == instr.alt) {
+                    instr.op = IROp::Jump;
+                    instr.a = IROperand();
+                    instr.target = taken[0];
+                    instr.alt = -1;
+                }
+            }
+            instr.a = known(state, instr.a);
+            instr.b = known(state, instr.b);
+            for (auto &arg : instr.args) {
+                arg = known(state, arg);
+            }
+            if (value.kind == Value::Constant) {
+                toCopy(instr, IROperand::imm(value.constant));
+            } else if (instr.dst >= 0) {
+                simplify(instr);
+            }
+            if (instr.dst >= 0) state[instr.dst] = value;
+        }
+    }
+
+    removeUnreachableBlocks(function);
+    reassociate(function);
+    foldAddresses(function);
+    removeDeadCode(function);
+}
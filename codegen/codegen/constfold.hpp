@@ -0,0 +1,19 @@
+#ifndef COMPILER_CONSTFOLD_HPP
+#define COMPILER_CONSTFOLD_HPP
+
+#include <ir.hpp>
+
+/*
+ * Constant propagation and folding over the IR of a function.
+ * A forward dataflow finds, at every point, the virtual registers holding a known constant, following only the
+ * successors of a branch whose condition may hold. Reads of those registers become immediates, instructions over
+ * immediates become copies of their value, branches on a constant become jumps, and the blocks no longer reached
+ * are dropped. Adding or subtracting 0 and multiplying or dividing by 1 become copies, constants added to and
+ * subtracted from one register in a row add up, e.g. n - i - 1 for a constant n, and a constant added to an address
+ * moves into the offset of the loads and stores using it. Last, the instructions computing a register nothing reads
+ * are removed, unless they have an effect.
+ * A division by 0 is left for the program to run into.
+ * */
+void foldConstants(IRFunction &function);
+
+#endif //COMPILER_CONSTFOLD_HPP
@@ -0,0 +1,364 @@
+#include <emitter.hpp>
+#include <algorithm>
+
+void MoonEmitter::emit(const IRProgram &program) {
+    for (const auto &irFunction : program.functions) {
+        emitFunction(*irFunction);
+    }
+
+    comment("buffer space used for console output");
+    label(code.symbol("buf"));
+    append(MoonOp::Res, 0, 0, 0, 20);
+}
+
+/*
+ * offsets from FP of the slots, the saved registers and the homes of the spilled virtual registers, below the params
+ * */
+void MoonEmitter::layoutFrame() {
+    int size = function->isMain ? 0 : -(paramOffset(function->paramCount) + WORD);
+
+    slotOffsets.clear();
+    for (const auto &slot : function->slots) {
+        size += slot.size;
+        slotOffsets.push_back(-size);
+    }
+
+    // passing arguments in registers, r1-r4 are the caller's to save
+    int firstSaved = inRegisters() ? RegisterAllocation::LAST_CLOBBERED + 1 : RegisterAllocation::FIRST;
+    saves.assign(allocation.written.size(), 0);
+    for (size_t r = firstSaved; r < saves.size() && !function->isMain; r++) {
+        if (allocation.written[r]) {
+            size += WORD;
+            saves[r] = -size;
+        }
+    }
+
+    homeOffsets.clear();
+    for (int home = 0; home < allocation.homeCount; home++) {
+        size += WORD;
+        homeOffsets.push_back(-size);
+    }
+
+    frameSize = size;
+}
+
+/* whether a function calls nothing, the lib.m routines included, so r15 keeps its return address */
+static bool isLeafFunction(const IRFunction &function) {
+    for (const auto &block : function.blocks) {
+        for (const auto &instr : block.instrs) {
+            if (instr.op == IROp::Call || instr.op == IROp::Write || instr.op == IROp::Read) return false;
+        }
+    }
+    return true;
+}
+
+void MoonEmitter::emitFunction(const IRFunction &irFunction) {
+    function = &irFunction;
+    allocation = allocateRegisters(irFunction, convention);
+    isLeaf = inRegisters() && !function->isMain && isLeafFunction(irFunction);
+    frame = isLeaf ? SP : FP;
+    layoutFrame();
+
+    // only the blocks jumped to need a label
+    blockLabels.assign(function->blocks.size(), MoonInstr::NO_SYMBOL);
+    for (const auto &block : function->blocks) {
+        const IRInstr &last = block.instrs.back();
+        for (int target : {last.target, last.alt}) {
+            if (target >= 0 && blockLabels[target] == MoonInstr::NO_SYMBOL) {
+                blockLabels[target] = getTag();
+            }
+        }
+    }
+
+    append(MoonOp::Align);
+    comment("funcdef " + function->name);
+    if (function->isMain) {
+        append(MoonOp::Entry);
+        label(code.symbol(function->label));
+        addi(SP, ZR, "topaddr");
+        addi(FP, ZR, "topaddr");
+    } else {
+        label(code.symbol(function->label));
+    }
+    if (!function->isMain && !isLeaf) {
+        sw(CALLER_FP, SP, FP);
+        addi(FP, SP, 0);
+        sw(RETURN_ADDRESS, FP, JL);
+    }
+    if (!isLeaf) subi(SP, SP, frameSize);
+    for (size_t r = 0; r < saves.size(); r++) {
+        if (saves[r] != 0) sw(saves[r], frame, (int)r);
+    }
+
+    for (size_t b = 0; b < function->blocks.size(); b++) {
+        if (blockLabels[b] != MoonInstr::NO_SYMBOL) {
+            label(blockLabels[b]);
+        }
+        for (const auto &instr : function->blocks[b].instrs) {
+            emitInstr(instr, b);
+        }
+    }
+    comment("end of funcdef " + function->name);
+}
+
+/* the register holding an operand, loaded into scratch if it is an immediate or spilled */
+int MoonEmitter::use(const IROperand &operand, int scratch) {
+    if (operand.isImm()) {
+        addi(scratch, ZR, operand.value);
+    } else if (allocation.isSpilled(operand.value)) {
+        lw(scratch, homeOffsets[allocation.homes[operand.value]], frame);
+    } else {
+        return allocation.registers[operand.value];
+    }
+    return scratch;
+}
+
+/* the register to compute a virtual register in */
+int MoonEmitter::target(int vreg) {
+    return allocation.isSpilled(vreg) ? S1 : allocation.registers[vreg];
+}
+
+/* moves a virtual register computed in reg to where it lives */
+void MoonEmitter::define(int vreg, int from) {
+    if (allocation.isSpilled(vreg)) {
+        sw(homeOffsets[allocation.homes[vreg]], frame, from);
+    } else if (from != target(vreg)) {
+        addi(target(vreg), from, 0);
+    }
+}
+
+/*
+ * The first arguments into r1 and up, the others where the params of the callee's frame will be. Those are stored
+ * first, as the registers they are in may be overwritten, then the arguments in registers are moved all at once: a
+ * move goes when no other one still reads the register it writes, and when every one's is, one of them goes through
+ * r10. The immediates and the spilled arguments are loaded last.
+ * */
+void MoonEmitter::passArguments(const IRInstr &call) {
+    struct Move {
+        int to;
+        int from;
+    };
+    std::vector<Move> moves;
+    for (size_t k = 0; k < call.args.size(); k++) {
+        const IROperand &arg = call.args[k];
+        if (k >= (size_t)RegisterAllocation::ARGUMENTS) {
+            sw(paramOffset((int)k), SP, use(arg, S1));
+        } else if (arg.isVReg() && !allocation.isSpilled(arg.value)) {
+            moves.push_back(Move{(int)k + 1, allocation.registers[arg.value]});
+        }
+    }
+
+    while (!moves.empty()) {
+        moves.erase(std::remove_if(moves.begin(), moves.end(), [](const Move &move) { return move.to == move.from; }),
+                    moves.end());
+        auto ready = std::find_if(moves.begin(), moves.end(), [&](const Move &move) {
+            return std::none_of(moves.begin(), moves.end(), [&](const Move &other) { return other.from == move.to; });
+        });
+        if (ready != moves.end()) {
+            addi(ready->to, ready->from, 0);
+            moves.erase(ready);
+            continue;
+        }
+        if (moves.empty()) break;
+        int cycled = moves.front().from;
+        addi(S1, cycled, 0);
+        for (auto &move : moves) {
+            if (move.from == cycled) move.from = S1;
+        }
+    }
+
+    for (size_t k = 0; k < call.args.size() && k < (size_t)RegisterAllocation::ARGUMENTS; k++) {
+        const IROperand &arg = call.args[k];
+        if (arg.isImm() || allocation.isSpilled(arg.value)) {
+            use(arg, (int)k + 1);
+        }
+    }
+}
+
+void MoonEmitter::epilog(const IROperand &value) {
+    if (function->isMain) {
+        append(MoonOp::Hlt);
+        return;
+    }
+
+    if (!value.isNone() && inRegisters()) {
+        int reg = use(value, RV);
+        if (reg != RV) addi(RV, reg, 0);
+    } else if (!value.isNone()) {
+        sw(RETURN_VALUE, FP, use(value, S1));
+    }
+    for (size_t r = 0; r < saves.size(); r++) {
+        if (saves[r] != 0) lw((int)r, saves[r], frame);
+    }
+    if (isLeaf) {
+        jr(JL);
+        return;
+    }
+    lw(JL, RETURN_ADDRESS, FP);
+    addi(SP, FP, 0);
+    lw(FP, CALLER_FP, FP);
+    jr(JL);
+}
+
+static MoonOp moonOp(IROp op) {
+    switch (op) {
+        case IROp::Add: return MoonOp::Add;
+        case IROp::Sub: return MoonOp::Sub;
+        case IROp::Mul: return MoonOp::Mul;
+        case IROp::Div: return MoonOp::Div;
+        case IROp::And: return MoonOp::And;
+        case IROp::Or: return MoonOp::Or;
+        case IROp::Eq: return MoonOp::Ceq;
+        case IROp::Ne: return MoonOp::Cne;
+        case IROp::Lt: return MoonOp::Clt;
+        case IROp::Le: return MoonOp::Cle;
+        case IROp::Gt: return MoonOp::Cgt;
+        default: return MoonOp::Cge;
+    }
+}
+
+/* the op giving the same result with its operands swapped, if any */
+static bool swapped(IROp op, IROp &swappedOp) {
+    switch (op) {
+        case IROp::Add: case IROp::Mul: case IROp::And: case IROp::Or: case IROp::Eq: case IROp::Ne:
+            swappedOp = op;
+            return true;
+        case IROp::Lt: swappedOp = IROp::Gt; return true;
+        case IROp::Le: swappedOp = IROp::Ge; return true;
+        case IROp::Gt: swappedOp = IROp::Lt; return true;
+        case IROp::Ge: swappedOp = IROp::Le; return true;
+        default: return false;
+    }
+}
+
+void MoonEmitter::emitInstr(const IRInstr &instr, size_t blockIndex) {
+    int next = (int)blockIndex + 1;
+
+    switch (instr.op) {
+        case IROp::Copy:
+            if (instr.a.isImm()) {
+                addi(target(instr.dst), ZR, instr.a.value);
+                define(instr.dst, target(instr.dst));
+            } else {
+                define(instr.dst, use(instr.a, S1));
+            }
+            break;
+        case IROp::Not:
+            op3(MoonOp::Ceq, target(instr.dst), use(instr.a, S1), ZR);
+            define(instr.dst, target(instr.dst));
+            break;
+        case IROp::Neg:
+            op3(MoonOp::Sub, target(instr.dst), ZR, use(instr.a, S1));
+            define(instr.dst, target(instr.dst));
+            break;
+        case IROp::Shl: {
+            // moon shifts a register in place, elsewhere a multiplication spares copying it first
+            int shifted = use(instr.a, S1);
+            if (shifted == target(instr.dst)) {
+                sl(shifted, instr.b.value);
+            } else {
+                opi(MoonOp::Muli, target(instr.dst), shifted, 1 << instr.b.value);
+            }
+            define(instr.dst, target(instr.dst));
+            break;
+        }
+        case IROp::Param:
+            // the first ones at the entry, before anything overwrites the registers they come in
+            if (inRegisters() && instr.imm < RegisterAllocation::ARGUMENTS) {
+                define(instr.dst, instr.imm + 1);
+                break;
+            }
+            lw(target(instr.dst), paramOffset(instr.imm), frame);
+            define(instr.dst, target(instr.dst));
+            break;
+        case IROp::FrameAddr:
+            addi(target(instr.dst), frame, slotOffsets[instr.imm]);
+            define(instr.dst, target(instr.dst));
+            break;
+        case IROp::Load:
+            lw(target(instr.dst), instr.imm, use(instr.a, S1));
+            define(instr.dst, target(instr.dst));
+            break;
+        case IROp::Store: {
+            int base = use(instr.a, S1);
+            sw(instr.imm, base, use(instr.b, S2));
+            break;
+        }
+        case IROp::Call:
+            if (inRegisters()) {
+                passArguments(instr);
+            } else {
+                // the arguments go where the params of the callee's frame will be
+                for (size_t k = 0; k < instr.args.size(); k++) {
+                    sw(paramOffset((int)k), SP, use(instr.args[k], S1));
+                }
+            }
+            jl(JL, instr.callee->label);
+            if (instr.dst >= 0 && inRegisters()) {
+                define(instr.dst, RV);
+            } else if (instr.dst >= 0) {
+                lw(target(instr.dst), RETURN_VALUE, SP);
+                define(instr.dst, target(instr.dst));
+            }
+            break;
+        case IROp::Write:
+            // the value goes first, it may be in r1
+            sw(-8, SP, use(instr.a, S1));
+            addi(1, ZR, "buf");
+            sw(-12, SP, 1);
+            jl(JL, "intstr");
+            sw(-8, SP, RV);
+            jl(JL, "putstr");
+            addi(1, ZR, 13);
+            putc(1);
+            addi(1, ZR, 10);
+            putc(1);
+            break;
+        case IROp::Read:
+            addi(1, ZR, "buf");
+            sw(-8, SP, 1);
+            jl(JL, "getstr");
+            addi(1, ZR, "buf");
+            sw(-8, SP, 1);
+            jl(JL, "strint");
+            define(instr.dst, RV);
+            break;
+        case IROp::Jump:
+            if (instr.target != next) {
+                j(blockLabels[instr.target]);
+            }
+            break;
+        case IROp::Branch: {
+            int condition = use(instr.a, S1);
+            if (instr.target == next) {
+                bz(condition, blockLabels[instr.alt]);
+            } else {
+                bnz(condition, blockLabels[instr.target]);
+                if (instr.alt != next) {
+                    j(blockLabels[instr.alt]);
+                }
+            }
+            break;
+        }
+        case IROp::Return:
+            epilog(instr.a);
+            break;
+        default: {
+            // an immediate operand goes in the instruction, second, e.g. 1 < x as cgti x,1
+            IROp op = instr.op;
+            IROperand lhs = instr.a;
+            IROperand rhs = instr.b;
+            if (lhs.isImm() && !rhs.isImm() && swapped(instr.op, op)) {
+                std::swap(lhs, rhs);
+            }
+            if (rhs.isImm()) {
+                opi(immediateForm(moonOp(op)), target(instr.dst), use(lhs, S1), rhs.value);
+            } else {
+                int lhsReg = use(lhs, S1);
+                op3(moonOp(op), target(instr.dst), lhsReg, use(rhs, S2));
+            }
+            define(instr.dst, target(instr.dst));
+            break;
+        }
+    }
+}
@@ -0,0 +1,154 @@
+#ifndef COMPILER_EMITTER_HPP
+#define COMPILER_EMITTER_HPP
+
+#include <ir.hpp>
+#include <moon.hpp>
+#include <regalloc.hpp>
+
+/*
+ * Translates IR to a list of moon instructions.
+ * Frames grow down from topaddr. FP (r12) points to the top of the frame of the running function and SP (r14) to its
+ * bottom, so the lib.m routines, which take their arguments below SP, can be called at any point. A function's frame
+ * holds, from FP down: its return address, the FP of its caller, its return value, its params, in order, and then its
+ * slots, the registers it saves and the homes of its spilled virtual registers. A caller stores the arguments right
+ * below its SP, where the callee frame will have them, and finds the return value there after the call. main has
+ * neither return address, caller FP, return value, params nor saved registers.
+ * Passing arguments in registers, the words of the params and return value passed in registers stay unused, and a
+ * leaf function addresses its frame from SP, which it leaves where its caller had it, rather than from FP.
+ * Virtual registers are in the registers allocateRegisters gives them ; a spilled one is loaded into r10 or r11 where
+ * it is read, and computed in r10 and stored to its home where it is written.
+ * */
+class MoonEmitter {
+public:
+    MoonCode code;
+
+    explicit MoonEmitter(CallingConvention convention = CallingConvention::Stack) : convention(convention) {}
+
+    void emit(const IRProgram &program);
+
+private:
+    static const int ZR = 0;  // zero register
+    static const int S1 = 10; // scratch registers for the spilled virtual registers and the immediates
+    static const int S2 = 11;
+    static const int FP = 12; // frame pointer
+    static const int RV = 13; // return value of the lib.m routines
+    static const int SP = 14; // stack pointer
+    static const int JL = 15; // jump link
+
+    static const int WORD = 4;
+    static const int RETURN_ADDRESS = -4;
+    static const int CALLER_FP = -8;
+    static const int RETURN_VALUE = -12;
+    static const int FIRST_PARAM = -16;
+
+    int tagCounter = 0;
+    CallingConvention convention;
+
+    const IRFunction *function = nullptr;
+    bool isLeaf = false;
+    int frame = FP; // the register the frame is addressed from
+    std::vector<int> blockLabels; // symbols of the labels of the blocks, NO_SYMBOL for the ones not jumped to
+    std::vector<int> slotOffsets;
+    RegisterAllocation allocation;
+    std::vector<int> homeOffsets;
+    std::vector<int> saves; // offsets of the saved registers, by register number, 0 if not saved
+    int frameSize = 0;
+
+    void emitFunction(const IRFunction &irFunction);
+    void emitInstr(const IRInstr &instr, size_t blockIndex);
+    void layoutFrame();
+
+    int use(const IROperand &operand, int scratch);
+    int target(int vreg);
+    void define(int vreg, int from);
+    void passArguments(const IRInstr &call);
+    void epilog(const IROperand &value);
+
+    bool inRegisters() const {
+        return convention == CallingConvention::Registers;
+    }
+
+    static int paramOffset(int param) {
+        return FIRST_PARAM - WORD * param;
+    }
+
+    int getTag() {
+        return code.symbol("tag" + std::to_string(tagCounter++));
+    }
+
+    /* $begin instructions */
+
+    MoonInstr &append(MoonOp op, int ri = 0, int rj = 0, int rk = 0, int k = 0) {
+        code.instrs.emplace_back(op, ri, rj, rk, k);
+        return code.instrs.back();
+    }
+
+    /* the next instruction gets the label, e.g. the first one of a block */
+    void label(int symbol) {
+        append(MoonOp::Label).symbol = symbol;
+    }
+
+    void comment(const std::string &text) {
+        append(MoonOp::Comment).symbol = code.symbol(text);
+    }
+
+    void op3(MoonOp op, int dest, int op1, int op2) {
+        append(op, dest, op1, op2);
+    }
+
+    void opi(MoonOp op, int dest, int op1, int op2) {
+        append(op, dest, op1, 0, op2);
+    }
+
+    void addi(int dest, int op1, int op2) {
+        opi(MoonOp::Addi, dest, op1, op2);
+    }
+
+    void addi(int dest, int op1, const std::string &op2) {
+        append(MoonOp::Addi, dest, op1).symbol = code.symbol(op2);
+    }
+
+    void subi(int dest, int op1, int op2) {
+        opi(MoonOp::Subi, dest, op1, op2);
+    }
+
+    void sl(int reg, int bits) {
+        append(MoonOp::Sl, reg, 0, 0, bits);
+    }
+
+    void lw(int dest, int offset, int base) {
+        append(MoonOp::Lw, dest, base, 0, offset);
+    }
+
+    void sw(int offset, int base, int src) {
+        append(MoonOp::Sw, src, base, 0, offset);
+    }
+
+    void bz(int reg, int tag) {
+        append(MoonOp::Bz, reg).symbol = tag;
+    }
+
+    void bnz(int reg, int tag) {
+        append(MoonOp::Bnz, reg).symbol = tag;
+    }
+
+    void j(int tag) {
+        append(MoonOp::J).symbol = tag;
+    }
+
+    void jl(int store, const std::string &dest) {
+        append(MoonOp::Jl, store).symbol = code.symbol(dest);
+    }
+
+    void jr(int dest) {
+        append(MoonOp::Jr, dest);
+    }
+
+    void putc(int reg) {
+        append(MoonOp::Putc, reg);
+    }
+
+    /* $end instructions */
+};
+
+#endif //COMPILER_EMITTER_HPP
@@ -0,0 +1,178 @@
+#include <inliner.hpp>
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+/* the instructions inlining the function adds, its params and returns becoming about as many as the call was */
+size_t bodySize(const IRFunction &function) {
+    size_t size = 0;
+    for (const auto &block : function.blocks) {
+        for (const auto &instr : block.instrs) {
+            if (instr.op != IROp::Param && instr.op != IROp::Return && instr.op != IROp::Jump) size++;
+        }
+    }
+    return size;
+}
+
+bool makesCalls(const IRFunction &function) {
+    for (const auto &block : function.blocks) {
+        for (const auto &instr : block.instrs) {
+            if (instr.op == IROp::Call) return true;
+        }
+    }
+    return false;
+}
+
+IRInstr jump(int target) {
+    IRInstr instr;
+    instr.op = IROp::Jump;
+    instr.target = target;
+    return instr;
+}
+
+/*
+ * Replaces the call at instruction k of block b by the blocks of the callee, right after b, and moves the
+ * instructions after the call to a block after those.
+ * */
+void inlineCall(IRFunction &caller, size_t b, size_t k) {
+    IRInstr call = caller.blocks[b].instrs[k];
+    const IRFunction &callee = *call.callee;
+    int count = (int)callee.blocks.size();
+    int entry = (int)b + 1;
+    int continuation = entry + count;
+
+    std::vector<int> vregs;
+    for (IRType type : callee.vregs) {
+        vregs.push_back(caller.newVReg(type));
+    }
+    int firstSlot = (int)caller.slots.size();
+    for (const auto &slot : callee.slots) {
+        caller.newSlot(callee.name + "." + slot.name, slot.size);
+    }
+    auto renamed = [&](const IROperand &operand) {
+        return operand.isVReg() ? IROperand::vreg(vregs[operand.value]) : operand;
+    };
+
+    std::vector<IRBlock> body(callee.blocks.size());
+    for (size_t cb = 0; cb < callee.blocks.size(); cb++) {
+        for (const auto &instr : callee.blocks[cb].instrs) {
+            IRInstr copy = instr;
+            copy.dst = instr.dst >= 0 ? vregs[instr.dst] : -1;
+            copy.a = renamed(instr.a);
+            copy.b = renamed(instr.b);
+            for (auto &arg : copy.args) {
+                arg = renamed(arg);
+            }
+            if (instr.target >= 0) copy.target = entry + instr.target;
+            if (instr.alt >= 0) copy.alt = entry + instr.alt;
+
+            if (instr.op == IROp::Param) {
+                copy.op = IROp::Copy;
+                copy.a = call.args[instr.imm];
+                copy.imm = 0;
+            } else if (instr.op == IROp::FrameAddr) {
+                copy.imm += firstSlot;
+            } else if (instr.op == IROp::Return) {
+                if (call.dst >= 0 && !instr.a.isNone()) {
+                    IRInstr result;
+                    result.op = IROp::Copy;
+                    result.dst = call.dst;
+                    result.a = copy.a;
+                    body[cb].instrs.push_back(result);
+                }
+                copy = jump(continuation);
+            }
+            body[cb].instrs.push_back(copy);
+        }
+    }
+
+    auto &instrs = caller.blocks[b].instrs;
+    IRBlock after;
+    after.instrs.assign(instrs.begin() + (long)k + 1, instrs.end());
+    instrs.erase(instrs.begin() + (long)k, instrs.end());
+
+    // the blocks after b move past the ones inserted
+    auto shift = [&](IRBlock &block) {
+        IRInstr &last = block.instrs.back();
+        if (last.target > (int)b) last.target += count + 1;
+        if (last.alt > (int)b) last.alt += count + 1;
+    };
+    for (size_t other = 0; other < caller.blocks.size(); other++) {
+        if (other != b) shift(caller.blocks[other]);
+    }
+    shift(after);
+    instrs.push_back(jump(entry));
+
+    body.push_back(std::move(after));
+    caller.blocks.insert(caller.blocks.begin() + entry, std::make_move_iterator(body.begin()),
+                         std::make_move_iterator(body.end()));
+}
+
+}
+
+void inlineCalls(IRProgram &program, size_t threshold, std::ostream *report) {
+    std::unordered_map<const IRFunction*, int> callSites;
+    for (const auto &function : program.functions) {
+        for (const auto &block : function->blocks) {
+            for (const auto &instr : block.instrs) {
+                if (instr.op == IROp::Call) callSites[instr.callee]++;
+            }
+        }
+    }
+
+    // a caller whose calls were all inlined may be inlined in turn
+    std::unordered_map<const IRFunction*, bool> inlined;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto &caller : program.functions) {
+            bool inlinedInto = false;
+            for (size_t b = 0; b < caller->blocks.size(); b++) {
+                auto &instrs = caller->blocks[b].instrs;
+                for (size_t k = 0; k < instrs.size(); k++) {
+                    if (instrs[k].op != IROp::Call) continue;
+                    const IRFunction *callee = instrs[k].callee;
+                    size_t size = bodySize(*callee);
+                    if (makesCalls(*callee) || (size > threshold && callSites[callee] > 1)) continue;
+
+                    if (report != nullptr) {
+                        *report << "inlined " << callee->name << " into " << caller->name << ", " << size
+                                << " instructions" << (size > threshold ? ", its only call" : "") << "\n";
+                    }
+                    inlineCall(*caller, b, k);
+                    callSites[callee]--;
+                    inlined[callee] = true;
+                    inlinedInto = true;
+                    // the rest of the block is now in the one after the callee's
+                    break;
+                }
+            }
+            if (inlinedInto) {
+                // the returns jump to the blocks after the calls, which may only jump on
+                threadJumps(*caller);
+                changed = true;
+            }
+        }
+    }
+
+    for (const auto &function : program.functions) {
+        for (const auto &block : function->blocks) {
+            for (const auto &instr : block.instrs) {
+                if (instr.op != IROp::Call || report == nullptr) continue;
+                *report << "kept call to " << instr.callee->name << " in " << function->name << ", ";
+                if (makesCalls(*instr.callee)) {
+                    *report << "it makes calls\n";
+                } else {
+                    *report << bodySize(*instr.callee) << " instructions\n";
+                }
+            }
+        }
+    }
+
+    auto unused = [&](const std::unique_ptr<IRFunction> &function) {
+        return inlined[function.get()] && callSites[function.get()] == 0;
+    };
+    program.functions.erase(std::remove_if(program.functions.begin(), program.functions.end(), unused),
+                            program.functions.end());
+}
@@ -0,0 +1,17 @@
+#ifndef COMPILER_INLINER_HPP
+#define COMPILER_INLINER_HPP
+
+#include <ir.hpp>
+
+/*
+ * Inlining over the IR of a program.
+ * A call is replaced by the body of its callee when the callee calls nothing, once the calls it makes were inlined in
+ * turn, and either has at most threshold instructions or is called from nowhere else, when its body only moves. The
+ * params become copies of the arguments and the returns copies to the value of the call and jumps after it, and the
+ * slots of the callee are added to the frame of the caller. Recursive functions are never inlined, and a function
+ * inlined at all its calls is dropped.
+ * report, when not null, gets a line for every call, saying whether it was inlined and why not if it was not.
+ * */
+void inlineCalls(IRProgram &program, size_t threshold, std::ostream *report);
+
+#endif //COMPILER_INLINER_HPP
@@ -0,0 +1,208 @@
+#include <ir.hpp>
+#include <algorithm>
+
+const char *irOpName(IROp op) {
+    switch (op) {
+        case IROp::Copy: return "copy";
+        case IROp::Add: return "add";
+        case IROp::Sub: return "sub";
+        case IROp::Mul: return "mul";
+        case IROp::Div: return "div";
+        case IROp::And: return "and";
+        case IROp::Or: return "or";
+        case IROp::Shl: return "shl";
+        case IROp::Eq: return "eq";
+        case IROp::Ne: return "ne";
+        case IROp::Lt: return "lt";
+        case IROp::Le: return "le";
+        case IROp::Gt: return "gt";
+        case IROp::Ge: return "ge";
+        case IROp::Not: return "not";
+        case IROp::Neg: return "neg";
+        case IROp::Param: return "param";
+        case IROp::FrameAddr: return "frameaddr";
+        case IROp::Load: return "load";
+        case IROp::Store: return "store";
+        case IROp::Call: return "call";
+        case IROp::Write: return "write";
+        case IROp::Read: return "read";
+        case IROp::Jump: return "jump";
+        case IROp::Branch: return "branch";
+        case IROp::Return: return "ret";
+    }
+    return "?";
+}
+
+void removeUnreachableBlocks(IRFunction &function) {
+    std::vector<bool> reached(function.blocks.size(), false);
+    std::vector<int> work{0};
+    reached[0] = true;
+    while (!work.empty()) {
+        int id = work.back();
+        work.pop_back();
+        const IRInstr &last = function.blocks[id].instrs.back();
+        for (int successor : {last.target, last.alt}) {
+            if (successor >= 0 && !reached[successor]) {
+                reached[successor] = true;
+                work.push_back(successor);
+            }
+        }
+    }
+
+    std::vector<int> renumbered(function.blocks.size(), -1);
+    std::vector<IRBlock> blocks;
+    for (size_t id = 0; id < function.blocks.size(); id++) {
+        if (reached[id]) {
+            renumbered[id] = (int)blocks.size();
+            blocks.push_back(std::move(function.blocks[id]));
+        }
+    }
+    for (auto &block : blocks) {
+        IRInstr &last = block.instrs.back();
+        if (last.target >= 0) last.target = renumbered[last.target];
+        if (last.alt >= 0) last.alt = renumbered[last.alt];
+    }
+    function.blocks = std::move(blocks);
+}
+
+void threadJumps(IRFunction &function) {
+    auto destination = [&](int target) {
+        // at most as many hops as blocks, a loop of jumps going nowhere staying as it is
+        for (size_t hops = 0; hops < function.blocks.size(); hops++) {
+            const auto &instrs = function.blocks[target].instrs;
+            if (instrs.size() != 1 || instrs[0].op != IROp::Jump) break;
+            target = instrs[0].target;
+        }
+        return target;
+    };
+    for (auto &block : function.blocks) {
+        IRInstr &last = block.instrs.back();
+        if (last.target >= 0) last.target = destination(last.target);
+        if (last.alt >= 0) last.alt = destination(last.alt);
+    }
+    removeUnreachableBlocks(function);
+}
+
+void removeDeadCode(IRFunction &function) {
+    std::vector<int> uses(function.vregs.size());
+    std::vector<int> used;
+    for (const auto &block : function.blocks) {
+        for (const auto &instr : block.instrs) {
+            used.clear();
+            vregUses(instr, used);
+            for (int vreg : used) uses[vreg]++;
+        }
+    }
+
+    bool removed = true;
+    while (removed) {
+        removed = false;
+        for (auto &block : function.blocks) {
+            auto dead = [&](IRInstr &instr) {
+                if (instr.dst < 0 || uses[instr.dst] > 0) return false;
+                if (instr.op == IROp::Call) {
+                    instr.dst = -1; // the call still happens
+                    return false;
+                }
+                if (instr.op == IROp::Read) return false;
+                used.clear();
+                vregUses(instr, used);
+                for (int vreg : used) {
+                    removed |= --uses[vreg] == 0;
+                }
+                return true;
+            };
+            block.instrs.erase(std::remove_if(block.instrs.begin(), block.instrs.end(), dead), block.instrs.end());
+        }
+    }
+}
+
+void vregUses(const IRInstr &instr, std::vector<int> &uses) {
+    if (instr.a.isVReg()) uses.push_back(instr.a.value);
+    if (instr.b.isVReg()) uses.push_back(instr.b.value);
+    for (const auto &arg : instr.args) {
+        if (arg.isVReg()) uses.push_back(arg.value);
+    }
+}
+
+static const char *irTypeName(IRType type) {
+    switch (type) {
+        case IRType::Int: return "int";
+        case IRType::Float: return "float";
+        case IRType::Addr: return "addr";
+    }
+    return "?";
+}
+
+static std::ostream &operator<<(std::ostream &out, const IROperand &operand) {
+    if (operand.isVReg()) {
+        return out << "%" << operand.value;
+    }
+    return out << operand.value;
+}
+
+static void dumpInstr(const IRFunction &function, const IRInstr &instr, std::ostream &out) {
+    out << "    ";
+    if (instr.dst >= 0) {
+        out << "%" << instr.dst << ":" << irTypeName(function.vregs[instr.dst]) << " = ";
+    }
+    out << irOpName(instr.op);
+
+    switch (instr.op) {
+        case IROp::Param:
+            out << " " << instr.imm;
+            break;
+        case IROp::FrameAddr:
+            out << " " << function.slots[instr.imm].name;
+            break;
+        case IROp::Load:
+            out << " [" << instr.a << " + " << instr.imm << "]";
+            break;
+        case IROp::Store:
+            out << " [" << instr.a << " + " << instr.imm << "], " << instr.b;
+            break;
+        case IROp::Call:
+            out << " " << instr.callee->name << "(";
+            for (size_t i = 0; i < instr.args.size(); i++) {
+                out << (i > 0 ? ", " : "") << instr.args[i];
+            }
+            out << ")";
+            break;
+        case IROp::Jump:
+            out << " bb" << instr.target;
+            break;
+        case IROp::Branch:
+            out << " " << instr.a << ", bb" << instr.target << ", bb" << instr.alt;
+            break;
+        default:
+            if (!instr.a.isNone()) out << " " << instr.a;
+            if (!instr.b.isNone()) out << ", " << instr.b;
+            break;
+    }
+    out << "\n";
+}
+
+/*
+ * prints the IR of a program, one function after the other, e.g.
+ *   func add (2 params) -> fadd
+ *   bb0:
+ *       %0:int = param 0
+ *       %1:int = param 1
+ *       %2:int = add %0, %1
+ *       ret %2
+ * */
+void dumpIR(const IRProgram &program, std::ostream &out) {
+    for (const auto &function : program.functions) {
+        out << "func " << function->name << " (" << function->paramCount << " params) -> " << function->label << "\n";
+        for (const auto &slot : function->slots) {
+            out << "    slot " << slot.name << ": " << slot.size << " bytes\n";
+        }
+        for (size_t b = 0; b < function->blocks.size(); b++) {
+            out << "bb" << b << ":\n";
+            for (const auto &instr : function->blocks[b].instrs) {
+                dumpInstr(*function, instr, out);
+            }
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef COMPILER_IR_HPP
+#define COMPILER_IR_HPP
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* $begin IR */
+
+/*
+ * Three-address intermediate representation between the annotated AST and moon code.
+ * A function is a list of basic blocks, in layout order, of instructions over an unbounded set of virtual registers.
+ * A virtual register holds one word and is typed by what that word is. Scalar locals and params live in virtual
+ * registers, which may be assigned more than once ; arrays and structs live in frame slots and are only reached
+ * through addresses. Every block ends with a jump, a branch or a return.
+ * */
+
+enum class IRType : unsigned char { Int, Float, Addr };
+
+enum class IROp : unsigned char {
+    Copy,       // dst = a
+    Add, Sub, Mul, Div, And, Or, // dst = a op b, and/or being bitwise
+    Shl,        // dst = a shifted left by b bits, b an immediate
+    Eq, Ne, Lt, Le, Gt, Ge, // dst = 1 if a cmp b else 0
+    Not,        // dst = 1 if a is 0 else 0
+    Neg,        // dst = -a
+    Param,      // dst = incoming parameter number imm
+    FrameAddr,  // dst = address of frame slot number imm
+    Load,       // dst = word at address a + imm
+    Store,      // word at address a + imm = b
+    Call,       // dst = callee(args), no dst for a call whose value is not used
+    Write,      // prints a and a newline
+    Read,       // dst = integer read from the console
+    Jump,       // to block target
+    Branch,     // to block target if a is not 0, else to block alt
+    Return      // returns a, if any
+};
+
+struct IROperand {
+    enum Kind : unsigned char { None, VReg, Imm };
+
+    Kind kind = None;
+    int value = 0;
+
+    IROperand() = default;
+    IROperand(Kind kind, int value) : kind(kind), value(value) {}
+
+    static IROperand vreg(int id) {
+        return IROperand{VReg, id};
+    }
+
+    static IROperand imm(int value) {
+        return IROperand{Imm, value};
+    }
+
+    bool isVReg() const { return kind == VReg; }
+    bool isImm() const { return kind == Imm; }
+    bool isNone() const { return kind == None; }
+};
+
+struct IRFunction;
+
+struct IRInstr {
+    IROp op;
+    int dst = -1;
+    IROperand a;
+    IROperand b;
+    int imm = 0;
+    int target = -1;
+    int alt = -1;
+    IRFunction *callee = nullptr;
+    std::vector<IROperand> args;
+
+    bool isTerminator() const {
+        return op == IROp::Jump || op == IROp::Branch || op == IROp::Return;
+    }
+};
+
+struct IRBlock {
+    std::vector<IRInstr> instrs;
+};
+
+/* a named region of the frame holding an array or a struct */
+struct IRSlot {
+    std::string name;
+    int size;
+};
+
+struct IRFunction {
+    std::string name;  // as written in the source, e.g. POINT::norm
+    std::string label; // moon label of its entry
+    bool isMain = false;
+    bool returnsValue = false;
+    int paramCount = 0; // the address of the object comes first for a member function
+    std::vector<IRType> vregs;
+    std::vector<IRSlot> slots;
+    std::vector<IRBlock> blocks;
+
+    int newVReg(IRType type) {
+        vregs.push_back(type);
+        return (int)vregs.size() - 1;
+    }
+
+    int newSlot(const std::string &slotName, int size) {
+        slots.push_back(IRSlot{slotName, size});
+        return (int)slots.size() - 1;
+    }
+
+    int newBlock() {
+        blocks.emplace_back();
+        return (int)blocks.size() - 1;
+    }
+};
+
+struct IRProgram {
+    std::vector<std::unique_ptr<IRFunction>> functions;
+};
+
+/* drops the blocks no path from the first one reaches, keeping the others in order */
+void removeUnreachableBlocks(IRFunction &function);
+
+/* sends the jumps and branches to a block holding only a jump where that jump goes, then drops the blocks left */
+void threadJumps(IRFunction &function);
+
+/* removes, until none is left, the instructions computing a register nothing reads, unless they have an effect */
+void removeDeadCode(IRFunction &function);
+
+/* appends the virtual registers an instruction reads */
+void vregUses(const IRInstr &instr, std::vector<int> &uses);
+
+const char *irOpName(IROp op);
+void dumpIR(const IRProgram &program, std::ostream &out);
+
+/* $end IR */
+
+#endif //COMPILER_IR_HPP
@@ -0,0 +1,604 @@
+#ifndef COMPILER_IRGEN_HPP
+#define COMPILER_IRGEN_HPP
+
+#include <codegen.hpp>
+#include <ir.hpp>
+#include <unordered_map>
+#include <unordered_set>
+
+/*
+ * Lowers the annotated AST of a program that passed semantic checking, once computeSizes laid it out, to IR.
+ * Arrays are passed by address and structs by value: the callee gets the address of the argument and copies it into
+ * a slot of its own. A member function gets the address of its object as a hidden first param. Moon has no floating
+ * point instructions, so floats are carried as truncated integers.
+ * */
+class IRGenerationVisitor : public ASTNodeVisitor {
+public:
+    IRProgram &program;
+
+    explicit IRGenerationVisitor(IRProgram &program) : program(program) {}
+
+    void visit(ProgNode &node) override {
+        // every function is declared first, so a call can name a function defined further down
+        for (auto child : node.children) {
+            if (child->type == ASTNodeType::FuncDef) {
+                declareFunction(*child);
+            } else if (child->type == ASTNodeType::ImplDef) {
+                for (auto funcDef : child->children[1]->children) {
+                    declareFunction(*funcDef);
+                }
+            }
+        }
+
+        for (auto child : node.children) {
+            child->accept(*this);
+        }
+    }
+
+    void visit(ImplDefNode &node) override {
+        node.children[1]->accept(*this);
+    }
+
+    void visit(ImplFuncListNode &node) override {
+        for (auto child : node.children) {
+            child->accept(*this);
+        }
+    }
+
+    void visit(FuncDefNode &node) override {
+        function = functions[node.symbolTableEntry];
+        scope = node.symbolTable;
+        storage.clear();
+        variables.clear();
+        layout.clear();
+        self = -1;
+        startBlock(function->newBlock());
+
+        int param = 0;
+        if (scope->enclosingStruct != nullptr) {
+            self = emitValue(IROp::Param, IRType::Addr, IROperand(), param++);
+        }
+
+        for (auto fparam : node.children[1]->children) {
+            auto *entry = fparam->symbolTableEntry;
+            if (entry->type.isBase()) {
+                storage[entry] = Storage{Storage::Register, emitValue(IROp::Param, valueType(entry->type), IROperand(), param++)};
+                variables.insert(storage[entry].index);
+            } else if (entry->type.isArray()) {
+                storage[entry] = Storage{Storage::Reference, emitValue(IROp::Param, IRType::Addr, IROperand(), param++)};
+            } else {
+                // a struct is passed by value: copy the caller's object into a slot of this frame
+                int address = emitValue(IROp::Param, IRType::Addr, IROperand(), param++);
+                int slot = function->newSlot(entry->name, sizeofEntry(entry, scope));
+                int copy = emitValue(IROp::FrameAddr, IRType::Addr, IROperand(), slot);
+                copyWords(IROperand::vreg(copy), 0, IROperand::vreg(address), 0, function->slots[slot].size);
+                storage[entry] = Storage{Storage::Slot, slot};
+            }
+        }
+
+        node.children[3]->accept(*this);
+        if (!terminated()) {
+            emit(IROp::Return);
+        }
+        finishFunction();
+    }
+
+    void visit(VarDeclOrStatBlockNode &node) override {
+        for (auto child : node.children) {
+            child->accept(*this);
+        }
+    }
+
+    void visit(StatBlockNode &node) override {
+        for (auto child : node.children) {
+            child->accept(*this);
+        }
+    }
+
+    void visit(VarDeclNode &node) override {
+        auto *entry = node.symbolTableEntry;
+        if (entry->type.isBase()) {
+            storage[entry] = Storage{Storage::Register, function->newVReg(valueType(entry->type))};
+            variables.insert(storage[entry].index);
+        } else {
+            storage[entry] = Storage{Storage::Slot, function->newSlot(entry->name, sizeofEntry(entry, node.symbolTable))};
+        }
+    }
+
+    /* $begin statements */
+
+    void visit(AssignStatNode &node) override {
+        IROperand value = lower(node.children[2]);
+        if (node.children[0]->type == ASTNodeType::Id) {
+            store(variablePlace(node.target.symbolTableEntry), value);
+        } else {
+            store(place(node.children[0]), value);
+        }
+    }
+
+    void visit(IfStatNode &node) override {
+        int thenBlock = function->newBlock();
+        int endBlock = function->newBlock();
+        // an empty else branches straight past the then block
+        bool hasElse = !node.children[2]->children.empty();
+        int elseBlock = hasElse ? function->newBlock() : endBlock;
+        condition(node.children[0], thenBlock, elseBlock);
+
+        startBlock(thenBlock);
+        node.children[1]->accept(*this);
+        jump(endBlock);
+
+        if (hasElse) {
+            startBlock(elseBlock);
+            node.children[2]->accept(*this);
+            jump(endBlock);
+        }
+
+        startBlock(endBlock);
+    }
+
+    /*
+     * inverted: the condition is tested once before the loop and again after the body, so an iteration ends with one
+     * branch back rather than a jump to a test at the top
+     * */
+    void visit(WhileStatNode &node) override {
+        int bodyBlock = function->newBlock();
+        int endBlock = function->newBlock();
+        condition(node.children[0], bodyBlock, endBlock);
+
+        startBlock(bodyBlock);
+        node.children[1]->accept(*this);
+        if (!terminated()) {
+            condition(node.children[0], bodyBlock, endBlock);
+        }
+
+        startBlock(endBlock);
+    }
+
+    void visit(ReadStatNode &node) override {
+        int value = emitValue(IROp::Read, valueType(node.children[0]->semanticType));
+        store(place(node.children[0]), IROperand::vreg(value));
+    }
+
+    void visit(WriteStatNode &node) override {
+        emit(IROp::Write, -1, lower(node.children[0]));
+    }
+
+    void visit(ReturnStatNode &node) override {
+        emit(IROp::Return, -1, lower(node.children[0]));
+        // whatever follows in the block is unreachable, and dropped by finishFunction
+        startBlock(function->newBlock());
+    }
+
+    /* $end statements */
+
+    /* $begin expressions */
+
+    void visit(IntlitNode &node) override {
+        result = IROperand::imm(std::stoi(node.value));
+    }
+
+    void visit(FloatlitNode &node) override {
+        result = IROperand::imm((int)std::stod(node.value));
+    }
+
+    void visit(VariableNode &node) override {
+        result = load(place(&node));
+    }
+
+    void visit(IdNode &node) override {
+        // a bare id is only a variable under a dot or as an assignment target, which place it through their annotation
+    }
+
+    void visit(DotNode &node) override {
+        if (node.children[1]->type == ASTNodeType::FunctionCall) {
+            auto *memberCall = static_cast<FunctionCallNode*>(node.children[1]);
+            // a function inherited from another struct is given the subobject of that struct
+            Place object = objectPlace(node);
+            auto *objectStruct = scope->global->lookup(object.type, "struct")->link;
+            object.offset += subobjectOffset(objectStruct, memberCall->callee->link->enclosingStruct);
+            result = call(*memberCall, address(object));
+        } else {
+            result = load(place(&node));
+        }
+    }
+
+    void visit(FunctionCallNode &node) override {
+        result = call(node, IROperand());
+    }
+
+    void visit(AddOpNode &node) override {
+        IROperand lhs = lower(node.children[0]);
+        IROperand rhs = lower(node.children[1]);
+        if (node.value == "|") {
+            result = IROperand::vreg(emitValue(IROp::Or, IRType::Int, truth(node.children[0], lhs), truth(node.children[1], rhs)));
+        } else {
+            result = IROperand::vreg(emitValue(node.value == "+" ? IROp::Add : IROp::Sub, valueType(node.semanticType), lhs, rhs));
+        }
+    }
+
+    void visit(MultOpNode &node) override {
+        IROperand lhs = lower(node.children[0]);
+        IROperand rhs = lower(node.children[1]);
+        if (node.value == "&") {
+            result = IROperand::vreg(emitValue(IROp::And, IRType::Int, truth(node.children[0], lhs), truth(node.children[1], rhs)));
+        } else {
+            result = IROperand::vreg(emitValue(node.value == "*" ? IROp::Mul : IROp::Div, valueType(node.semanticType), lhs, rhs));
+        }
+    }
+
+    void visit(RelExprNode &node) override {
+        IROperand lhs = lower(node.children[0]);
+        IROperand rhs = lower(node.children[2]);
+        result = IROperand::vreg(emitValue(comparison(node.children[1]->value), IRType::Int, lhs, rhs));
+    }
+
+    void visit(NotNode &node) override {
+        result = IROperand::vreg(emitValue(IROp::Not, IRType::Int, lower(node.children[0])));
+    }
+
+    void visit(SignNode &node) override {
+        IROperand operand = lower(node.children[0]);
+        result = node.value == "-" ? IROperand::vreg(emitValue(IROp::Neg, valueType(node.semanticType), operand)) : operand;
+    }
+
+    /* $end expressions */
+
+    /* declarations lower to nothing, the layout of structs is known from their tables */
+
+    void visit(StructDeclNode &node) override {}
+    void visit(InheritListNode &node) override {}
+    void visit(AParamsListNode &node) override {}
+    void visit(ArraySizeListNode &node) override {}
+    void visit(AssignOpNode &node) override {}
+    void visit(FuncDeclNode &node) override {}
+    void visit(FParamNode &node) override {}
+    void visit(FParamListNode &node) override {}
+    void visit(IndiceListNode &node) override {}
+    void visit(MemberNode &node) override {}
+    void visit(RelOpNode &node) override {}
+    void visit(MemberListNode &node) override {}
+    void visit(TypeNode &node) override {}
+    void visit(VisibilityNode &node) override {}
+    void visit(EpsilonNode &node) override {}
+
+private:
+    /* where a local or a param lives: a virtual register, a frame slot, or the slot of the caller whose address a
+     * register holds */
+    struct Storage {
+        enum Kind { Register, Slot, Reference } kind;
+        int index;
+    };
+
+    /* a variable, member or array element: in a virtual register, or at base + offset */
+    struct Place {
+        int vreg;
+        IROperand base;
+        int offset;
+        TypeId type;
+    };
+
+    std::unordered_map<SymbolTableEntry*, IRFunction*> functions;
+    std::unordered_map<SymbolTableEntry*, Storage> storage;
+    std::unordered_set<int> variables; // virtual registers of the scalar locals and params
+    std::unordered_map<std::string, int> labels;
+    IRFunction *function = nullptr;
+    SymbolTable *scope = nullptr; // table of the function being lowered
+    std::vector<int> layout; // blocks in the order they were started
+    int block = 0;
+    int self = -1; // address of the object in a member function
+    IROperand result;
+
+    void declareFunction(ASTNode &funcDef) {
+        auto *entry = funcDef.symbolTableEntry;
+        auto *structTable = funcDef.symbolTable->enclosingStruct;
+        std::unique_ptr<IRFunction> irFunction(new IRFunction());
+
+        irFunction->name = structTable == nullptr ? entry->name : structTable->name + "::" + entry->name;
+        irFunction->isMain = structTable == nullptr && entry->name == "main";
+        irFunction->returnsValue = entry->type != TypeId::voidType();
+        irFunction->paramCount = (int)funcDef.children[1]->children.size() + (structTable == nullptr ? 0 : 1);
+        irFunction->label = newLabel(irFunction->isMain ? "main" : structTable == nullptr ? "f" + entry->name : "m" + structTable->name + entry->name);
+        functions[entry] = irFunction.get();
+
+        // member calls resolve to the declaration in the struct rather than to the definition in the impl
+        if (structTable != nullptr) {
+            for (auto *declaration : structTable->lookupAll(entry->name, "func")) {
+                if (sameParams(declaration->link, entry->link)) {
+                    functions[declaration] = irFunction.get();
+                }
+            }
+        }
+        program.functions.push_back(std::move(irFunction));
+    }
+
+    static bool sameParams(SymbolTable *a, SymbolTable *b) {
+        std::vector<SymbolTableEntry*> paramsA = a->lookupAllOfKind("param");
+        std::vector<SymbolTableEntry*> paramsB = b->lookupAllOfKind("param");
+        if (paramsA.size() != paramsB.size()) return false;
+        for (size_t i = 0; i < paramsA.size(); i++) {
+            if (paramsA[i]->type != paramsB[i]->type) return false;
+        }
+        return true;
+    }
+
+    /* a label no other function has, moon labels being global */
+    std::string newLabel(const std::string &name) {
+        int uses = labels[name]++;
+        return uses == 0 ? name : name + std::to_string(uses);
+    }
+
+    static IRType valueType(TypeId type) {
+        return type.element() == TypeId::floatType() ? IRType::Float : IRType::Int;
+    }
+
+    static IROp comparison(const std::string &op) {
+        if (op == "==") return IROp::Eq;
+        if (op == "<>" || op == "!=") return IROp::Ne;
+        if (op == "<") return IROp::Lt;
+        if (op == "<=") return IROp::Le;
+        if (op == ">") return IROp::Gt;
+        return IROp::Ge;
+    }
+
+    /* $begin emission */
+
+    IRInstr &emit(IROp op, int dst = -1, IROperand a = IROperand(), IROperand b = IROperand(), int imm = 0) {
+        auto &instrs = function->blocks[block].instrs;
+        instrs.emplace_back();
+        IRInstr &instr = instrs.back();
+        instr.op = op;
+        instr.dst = dst;
+        instr.a = a;
+        instr.b = b;
+        instr.imm = imm;
+        return instr;
+    }
+
+    int emitValue(IROp op, IRType type, IROperand a = IROperand(), IROperand b = IROperand(), int imm = 0) {
+        int dst = function->newVReg(type);
+        emit(op, dst, a, b, imm);
+        return dst;
+    }
+
+    int emitValue(IROp op, IRType type, IROperand a, int imm) {
+        return emitValue(op, type, a, IROperand(), imm);
+    }
+
+    bool terminated() const {
+        const auto &instrs = function->blocks[block].instrs;
+        return !instrs.empty() && instrs.back().isTerminator();
+    }
+
+    void startBlock(int id) {
+        block = id;
+        layout.push_back(id);
+    }
+
+    void jump(int target) {
+        if (!terminated()) {
+            emit(IROp::Jump).target = target;
+        }
+    }
+
+    void branch(IROperand condition, int target, int alt) {
+        IRInstr &instr = emit(IROp::Branch, -1, condition);
+        instr.target = target;
+        instr.alt = alt;
+    }
+
+    /* puts the blocks in the order they were started, then drops the code after a return */
+    void finishFunction() {
+        std::vector<int> renumbered(function->blocks.size(), -1);
+        std::vector<IRBlock> blocks;
+        for (int id : layout) {
+            renumbered[id] = (int)blocks.size();
+            blocks.push_back(std::move(function->blocks[id]));
+        }
+        for (auto &irBlock : blocks) {
+            IRInstr &last = irBlock.instrs.back();
+            if (last.target >= 0) last.target = renumbered[last.target];
+            if (last.alt >= 0) last.alt = renumbered[last.alt];
+        }
+        function->blocks = std::move(blocks);
+        removeUnreachableBlocks(*function);
+    }
+
+    /* $end emission */
+
+    IROperand lower(ASTNode *node) {
+        node->accept(*this);
+        return result;
+    }
+
+    /*
+     * branches to trueBlock if a condition holds and to falseBlock otherwise. The operands of | and & are tested one
+     * after the other, the second only if the first does not decide, and a ! swaps the blocks. The grammar makes every
+     * condition relational, so x <> 0 and x == 0 test x itself, which is how a condition gets to | and &.
+     * */
+    void condition(ASTNode *node, int trueBlock, int falseBlock) {
+        if (node->type == ASTNodeType::RelExpr && isZero(node->children[2])) {
+            const std::string &op = node->children[1]->value;
+            if (op == "<>" || op == "!=") {
+                condition(node->children[0], trueBlock, falseBlock);
+                return;
+            }
+            if (op == "==") {
+                condition(node->children[0], falseBlock, trueBlock);
+                return;
+            }
+        }
+
+        if (node->type == ASTNodeType::AddOp && node->value == "|") {
+            int rhsBlock = function->newBlock();
+            condition(node->children[0], trueBlock, rhsBlock);
+            startBlock(rhsBlock);
+            condition(node->children[1], trueBlock, falseBlock);
+        } else if (node->type == ASTNodeType::MultOp && node->value == "&") {
+            int rhsBlock = function->newBlock();
+            condition(node->children[0], rhsBlock, falseBlock);
+            startBlock(rhsBlock);
+            condition(node->children[1], trueBlock, falseBlock);
+        } else if (node->type == ASTNodeType::Not) {
+            condition(node->children[0], falseBlock, trueBlock);
+        } else {
+            branch(lower(node), trueBlock, falseBlock);
+        }
+    }
+
+    static bool isZero(ASTNode *node) {
+        return node->type == ASTNodeType::Intlit && std::stoi(node->value) == 0;
+    }
+
+    /* a value as 1 or 0, for the operands of | and & */
+    IROperand truth(ASTNode *node, IROperand value) {
+        bool isBoolean = node->type == ASTNodeType::RelExpr || node->type == ASTNodeType::Not
+                || (node->type == ASTNodeType::AddOp && node->value == "|") || (node->type == ASTNodeType::MultOp && node->value == "&");
+        if (isBoolean) return value;
+        return IROperand::vreg(emitValue(IROp::Ne, IRType::Int, value, IROperand::imm(0)));
+    }
+
+    IROperand call(FunctionCallNode &node, IROperand object) {
+        IRFunction *callee = functions[node.callee];
+        std::vector<IROperand> args;
+        if (!object.isNone()) {
+            args.push_back(object);
+        }
+        for (auto aparam : node.children[1]->children) {
+            // arrays and structs lower to their address
+            args.push_back(lower(aparam));
+        }
+
+        int dst = callee->returnsValue ? function->newVReg(valueType(node.callee->type)) : -1;
+        IRInstr &instr = emit(IROp::Call, dst);
+        instr.callee = callee;
+        instr.args = std::move(args);
+        if (dst < 0) return IROperand();
+        if (node.callee->type.isBase()) return IROperand::vreg(dst);
+
+        // a struct comes back as its address in the popped frame of the callee, which the next call overwrites
+        int size = sizeofType(node.callee->type, scope);
+        int slot = function->newSlot(callee->name + "()", size);
+        int copy = emitValue(IROp::FrameAddr, IRType::Addr, IROperand(), slot);
+        copyWords(IROperand::vreg(copy), 0, IROperand::vreg(dst), 0, size);
+        return IROperand::vreg(copy);
+    }
+
+    /* $begin places */
+
+    Place place(ASTNode *node) {
+        if (node->type == ASTNodeType::Dot) {
+            auto *member = static_cast<DotNode*>(node)->member;
+            Place object = objectPlace(*static_cast<DotNode*>(node));
+            Place field{-1, object.base, object.offset + member->offset, member->entry->type};
+            if (node->children[1]->type == ASTNodeType::Variable) {
+                index(field, node->children[1]->children[1]->children);
+            }
+            return field;
+        }
+
+        if (node->type == ASTNodeType::FunctionCall) {
+            // a struct returned by a call, copied to a slot of this frame
+            return Place{-1, lower(node), 0, node->semanticType};
+        }
+
+        Place variable = variablePlace(node->symbolTableEntry);
+        if (variable.vreg >= 0) return variable;
+
+        if (node->type == ASTNodeType::Variable) {
+            index(variable, node->children[1]->children);
+        }
+        return variable;
+    }
+
+    Place objectPlace(DotNode &dot) {
+        if (dot.children[0]->type == ASTNodeType::Id) {
+            return variablePlace(dot.operands[0].symbolTableEntry);
+        }
+        return place(dot.children[0]);
+    }
+
+    /* a whole variable of this frame, or a data member of the object of a member function */
+    Place variablePlace(SymbolTableEntry *entry) {
+        Place variable{-1, IROperand(), 0, entry->type};
+        auto it = storage.find(entry);
+        if (it == storage.end()) {
+            // a data member of the object of a member function
+            auto *member = scope->enclosingStruct->lookupMember(entry->name);
+            variable.base = IROperand::vreg(self);
+            variable.offset = member->offset;
+        } else if (it->second.kind == Storage::Register) {
+            variable.vreg = it->second.index;
+            return variable;
+        } else if (it->second.kind == Storage::Slot) {
+            variable.base = IROperand::vreg(emitValue(IROp::FrameAddr, IRType::Addr, IROperand(), it->second.index));
+        } else {
+            variable.base = IROperand::vreg(it->second.index);
+        }
+        return variable;
+    }
+
+    /* moves a place to one of its elements, row-major */
+    void index(Place &place, const ASTChildren &indices) {
+        if (indices.empty()) return;
+
+        const std::vector<int> &dims = place.type.info().dims;
+        TypeId element = place.type.element();
+        std::vector<int> strides(dims.size());
+        int stride = sizeofType(element, scope);
+        for (size_t k = dims.size(); k-- > 0;) {
+            strides[k] = stride;
+            stride *= dims[k];
+        }
+
+        for (size_t k = 0; k < indices.size(); k++) {
+            IROperand i = lower(indices[k]);
+            if (i.isImm()) {
+                place.offset += i.value * strides[k];
+            } else {
+                int scaled = emitValue(IROp::Mul, IRType::Int, i, IROperand::imm(strides[k]));
+                place.base = IROperand::vreg(emitValue(IROp::Add, IRType::Addr, place.base, IROperand::vreg(scaled)));
+            }
+        }
+        place.type = element;
+    }
+
+    IROperand address(const Place &place) {
+        if (place.offset == 0) return place.base;
+        return IROperand::vreg(emitValue(IROp::Add, IRType::Addr, place.base, IROperand::imm(place.offset)));
+    }
+
+    /* the value of a scalar, the address of an array or a struct */
+    IROperand load(const Place &place) {
+        if (place.vreg >= 0) return IROperand::vreg(place.vreg);
+        if (!place.type.isBase()) return address(place);
+        return IROperand::vreg(emitValue(IROp::Load, valueType(place.type), place.base, place.offset));
+    }
+
+    void store(const Place &place, IROperand value) {
+        if (place.vreg >= 0) {
+            // a value just computed is computed in the variable instead, sparing a copy and a register
+            auto &instrs = function->blocks[block].instrs;
+            if (value.isVReg() && variables.count(value.value) == 0 && !instrs.empty() && instrs.back().dst == value.value) {
+                instrs.back().dst = place.vreg;
+            } else {
+                emit(IROp::Copy, place.vreg, value);
+            }
+        } else if (place.type.isBase()) {
+            emit(IROp::Store, -1, place.base, value, place.offset);
+        } else {
+            copyWords(place.base, place.offset, value, 0, sizeofType(place.type, scope));
+        }
+    }
+
+    void copyWords(IROperand to, int toOffset, IROperand from, int fromOffset, int size) {
+        for (int word = 0; word < size; word += INT_SIZE) {
+            int value = emitValue(IROp::Load, IRType::Int, from, fromOffset + word);
+            emit(IROp::Store, -1, to, IROperand::vreg(value), toOffset + word);
+        }
+    }
+
+    /* $end places */
+};
+
+#endif //COMPILER_IRGEN_HPP
@@ -0,0 +1,262 @@
+#include <moon.hpp>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <unistd.h>
+
+const std::string indent = "          "; // len = 10
+const int indentLength = 10;
+
+const int MoonInstr::NO_SYMBOL;
+
+const char *moonOpName(MoonOp op) {
+    switch (op) {
+        case MoonOp::Add: return "add";
+        case MoonOp::Sub: return "sub";
+        case MoonOp::Mul: return "mul";
+        case MoonOp::Div: return "div";
+        case MoonOp::And: return "and";
+        case MoonOp::Or: return "or";
+        case MoonOp::Ceq: return "ceq";
+        case MoonOp::Cne: return "cne";
+        case MoonOp::Clt: return "clt";
+        case MoonOp::Cle: return "cle";
+        case MoonOp::Cgt: return "cgt";
+        case MoonOp::Cge: return "cge";
+        case MoonOp::Addi: return "addi";
+        case MoonOp::Subi: return "subi";
+        case MoonOp::Muli: return "muli";
+        case MoonOp::Divi: return "divi";
+        case MoonOp::Andi: return "andi";
+        case MoonOp::Ori: return "ori";
+        case MoonOp::Ceqi: return "ceqi";
+        case MoonOp::Cnei: return "cnei";
+        case MoonOp::Clti: return "clti";
+        case MoonOp::Clei: return "clei";
+        case MoonOp::Cgti: return "cgti";
+        case MoonOp::Cgei: return "cgei";
+        case MoonOp::Sl: return "sl";
+        case MoonOp::Lw: return "lw";
+        case MoonOp::Sw: return "sw";
+        case MoonOp::Bz: return "bz";
+        case MoonOp::Bnz: return "bnz";
+        case MoonOp::J: return "j";
+        case MoonOp::Jl: return "jl";
+        case MoonOp::Jr: return "jr";
+        case MoonOp::Putc: return "putc";
+        case MoonOp::Hlt: return "hlt";
+        case MoonOp::Nop: return "nop";
+        case MoonOp::Entry: return "entry";
+        case MoonOp::Align: return "align";
+        case MoonOp::Res: return "res";
+        case MoonOp::Label: return "label";
+        case MoonOp::Comment: return "%";
+    }
+    return "?";
+}
+
+namespace {
+
+/* formats moon lines in a buffer and hands it to flush whenever it fills up */
+class MoonWriter {
+public:
+    MoonWriter(const MoonCode &code, std::function<void(const char *, size_t)> flush)
+            : code(code), flush(std::move(flush)), buffer(CAPACITY) {}
+
+    void write() {
+        int pendingLabel = MoonInstr::NO_SYMBOL;
+        for (const auto &instr : code.instrs) {
+            if (instr.op == MoonOp::Comment) {
+                put(indent.data(), indentLength);
+                put("% ", 2);
+                put(code.symbols[instr.symbol]);
+                put('\n');
+            } else if (instr.op == MoonOp::Label) {
+                if (pendingLabel != MoonInstr::NO_SYMBOL) {
+                    nop(pendingLabel);
+                }
+                pendingLabel = instr.symbol;
+            } else {
+                linePrefix(pendingLabel);
+                text(instr);
+                put('\n');
+                pendingLabel = MoonInstr::NO_SYMBOL;
+            }
+        }
+        if (pendingLabel != MoonInstr::NO_SYMBOL) {
+            nop(pendingLabel);
+        }
+        flush(buffer.data(), used);
+        used = 0;
+    }
+
+private:
+    static const size_t CAPACITY = 1 << 16;
+    static const size_t LONGEST_NUMBER = 12;
+
+    const MoonCode &code;
+    std::function<void(const char *, size_t)> flush;
+    std::vector<char> buffer;
+    size_t used = 0;
+
+    void reserve(size_t size) {
+        if (used + size > CAPACITY) {
+            flush(buffer.data(), used);
+            used = 0;
+        }
+    }
+
+    void put(char c) {
+        reserve(1);
+        buffer[used++] = c;
+    }
+
+    void put(const char *text, size_t size) {
+        if (size > CAPACITY) {
+            reserve(CAPACITY);
+            flush(text, size);
+            return;
+        }
+        reserve(size);
+        std::memcpy(buffer.data() + used, text, size);
+        used += size;
+    }
+
+    void put(const std::string &text) {
+        put(text.data(), text.size());
+    }
+
+    void put(const char *text) {
+        put(text, std::strlen(text));
+    }
+
+    void number(int value) {
+        reserve(LONGEST_NUMBER);
+        // digits backwards, unsigned so the most negative int has its opposite
+        unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+        char digits[LONGEST_NUMBER];
+        size_t count = 0;
+        do {
+            digits[count++] = (char)('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude > 0);
+        if (value < 0) buffer[used++] = '-';
+        while (count > 0) buffer[used++] = digits[--count];
+    }
+
+    void reg(int number) {
+        put('r');
+        this->number(number);
+    }
+
+    /* k, or the symbol standing for it */
+    void immediate(const MoonInstr &instr) {
+        if (instr.symbol == MoonInstr::NO_SYMBOL) {
+            number(instr.k);
+        } else {
+            put(code.symbols[instr.symbol]);
+        }
+    }
+
+    /* the indent, or the label padded to it ; a label as long as the indent still needs a blank before the instruction */
+    void linePrefix(int label) {
+        if (label == MoonInstr::NO_SYMBOL) {
+            put(indent.data(), indentLength);
+            return;
+        }
+        const std::string &name = code.symbols[label];
+        put(' ');
+        put(name);
+        put(' ');
+        for (size_t length = name.size() + 2; length < (size_t)indentLength; length++) put(' ');
+    }
+
+    void nop(int label) {
+        linePrefix(label);
+        put("nop\n", 4);
+    }
+
+    void text(const MoonInstr &instr) {
+        put(moonOpName(instr.op));
+        if (instr.isOp3() || instr.isOpi()) {
+            put(' ');
+            reg(instr.ri);
+            put(',');
+            reg(instr.rj);
+            put(',');
+            if (instr.isOp3()) reg(instr.rk); else immediate(instr);
+            return;
+        }
+
+        switch (instr.op) {
+            case MoonOp::Lw:
+                put(' ');
+                reg(instr.ri);
+                put(',');
+                immediate(instr);
+                put('(');
+                reg(instr.rj);
+                put(')');
+                break;
+            case MoonOp::Sl:
+                put(' ');
+                reg(instr.ri);
+                put(',');
+                immediate(instr);
+                break;
+            case MoonOp::Sw:
+                put(' ');
+                immediate(instr);
+                put('(');
+                reg(instr.rj);
+                put("),", 2);
+                reg(instr.ri);
+                break;
+            case MoonOp::Bz: case MoonOp::Bnz: case MoonOp::Jl:
+                put(' ');
+                reg(instr.ri);
+                put(',');
+                put(code.symbols[instr.symbol]);
+                break;
+            case MoonOp::J:
+                put(' ');
+                put(code.symbols[instr.symbol]);
+                break;
+            case MoonOp::Jr: case MoonOp::Putc:
+                put(' ');
+                reg(instr.ri);
+                break;
+            case MoonOp::Res:
+                put(' ');
+                immediate(instr);
+                break;
+            default:
+                break;
+        }
+    }
+};
+
+}
+
+void writeMoon(const MoonCode &code, int fd) {
+    MoonWriter writer(code, [fd](const char *data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("cannot write the moon code: ") + std::strerror(errno));
+            }
+            data += written;
+            size -= (size_t)written;
+        }
+    });
+    writer.write();
+}
+
+void printMoon(const MoonCode &code, std::ostream &out) {
+    MoonWriter writer(code, [&out](const char *data, size_t size) {
+        out.write(data, (std::streamsize)size);
+    });
+    writer.write();
+}
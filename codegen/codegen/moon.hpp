@@ -0,0 +1,105 @@
+#ifndef COMPILER_MOON_HPP
+#define COMPILER_MOON_HPP
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* $begin moon */
+
+enum class MoonOp : unsigned char {
+    Add, Sub, Mul, Div, And, Or, Ceq, Cne, Clt, Cle, Cgt, Cge, // ri = rj op rk
+    Addi, Subi, Muli, Divi, Andi, Ori, Ceqi, Cnei, Clti, Clei, Cgti, Cgei, // ri = rj op k
+    Sl,     // ri = ri shifted left by k bits
+    Lw,     // ri = word at k(rj)
+    Sw,     // word at k(rj) = ri
+    Bz, Bnz, // to symbol if ri is, or is not, 0
+    J,      // to symbol
+    Jl,     // to symbol, ri = return address
+    Jr,     // to ri
+    Putc,   // prints the character in ri
+    Hlt, Nop, Entry, Align,
+    Res,    // reserves k bytes
+    Label,  // defines symbol at the next line
+    Comment // symbol is the text
+};
+
+/*
+ * One line of moon code. Registers are numbers, r0 to r15. symbol is the number, in MoonCode::symbols, of the label a
+ * branch goes to, of the symbolic value of an immediate when it is not k, e.g. topaddr, of the label a Label line
+ * defines or of the text of a comment, NO_SYMBOL if none.
+ * */
+struct MoonInstr {
+    static const int NO_SYMBOL = -1;
+
+    MoonOp op = MoonOp::Nop;
+    unsigned char ri = 0;
+    unsigned char rj = 0;
+    unsigned char rk = 0;
+    int k = 0;
+    int symbol = NO_SYMBOL;
+
+    MoonInstr() = default;
+    explicit MoonInstr(MoonOp op, int ri = 0, int rj = 0, int rk = 0, int k = 0)
+            : op(op), ri((unsigned char)ri), rj((unsigned char)rj), rk((unsigned char)rk), k(k) {}
+
+    bool isOp3() const { return op <= MoonOp::Cge; }
+    bool isOpi() const { return op >= MoonOp::Addi && op <= MoonOp::Cgei; }
+
+    /* the instructions after which the register values and memory may not be the ones of the instruction before */
+    bool isBarrier() const {
+        return op >= MoonOp::Bz && op != MoonOp::Putc && op != MoonOp::Nop && op != MoonOp::Comment;
+    }
+
+    /* the register the instruction sets, 0 if none */
+    int written() const {
+        return isOp3() || isOpi() || op == MoonOp::Sl || op == MoonOp::Lw || op == MoonOp::Jl ? ri : 0;
+    }
+
+    bool reads(int reg) const {
+        if (isOp3()) return rj == reg || rk == reg;
+        if (isOpi() || op == MoonOp::Lw) return rj == reg;
+        if (op == MoonOp::Sw) return ri == reg || rj == reg;
+        if (op == MoonOp::Sl || op == MoonOp::Bz || op == MoonOp::Bnz || op == MoonOp::Jr || op == MoonOp::Putc) {
+            return ri == reg;
+        }
+        return false;
+    }
+};
+
+/* the immediate form of a register op, e.g. addi for add */
+inline MoonOp immediateForm(MoonOp op) {
+    return (MoonOp)((int)op + (int)MoonOp::Addi);
+}
+
+/* the instructions of a program and the names their symbol numbers stand for */
+struct MoonCode {
+    std::vector<MoonInstr> instrs;
+    std::vector<std::string> symbols;
+
+    /* the number of a name, the same every time for one name */
+    int symbol(const std::string &name) {
+        auto found = numbers.find(name);
+        if (found != numbers.end()) return found->second;
+        symbols.push_back(name);
+        numbers.emplace(name, (int)symbols.size() - 1);
+        return (int)symbols.size() - 1;
+    }
+
+private:
+    std::unordered_map<std::string, int> numbers;
+};
+
+const char *moonOpName(MoonOp op);
+
+/*
+ * Write the listing of the code to a file descriptor or a stream. Lines are formatted in place in a buffer handed over
+ * whenever it fills up, so a listing costs a few writes and no string is built per line.
+ * */
+void writeMoon(const MoonCode &code, int fd);
+void printMoon(const MoonCode &code, std::ostream &out);
+
+/* $end moon */
+
+#endif //COMPILER_MOON_HPP
@@ -0,0 +1,204 @@
+#include <peephole.hpp>
+#include <algorithm>
+
+static bool sameAddress(const MoonInstr &a, const MoonInstr &b) {
+    return a.rj == b.rj && a.k == b.k && a.symbol == b.symbol;
+}
+
+/* dest = src, nothing if they are the same register */
+static void moveRegister(int dest, int src, std::vector<MoonInstr> &out) {
+    if (dest == src) return;
+    out.emplace_back(MoonOp::Addi, dest, src);
+}
+
+static void keep(const std::vector<MoonInstr> &code, size_t from, size_t to, std::vector<MoonInstr> &out) {
+    out.insert(out.end(), code.begin() + (long)from, code.begin() + (long)to);
+}
+
+static size_t end(const std::vector<MoonInstr> &code, size_t at, const PeepholeContext &context) {
+    return std::min(code.size(), at + 1 + context.window);
+}
+
+/* sw k(rb),ra ... lw rc,k(rb): the load gets ra */
+static size_t storeLoad(const std::vector<MoonInstr> &code, size_t at, const PeepholeContext &context, std::vector<MoonInstr> &out) {
+    const MoonInstr &store = code[at];
+    if (store.op != MoonOp::Sw) return 0;
+
+    for (size_t j = at + 1; j < end(code, at, context); j++) {
+        const MoonInstr &instr = code[j];
+        if (instr.op == MoonOp::Lw && sameAddress(instr, store)) {
+            keep(code, at, j, out);
+            moveRegister(instr.ri, store.ri, out);
+            return j - at + 1;
+        }
+        if (instr.isBarrier() || instr.op == MoonOp::Sw) return 0;
+        if (instr.written() == store.ri || instr.written() == store.rj) return 0;
+    }
+    return 0;
+}
+
+/* sw k(rb),ra ... sw k(rb),rc with nothing reading memory in between: the first store is dead */
+static size_t deadStore(const std::vector<MoonInstr> &code, size_t at, const PeepholeContext &context, std::vector<MoonInstr> &out) {
+    const MoonInstr &store = code[at];
+    if (store.op != MoonOp::Sw) return 0;
+
+    for (size_t j = at + 1; j < end(code, at, context); j++) {
+        const MoonInstr &instr = code[j];
+        if (instr.op == MoonOp::Sw && sameAddress(instr, store)) return 1;
+        if (instr.isBarrier() || instr.op == MoonOp::Lw || instr.op == MoonOp::Sw) return 0;
+        if (instr.written() == store.rj) return 0;
+    }
+    return 0;
+}
+
+/* lw ra,k(rb) ... lw rc,k(rb) with no store in between: the second load gets ra */
+static size_t redundantLoad(const std::vector<MoonInstr> &code, size_t at, const PeepholeContext &context, std::vector<MoonInstr> &out) {
+    const MoonInstr &load = code[at];
+    if (load.op != MoonOp::Lw || load.ri == load.rj) return 0;
+
+    for (size_t j = at + 1; j < end(code, at, context); j++) {
+        const MoonInstr &instr = code[j];
+        if (instr.op == MoonOp::Lw && sameAddress(instr, load)) {
+            keep(code, at, j, out);
+            moveRegister(instr.ri, load.ri, out);
+            return j - at + 1;
+        }
+        if (instr.isBarrier() || instr.op == MoonOp::Sw) return 0;
+        if (instr.written() == load.ri || instr.written() == load.rj) return 0;
+    }
+    return 0;
+}
+
+/*
+ * addi ra,rb,c then loads and stores at k(ra), until ra is set again: the loads and stores at k+c(rb), without the addi
+ * */
+static size_t addressOffset(const std::vector<MoonInstr> &code, size_t at, const PeepholeContext &context, std::vector<MoonInstr> &out) {
+    const MoonInstr &address = code[at];
+    int ra = address.ri;
+    int rb = address.rj;
+    if (address.op != MoonOp::Addi || address.symbol != MoonInstr::NO_SYMBOL || ra == rb || rb == 0) return 0;
+    bool readOnce = (context.deadAfterRead >> ra) & 1;
+
+    for (size_t j = at + 1; j < end(code, at, context); j++) {
+        const MoonInstr &instr = code[j];
+        bool isBaseUse = (instr.op == MoonOp::Lw || (instr.op == MoonOp::Sw && instr.ri != ra)) && instr.rj == ra;
+        if (!isBaseUse && instr.reads(ra)) return 0;
+        bool ends = instr.written() == ra || (isBaseUse && readOnce);
+        if (!ends && (instr.isBarrier() || instr.written() == rb)) return 0;
+        if (!ends) continue;
+
+        for (size_t i = at + 1; i <= j; i++) {
+            out.push_back(code[i]);
+            if ((code[i].op == MoonOp::Lw || code[i].op == MoonOp::Sw) && code[i].rj == ra) {
+                out.back().rj = (unsigned char)rb;
+                out.back().k += address.k;
+            }
+        }
+        return j - at + 1;
+    }
+    return 0;
+}
+
+/* the op computing the same with its operands swapped, if any */
+static bool swapped(MoonOp op, MoonOp &swappedOp) {
+    switch (op) {
+        case MoonOp::Add: case MoonOp::Mul: case MoonOp::And: case MoonOp::Or: case MoonOp::Ceq: case MoonOp::Cne:
+            swappedOp = op;
+            return true;
+        case MoonOp::Clt: swappedOp = MoonOp::Cgt; return true;
+        case MoonOp::Cle: swappedOp = MoonOp::Cge; return true;
+        case MoonOp::Cgt: swappedOp = MoonOp::Clt; return true;
+        case MoonOp::Cge: swappedOp = MoonOp::Cle; return true;
+        default: return false;
+    }
+}
+
+/* addi rx,r0,k then op rd,ra,rx, rx read nowhere else: opi rd,ra,k */
+static size_t immediateOperand(const std::vector<MoonInstr> &code, size_t at, const PeepholeContext &context, std::vector<MoonInstr> &out) {
+    const MoonInstr &constant = code[at];
+    if (constant.op != MoonOp::Addi || constant.rj != 0 || constant.symbol != MoonInstr::NO_SYMBOL) return 0;
+    if (at + 1 >= code.size()) return 0;
+    const MoonInstr &user = code[at + 1];
+    int rx = constant.ri;
+    if (!user.isOp3() || (user.rj == rx) == (user.rk == rx)) return 0;
+    if (user.ri != rx && !((context.deadAfterRead >> rx) & 1)) return 0;
+
+    MoonOp op = user.op;
+    int other = user.rj;
+    if (user.rj == rx) {
+        if (!swapped(user.op, op)) return 0;
+        other = user.rk;
+    }
+    out.emplace_back(immediateForm(op), user.ri, other, 0, constant.k);
+    return 2;
+}
+
+static bool isAdjust(const MoonInstr &instr) {
+    return (instr.op == MoonOp::Addi || instr.op == MoonOp::Subi) && instr.ri == instr.rj && instr.symbol == MoonInstr::NO_SYMBOL;
+}
+
+/* addi or subi of one register twice in a row, e.g. on r14 around a call: one adjustment */
+static size_t mergeAdjust(const std::vector<MoonInstr> &code, size_t at, const PeepholeContext &context, std::vector<MoonInstr> &out) {
+    if (at + 1 >= code.size() || !isAdjust(code[at]) || !isAdjust(code[at + 1]) || code[at].ri != code[at + 1].ri) return 0;
+
+    int delta = 0;
+    for (size_t j = at; j < at + 2; j++) {
+        delta += code[j].op == MoonOp::Addi ? code[j].k : -code[j].k;
+    }
+    int reg = code[at].ri;
+    out.emplace_back(delta >= 0 ? MoonOp::Addi : MoonOp::Subi, reg, reg, 0, delta >= 0 ? delta : -delta);
+    return 2;
+}
+
+/* addi ri,ri,0 and subi ri,ri,0 */
+static size_t selfMove(const std::vector<MoonInstr> &code, size_t at, const PeepholeContext &context, std::vector<MoonInstr> &out) {
+    return isAdjust(code[at]) && code[at].k == 0 ? 1 : 0;
+}
+
+/* j to one of the labels right after it */
+static size_t jumpToNext(const std::vector<MoonInstr> &code, size_t at, const PeepholeContext &context, std::vector<MoonInstr> &out) {
+    if (code[at].op != MoonOp::J) return 0;
+    for (size_t j = at + 1; j < code.size(); j++) {
+        if (code[j].op == MoonOp::Label && code[j].symbol == code[at].symbol) return 1;
+        if (code[j].op != MoonOp::Label && code[j].op != MoonOp::Comment) return 0;
+    }
+    return 0;
+}
+
+const std::vector<PeepholeRule> peepholeRules = {
+    {"store-load", storeLoad},
+    {"dead-store", deadStore},
+    {"redundant-load", redundantLoad},
+    {"immediate-operand", immediateOperand},
+    {"address-offset", addressOffset},
+    {"merge-adjust", mergeAdjust},
+    {"self-move", selfMove},
+    {"jump-to-next", jumpToNext},
+};
+
+void peephole(std::vector<MoonInstr> &code, const PeepholeContext &context, std::vector<size_t> &hits) {
+    hits.assign(peepholeRules.size(), 0);
+    std::vector<MoonInstr> out;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        out.clear();
+        out.reserve(code.size());
+        for (size_t at = 0; at < code.size();) {
+            size_t replaced = 0;
+            for (size_t r = 0; r < peepholeRules.size() && replaced == 0; r++) {
+                replaced = peepholeRules[r].apply(code, at, context, out);
+                if (replaced > 0) hits[r]++;
+            }
+            if (replaced == 0) {
+                out.push_back(code[at]);
+                replaced = 1;
+            } else {
+                changed = true;
+            }
+            at += replaced;
+        }
+        code.swap(out);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef COMPILER_PEEPHOLE_HPP
+#define COMPILER_PEEPHOLE_HPP
+
+#include <moon.hpp>
+
+/* $begin peephole */
+
+struct PeepholeContext {
+    size_t window;         // how many instructions a rule may look ahead
+    unsigned deadAfterRead; // bit r set if the value in register r is never read twice, e.g. a scratch register
+};
+
+/*
+ * A rule looks at the code starting at an instruction, at most window instructions ahead. If it applies, it appends
+ * what replaces the instructions it looked at to out and returns how many it replaced, else it returns 0.
+ * */
+struct PeepholeRule {
+    const char *name;
+    size_t (*apply)(const std::vector<MoonInstr> &code, size_t at, const PeepholeContext &context, std::vector<MoonInstr> &out);
+};
+
+extern const std::vector<PeepholeRule> peepholeRules;
+
+/*
+ * Rewrites moon code with the rules until none applies. The first rule applying at an instruction is the one
+ * applied, and hits counts, by rule, how many times each one was.
+ * */
+void peephole(std::vector<MoonInstr> &code, const PeepholeContext &context, std::vector<size_t> &hits);
+
+/* $end peephole */
+
+#endif //COMPILER_PEEPHOLE_HPP
@@ -0,0 +1,239 @@
+#include <regalloc.hpp>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+namespace {
+
+/* a set of virtual registers */
+struct VRegSet {
+    std::vector<uint64_t> words;
+
+    explicit VRegSet(size_t size = 0) : words((size + 63) / 64, 0) {}
+
+    void insert(int vreg) {
+        words[vreg / 64] |= uint64_t(1) << (vreg % 64);
+    }
+
+    bool contains(int vreg) const {
+        return (words[vreg / 64] >> (vreg % 64)) & 1;
+    }
+
+    bool operator!=(const VRegSet &other) const {
+        return words != other.words;
+    }
+
+    template<class F>
+    void forEach(F f) const {
+        for (size_t w = 0; w < words.size(); w++) {
+            for (uint64_t bits = words[w]; bits != 0; bits &= bits - 1) {
+                int bit = 0;
+                while (!((bits >> bit) & 1)) bit++;
+                f((int)(w * 64) + bit);
+            }
+        }
+    }
+};
+
+}
+
+/*
+ * the usual backward dataflow: a register is live into a block if the block reads it before writing it, or if it is
+ * live out of the block and the block does not write it
+ * */
+std::vector<LiveInterval> computeLiveIntervals(const IRFunction &function) {
+    size_t blockCount = function.blocks.size();
+    size_t vregCount = function.vregs.size();
+    std::vector<VRegSet> uses(blockCount, VRegSet(vregCount));
+    std::vector<VRegSet> defs(blockCount, VRegSet(vregCount));
+    std::vector<VRegSet> liveIn(blockCount, VRegSet(vregCount));
+    std::vector<VRegSet> liveOut(blockCount, VRegSet(vregCount));
+    std::vector<int> firstPosition(blockCount);
+    std::vector<int> used;
+
+    int position = 0;
+    for (size_t b = 0; b < blockCount; b++) {
+        firstPosition[b] = position;
+        for (const auto &instr : function.blocks[b].instrs) {
+            used.clear();
+            vregUses(instr, used);
+            for (int vreg : used) {
+                if (!defs[b].contains(vreg)) uses[b].insert(vreg);
+            }
+            if (instr.dst >= 0) defs[b].insert(instr.dst);
+            position++;
+        }
+    }
+
+    // blocks are visited last to first, which follows most edges backward and settles in a few rounds
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = blockCount; b-- > 0;) {
+            const IRInstr &last = function.blocks[b].instrs.back();
+            VRegSet out(vregCount);
+            for (int successor : {last.target, last.alt}) {
+                if (successor < 0) continue;
+                for (size_t w = 0; w < out.words.size(); w++) {
+                    out.words[w] |= liveIn[successor].words[w];
+                }
+            }
+            VRegSet in(vregCount);
+            for (size_t w = 0; w < in.words.size(); w++) {
+                in.words[w] = uses[b].words[w] | (out.words[w] & ~defs[b].words[w]);
+            }
+            if (in != liveIn[b]) {
+                liveIn[b] = std::move(in);
+                changed = true;
+            }
+            liveOut[b] = std::move(out);
+        }
+    }
+
+    std::vector<int> start(vregCount, INT_MAX);
+    std::vector<int> end(vregCount, -1);
+    auto extend = [&](int vreg, int at) {
+        start[vreg] = std::min(start[vreg], at);
+        end[vreg] = std::max(end[vreg], at);
+    };
+
+    position = 0;
+    for (size_t b = 0; b < blockCount; b++) {
+        const auto &instrs = function.blocks[b].instrs;
+        liveIn[b].forEach([&](int vreg) { extend(vreg, firstPosition[b]); });
+        liveOut[b].forEach([&](int vreg) { extend(vreg, firstPosition[b] + (int)instrs.size() - 1); });
+        for (const auto &instr : instrs) {
+            used.clear();
+            vregUses(instr, used);
+            for (int vreg : used) extend(vreg, position);
+            if (instr.dst >= 0) extend(instr.dst, position);
+            position++;
+        }
+    }
+
+    std::vector<LiveInterval> intervals;
+    for (size_t vreg = 0; vreg < vregCount; vreg++) {
+        if (end[vreg] >= 0) {
+            intervals.push_back(LiveInterval{(int)vreg, start[vreg], end[vreg]});
+        }
+    }
+    std::stable_sort(intervals.begin(), intervals.end(), [](const LiveInterval &a, const LiveInterval &b) {
+        return a.start < b.start;
+    });
+    return intervals;
+}
+
+/* a home read where another is written holds both, the read going first */
+static void assignHomes(const std::vector<LiveInterval> &intervals, RegisterAllocation &allocation) {
+    allocation.homes.assign(allocation.registers.size(), -1);
+    std::vector<int> freeAfter; // by home, the end of the last interval in it
+
+    for (const auto &interval : intervals) {
+        if (!allocation.isSpilled(interval.vreg)) continue;
+        int home = 0;
+        while (home < (int)freeAfter.size() && freeAfter[home] > interval.start) home++;
+        if (home == (int)freeAfter.size()) freeAfter.push_back(0);
+        freeAfter[home] = interval.end;
+        allocation.homes[interval.vreg] = home;
+    }
+    allocation.homeCount = (int)freeAfter.size();
+}
+
+RegisterAllocation allocateRegisters(const IRFunction &function, CallingConvention convention) {
+    std::vector<LiveInterval> intervals = computeLiveIntervals(function);
+    bool inRegisters = convention == CallingConvention::Registers;
+
+    std::vector<const IRInstr*> instrAt;
+    std::vector<int> libCalls; // positions of the writes and reads, and of the calls clobbering r1-r4 as well
+    std::vector<int> incomingUntil(RegisterAllocation::LAST + 1, -1); // where each param in a register is read
+    for (const auto &block : function.blocks) {
+        for (const auto &instr : block.instrs) {
+            bool clobbers = instr.op == IROp::Write || instr.op == IROp::Read || (inRegisters && instr.op == IROp::Call);
+            if (clobbers) {
+                libCalls.push_back((int)instrAt.size());
+            }
+            if (inRegisters && instr.op == IROp::Param && instr.imm < RegisterAllocation::ARGUMENTS) {
+                incomingUntil[instr.imm + 1] = (int)instrAt.size();
+            }
+            instrAt.push_back(&instr);
+        }
+    }
+
+    RegisterAllocation allocation;
+    allocation.registers.assign(function.vregs.size(), -1);
+    allocation.written.assign(RegisterAllocation::LAST + 1, false);
+    if (!libCalls.empty()) {
+        for (int reg = RegisterAllocation::FIRST; reg <= RegisterAllocation::LAST_CLOBBERED; reg++) {
+            allocation.written[reg] = true;
+        }
+    }
+
+    std::vector<bool> taken(RegisterAllocation::LAST + 1, false);
+    for (int reg = RegisterAllocation::FIRST; reg <= RegisterAllocation::LAST; reg++) {
+        taken[reg] = incomingUntil[reg] >= 0;
+    }
+    std::vector<const LiveInterval*> active;
+
+    for (const auto &current : intervals) {
+        for (int reg = RegisterAllocation::FIRST; reg <= RegisterAllocation::LAST; reg++) {
+            if (incomingUntil[reg] >= 0 && incomingUntil[reg] <= current.start) {
+                taken[reg] = false;
+                incomingUntil[reg] = -1;
+            }
+        }
+
+        // a register whose interval ends where this one starts is read there before this one is written
+        for (auto it = active.begin(); it != active.end();) {
+            if ((*it)->end <= current.start) {
+                taken[allocation.registers[(*it)->vreg]] = false;
+                it = active.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        auto call = std::upper_bound(libCalls.begin(), libCalls.end(), current.start);
+        bool crossesLibCall = call != libCalls.end() && *call < current.end;
+        int first = crossesLibCall ? RegisterAllocation::LAST_CLOBBERED + 1 : RegisterAllocation::FIRST;
+
+        int reg = 0;
+        // a copy, or a shift moon does in place, takes the register of its source when the source dies there
+        const IRInstr *def = instrAt[current.start];
+        bool inPlace = def->op == IROp::Copy || def->op == IROp::Shl;
+        int hint = 0;
+        if (inPlace && def->dst == current.vreg && def->a.isVReg()) {
+            hint = allocation.registers[def->a.value];
+        } else if (inRegisters && def->op == IROp::Param && def->dst == current.vreg) {
+            hint = def->imm < RegisterAllocation::ARGUMENTS ? def->imm + 1 : 0;
+        }
+        if (hint >= first && !taken[hint]) reg = hint;
+        for (int r = first; reg == 0 && r <= RegisterAllocation::LAST; r++) {
+            if (!taken[r]) reg = r;
+        }
+
+        if (reg == 0) {
+            auto victim = active.end();
+            for (auto it = active.begin(); it != active.end(); ++it) {
+                if (allocation.registers[(*it)->vreg] >= first && (victim == active.end() || (*it)->end > (*victim)->end)) {
+                    victim = it;
+                }
+            }
+            allocation.spills++;
+            if (victim == active.end() || (*victim)->end <= current.end) {
+                allocation.registers[current.vreg] = 0;
+                continue;
+            }
+            reg = allocation.registers[(*victim)->vreg];
+            allocation.registers[(*victim)->vreg] = 0;
+            active.erase(victim);
+        }
+
+        allocation.registers[current.vreg] = reg;
+        allocation.written[reg] = true;
+        taken[reg] = true;
+        active.push_back(&current);
+    }
+
+    assignHomes(intervals, allocation);
+    return allocation;
+}
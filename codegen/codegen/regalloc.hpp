@@ -0,0 +1,67 @@
+#ifndef COMPILER_REGALLOC_HPP
+#define COMPILER_REGALLOC_HPP
+
+#include <ir.hpp>
+
+/* $begin liveness */
+
+/*
+ * Instructions are numbered in layout order, from 0. The interval of a virtual register spans every position it is
+ * live at, from its first definition or live-in block to its last use or live-out block, holes included.
+ * */
+struct LiveInterval {
+    int vreg;
+    int start;
+    int end;
+};
+
+/* intervals of the virtual registers a function defines or uses, by increasing start */
+std::vector<LiveInterval> computeLiveIntervals(const IRFunction &function);
+
+/* $end liveness */
+
+/* $begin allocation */
+
+/*
+ * How calls pass their arguments and value.
+ * Stack: the arguments go in the params of the callee's frame and its value in the return value word, and a function
+ * saves every register it writes.
+ * Registers: the first ARGUMENTS arguments go in r1 and up, the others in the callee's frame, and the value comes back
+ * in r13, like the lib.m routines do. A call clobbers r1-r4 the way a write or a read does, so a function only saves
+ * the registers it writes from r5 up. A leaf function, one calling nothing, not even the lib.m routines, keeps its
+ * frame below SP, saving neither r15 nor the frame pointer of its caller.
+ * */
+enum class CallingConvention { Stack, Registers };
+
+/*
+ * Linear scan over r1-r9: intervals are visited by increasing start and take a register no active interval holds,
+ * and when there is none, the interval ending last, either the new one or an active one, is spilled to its home in
+ * the frame. r10 and r11 stay free to load spilled operands into.
+ * The lib.m routines behind write and read clobber r1-r4, so an interval live across one only takes r5-r9, as well as
+ * across a call passing arguments in registers. A param coming in a register keeps it until it is read, and takes
+ * it then if it can.
+ * Spilled intervals are then packed into homes the same way, greedily by start, so registers spilled at different
+ * times share a home and the frame only grows with the spills live at once.
+ * */
+struct RegisterAllocation {
+    static const int FIRST = 1;
+    static const int LAST = 9;
+    static const int LAST_CLOBBERED = 4; // by the lib.m routines
+    static const int ARGUMENTS = 4; // in r1-r4 when passed in registers
+
+    std::vector<int> registers; // of each virtual register, 0 if spilled
+    std::vector<bool> written;  // by register number, including the ones the lib.m routines clobber
+    std::vector<int> homes;     // of each spilled virtual register, numbered from 0
+    int homeCount = 0;
+    int spills = 0;
+
+    bool isSpilled(int vreg) const {
+        return registers[vreg] == 0;
+    }
+};
+
+RegisterAllocation allocateRegisters(const IRFunction &function, CallingConvention convention);
+
+/* $end allocation */
+
+#endif //COMPILER_REGALLOC_HPP
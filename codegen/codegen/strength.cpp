@@ -0,0 +1,394 @@
+#include <strength.hpp>
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+
+using Blocks = std::vector<std::vector<int>>;
+
+Blocks predecessors(const IRFunction &function) {
+    Blocks preds(function.blocks.size());
+    for (size_t b = 0; b < function.blocks.size(); b++) {
+        const IRInstr &last = function.blocks[b].instrs.back();
+        if (last.target >= 0) preds[last.target].push_back((int)b);
+        if (last.alt >= 0 && last.alt != last.target) preds[last.alt].push_back((int)b);
+    }
+    return preds;
+}
+
+/* dominates[b][d] if every path from the first block to b goes through d */
+std::vector<std::vector<bool>> dominators(const Blocks &preds) {
+    size_t count = preds.size();
+    std::vector<std::vector<bool>> dominates(count, std::vector<bool>(count, true));
+    dominates[0].assign(count, false);
+    dominates[0][0] = true;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = 1; b < count; b++) {
+            std::vector<bool> common(count, !preds[b].empty());
+            for (int pred : preds[b]) {
+                for (size_t d = 0; d < count; d++) {
+                    common[d] = common[d] && dominates[pred][d];
+                }
+            }
+            common[b] = true;
+            if (common != dominates[b]) {
+                dominates[b] = std::move(common);
+                changed = true;
+            }
+        }
+    }
+    return dominates;
+}
+
+/* a header, the target of jumps back from blocks it dominates, and the blocks reaching those jumps without passing it */
+struct Loop {
+    int header;
+    std::vector<bool> body;
+};
+
+std::vector<Loop> findLoops(const IRFunction &function, const Blocks &preds) {
+    auto dominates = dominators(preds);
+    std::map<int, Loop> loops;
+    for (size_t b = 0; b < function.blocks.size(); b++) {
+        const IRInstr &last = function.blocks[b].instrs.back();
+        for (int header : {last.target, last.alt}) {
+            if (header < 0 || !dominates[b][header]) continue;
+
+            auto it = loops.find(header);
+            if (it == loops.end()) {
+                it = loops.emplace(header, Loop{header, std::vector<bool>(function.blocks.size(), false)}).first;
+                it->second.body[header] = true;
+            }
+            std::vector<int> work{(int)b};
+            while (!work.empty()) {
+                int block = work.back();
+                work.pop_back();
+                if (it->second.body[block]) continue;
+                it->second.body[block] = true;
+                work.insert(work.end(), preds[block].begin(), preds[block].end());
+            }
+        }
+    }
+
+    std::vector<Loop> result;
+    for (auto &entry : loops) {
+        result.push_back(std::move(entry.second));
+    }
+    return result;
+}
+
+IRInstr instruction(IROp op, int dst, IROperand a, IROperand b = IROperand(), int imm = 0) {
+    IRInstr instr;
+    instr.op = op;
+    instr.dst = dst;
+    instr.a = a;
+    instr.b = b;
+    instr.imm = imm;
+    return instr;
+}
+
+/* iv * scale + offset */
+struct Affine {
+    int iv;
+    int scale;
+    int offset;
+};
+
+/* where a pointer starts: the address in a virtual register the loop does not assign, or of a frame slot */
+struct Base {
+    bool isSlot;
+    int index;
+};
+
+struct Pointer {
+    int vreg;
+    int iv;
+    int scale;
+    Base base;
+};
+
+/* an address the pointer holds at offset */
+struct PointerUse {
+    int pointer;
+    int offset;
+    int iv;
+};
+
+class LoopReduction {
+public:
+    LoopReduction(IRFunction &function, const Loop &loop, const Blocks &preds)
+            : function(function), loop(loop), preds(preds) {}
+
+    void run() {
+        if (loop.header == 0) return;
+        findInductions();
+        if (steps.empty()) return;
+
+        for (size_t b = 0; b < function.blocks.size(); b++) {
+            if (loop.body[b]) rewriteBlock(function.blocks[b]);
+        }
+        if (pointers.empty()) return;
+
+        initPointers();
+        stepPointers();
+    }
+
+private:
+    IRFunction &function;
+    const Loop &loop;
+    const Blocks &preds;
+
+    std::vector<int> defs; // in the loop, by virtual register
+    std::unordered_map<int, int> steps; // of each induction variable
+    std::unordered_map<int, std::pair<int, size_t>> stepAt; // block and index of the one assignment of each
+    std::vector<Pointer> pointers;
+    std::map<std::tuple<int, int, bool, int>, int> pointerIndex; // of each pointer, by induction variable, scale and base
+
+    void findInductions() {
+        defs.assign(function.vregs.size(), 0);
+        std::unordered_map<int, std::pair<int, size_t>> lastDef;
+        for (size_t b = 0; b < function.blocks.size(); b++) {
+            if (!loop.body[b]) continue;
+            const auto &instrs = function.blocks[b].instrs;
+            for (size_t k = 0; k < instrs.size(); k++) {
+                if (instrs[k].dst < 0) continue;
+                defs[instrs[k].dst]++;
+                lastDef[instrs[k].dst] = std::make_pair((int)b, k);
+            }
+        }
+
+        for (const auto &entry : lastDef) {
+            int vreg = entry.first;
+            if (defs[vreg] != 1) continue;
+            const IRInstr &instr = function.blocks[entry.second.first].instrs[entry.second.second];
+            bool selfFirst = instr.a.isVReg() && instr.a.value == vreg && instr.b.isImm();
+            bool selfSecond = instr.b.isVReg() && instr.b.value == vreg && instr.a.isImm();
+            if (instr.op == IROp::Add && (selfFirst || selfSecond)) {
+                steps[vreg] = selfFirst ? instr.b.value : instr.a.value;
+            } else if (instr.op == IROp::Sub && selfFirst) {
+                steps[vreg] = (int)(0u - (unsigned)instr.b.value);
+            } else {
+                continue;
+            }
+            stepAt[vreg] = entry.second;
+        }
+    }
+
+    /* rewrites the addresses computed from induction variables in a block, and the loads and stores at them */
+    void rewriteBlock(IRBlock &block) {
+        std::unordered_map<int, Affine> affine;
+        std::unordered_map<int, Base> bases; // virtual registers the loop assigns the same address every time
+        std::unordered_map<int, PointerUse> pointerUses;
+
+        for (auto &instr : block.instrs) {
+            if ((instr.op == IROp::Load || instr.op == IROp::Store) && instr.a.isVReg()) {
+                auto it = pointerUses.find(instr.a.value);
+                if (it != pointerUses.end()) {
+                    instr.a = IROperand::vreg(pointers[it->second.pointer].vreg);
+                    instr.imm += it->second.offset;
+                }
+            }
+            if (instr.dst < 0) continue;
+            int dst = instr.dst;
+
+            // what the instruction computes, from what its operands held before it
+            bool isAffine = false;
+            Affine value{};
+            bool isAddress = false;
+            int pointer = -1;
+            if (steps.count(dst) == 0) {
+                isAffine = affineOf(instr, affine, value);
+                if (!isAffine && function.vregs[dst] == IRType::Addr) {
+                    isAddress = pointerOf(instr, affine, bases, pointer, value);
+                }
+            }
+
+            affine.erase(dst);
+            bases.erase(dst);
+            pointerUses.erase(dst);
+            if (steps.count(dst) > 0) {
+                // the pointers move along with it after this, so what was computed from it before is stale
+                for (auto it = affine.begin(); it != affine.end();) {
+                    it = it->second.iv == dst ? affine.erase(it) : std::next(it);
+                }
+                for (auto it = pointerUses.begin(); it != pointerUses.end();) {
+                    it = it->second.iv == dst ? pointerUses.erase(it) : std::next(it);
+                }
+            }
+
+            if (isAffine) {
+                affine[dst] = value;
+            } else if (isAddress) {
+                IROperand start = IROperand::vreg(pointers[pointer].vreg);
+                instr = value.offset == 0 ? instruction(IROp::Copy, dst, start)
+                                          : instruction(IROp::Add, dst, start, IROperand::imm(value.offset));
+                pointerUses[dst] = PointerUse{pointer, value.offset, value.iv};
+            } else if (instr.op == IROp::FrameAddr) {
+                bases[dst] = Base{true, instr.imm};
+            } else if (instr.op == IROp::Copy && function.vregs[dst] == IRType::Addr) {
+                Base base{};
+                if (baseOf(instr.a, bases, base)) bases[dst] = base;
+            }
+        }
+    }
+
+    bool affineOf(const IROperand &operand, const std::unordered_map<int, Affine> &affine, Affine &value) {
+        if (!operand.isVReg()) return false;
+        if (steps.count(operand.value) > 0) {
+            value = Affine{operand.value, 1, 0};
+            return true;
+        }
+        auto it = affine.find(operand.value);
+        if (it == affine.end()) return false;
+        value = it->second;
+        return true;
+    }
+
+    /* whether an instruction computes iv * scale + offset, wrapping around like moon does */
+    bool affineOf(const IRInstr &instr, const std::unordered_map<int, Affine> &affine, Affine &value) {
+        const IROperand &a = instr.a;
+        const IROperand &b = instr.b;
+        switch (instr.op) {
+            case IROp::Copy:
+                return affineOf(a, affine, value);
+            case IROp::Add:
+                if (b.isImm() && affineOf(a, affine, value)) {
+                    value.offset = (int)((unsigned)value.offset + (unsigned)b.value);
+                    return true;
+                }
+                if (a.isImm() && affineOf(b, affine, value)) {
+                    value.offset = (int)((unsigned)value.offset + (unsigned)a.value);
+                    return true;
+                }
+                return false;
+            case IROp::Sub:
+                if (!b.isImm() || !affineOf(a, affine, value)) return false;
+                value.offset = (int)((unsigned)value.offset - (unsigned)b.value);
+                return true;
+            case IROp::Mul: {
+                int factor;
+                if (b.isImm() && affineOf(a, affine, value)) factor = b.value;
+                else if (a.isImm() && affineOf(b, affine, value)) factor = a.value;
+                else return false;
+                value.scale = (int)((unsigned)value.scale * (unsigned)factor);
+                value.offset = (int)((unsigned)value.offset * (unsigned)factor);
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    bool baseOf(const IROperand &operand, const std::unordered_map<int, Base> &bases, Base &base) {
+        if (!operand.isVReg()) return false;
+        auto it = bases.find(operand.value);
+        if (it != bases.end()) {
+            base = it->second;
+            return true;
+        }
+        base = Base{false, operand.value};
+        return defs[operand.value] == 0;
+    }
+
+    /* whether an instruction adds an affine index to a base, and the pointer holding the sum less the offset if so */
+    bool pointerOf(const IRInstr &instr, const std::unordered_map<int, Affine> &affine,
+                   const std::unordered_map<int, Base> &bases, int &pointer, Affine &value) {
+        if (instr.op != IROp::Add || !instr.a.isVReg() || !instr.b.isVReg()) return false;
+
+        for (int swap = 0; swap < 2; swap++) {
+            const IROperand &base = swap == 0 ? instr.a : instr.b;
+            const IROperand &index = swap == 0 ? instr.b : instr.a;
+            if (!affineOf(index, affine, value) || value.scale == 0) continue;
+
+            Base start{};
+            if (!baseOf(base, bases, start)) continue;
+
+            auto key = std::make_tuple(value.iv, value.scale, start.isSlot, start.index);
+            auto it = pointerIndex.find(key);
+            if (it == pointerIndex.end()) {
+                pointers.push_back(Pointer{function.newVReg(IRType::Addr), value.iv, value.scale, start});
+                it = pointerIndex.emplace(key, (int)pointers.size() - 1).first;
+            }
+            pointer = it->second;
+            return true;
+        }
+        return false;
+    }
+
+    /* before the jump of every block entering the loop from outside: pointer = base + iv * scale */
+    void initPointers() {
+        for (int pred : preds[loop.header]) {
+            if (loop.body[pred]) continue;
+            auto &instrs = function.blocks[pred].instrs;
+            std::vector<IRInstr> init;
+            for (const auto &pointer : pointers) {
+                int scaled = function.newVReg(IRType::Int);
+                init.push_back(instruction(IROp::Mul, scaled, IROperand::vreg(pointer.iv), IROperand::imm(pointer.scale)));
+                int base = pointer.base.index;
+                if (pointer.base.isSlot) {
+                    base = function.newVReg(IRType::Addr);
+                    init.push_back(instruction(IROp::FrameAddr, base, IROperand(), IROperand(), pointer.base.index));
+                }
+                init.push_back(instruction(IROp::Add, pointer.vreg, IROperand::vreg(base), IROperand::vreg(scaled)));
+            }
+            instrs.insert(instrs.end() - 1, init.begin(), init.end());
+        }
+    }
+
+    /* right after the induction variable moves: pointer = pointer + step * scale */
+    void stepPointers() {
+        std::vector<std::pair<std::pair<int, size_t>, IRInstr>> moves;
+        for (const auto &pointer : pointers) {
+            auto delta = (int)((unsigned)steps[pointer.iv] * (unsigned)pointer.scale);
+            IROperand self = IROperand::vreg(pointer.vreg);
+            moves.emplace_back(stepAt[pointer.iv], instruction(IROp::Add, pointer.vreg, self, IROperand::imm(delta)));
+        }
+        // from the last position back, so inserting does not move the ones left
+        std::stable_sort(moves.begin(), moves.end(), [](const std::pair<std::pair<int, size_t>, IRInstr> &x,
+                                                        const std::pair<std::pair<int, size_t>, IRInstr> &y) {
+            return x.first > y.first;
+        });
+        for (const auto &move : moves) {
+            auto &instrs = function.blocks[move.first.first].instrs;
+            instrs.insert(instrs.begin() + (long)move.first.second + 1, move.second);
+        }
+    }
+};
+
+/* the power of two a value is, -1 if none */
+int log2Exact(int value) {
+    if (value <= 1 || (value & (value - 1)) != 0) return -1;
+    int bits = 0;
+    while ((1 << bits) != value) bits++;
+    return bits;
+}
+
+void shiftPowersOfTwo(IRFunction &function) {
+    for (auto &block : function.blocks) {
+        for (auto &instr : block.instrs) {
+            if (instr.op != IROp::Mul) continue;
+            if (instr.a.isImm() && instr.b.isVReg()) std::swap(instr.a, instr.b);
+            if (!instr.a.isVReg() || !instr.b.isImm()) continue;
+            int bits = log2Exact(instr.b.value);
+            if (bits < 0) continue;
+            instr.op = IROp::Shl;
+            instr.b = IROperand::imm(bits);
+        }
+    }
+}
+
+}
+
+void reduceStrength(IRFunction &function) {
+    Blocks preds = predecessors(function);
+    for (const auto &loop : findLoops(function, preds)) {
+        LoopReduction(function, loop, preds).run();
+    }
+    shiftPowersOfTwo(function);
+    removeDeadCode(function);
+}
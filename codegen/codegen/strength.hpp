@@ -0,0 +1,16 @@
+#ifndef COMPILER_STRENGTH_HPP
+#define COMPILER_STRENGTH_HPP
+
+#include <ir.hpp>
+
+/*
+ * Strength reduction over the IR of a function.
+ * In a loop, a virtual register the loop only assigns by adding or subtracting a constant, e.g. i = i + 1, is an
+ * induction variable. An address base + i * scale + offset, the base being the same all through the loop, is read
+ * off a pointer instead: the pointer is set to base + i * scale before the loop and moved by step * scale right
+ * after i is, so arr[i] costs one add per iteration rather than a multiplication and an add per access.
+ * Last, multiplications by a power of two become shifts.
+ * */
+void reduceStrength(IRFunction &function);
+
+#endif //COMPILER_STRENGTH_HPP
@@ -0,0 +1,93 @@
+#include<gtest/gtest.h>
+#include<codegen.hpp>
+#include<parser.hpp>
+#include<moonsim.hpp>
+#include<fstream>
+#include<sstream>
+#include<tuple>
+
+static std::map<TableKey, ProductionRule> &grammarTable() {
+    static std::map<TableKey, ProductionRule> TT;
+    if (TT.empty()) {
+        parseCSVIntoTT(GRAMMAR_TABLE, TT);
+    }
+    return TT;
+}
+
+/* the whole file, empty if there is none */
+static std::string readFile(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+/* the moon code of a program, empty if it does not parse or check */
+static std::string compile(const std::string &source, const CodegenOptions &options) {
+    std::ofstream devnull("/dev/null");
+    Lexer lexer = lexerNew(source.c_str());
+    ASTNode *root = parse(lexer, grammarTable(), devnull, devnull, devnull, ASTDumpNone);
+    lexerFree(&lexer);
+    if (root == nullptr) return "";
+
+    std::ostringstream symfile, symerrors, code;
+    if (semanticAnalysis(*root, symfile, symerrors)) {
+        computeSizes(*root);
+        generateCode(*root, code, options);
+    }
+    delete root;
+    return code.str();
+}
+
+static const char *PROGRAMS[] = {"arrays", "bubblesort", "calls", "inlining", "pressure", "structs"};
+
+/* one bit per pass turned off, or per non-default choice */
+enum BenchOption {
+    NoInlining = 1,
+    StackCalls = 2,
+    NoFolding = 4,
+    NoStrengthReduction = 8,
+    NoPeephole = 16,
+    AllOptions = 32
+};
+
+/* each bench program prints its .out, reading its .in if it has one, whatever the passes run */
+class BenchOutput : public ::testing::TestWithParam<std::tuple<const char *, int>> {
+};
+
+TEST_P(BenchOutput, MatchesExpected) {
+    std::string path = std::string(BENCH_DIR) + "/" + std::get<0>(GetParam());
+    int off = std::get<1>(GetParam());
+
+    CodegenOptions options;
+    if (off & NoInlining) options.inlineThreshold = 0;
+    if (off & StackCalls) options.callingConvention = CallingConvention::Stack;
+    if (off & NoFolding) options.foldConstants = false;
+    if (off & NoStrengthReduction) options.reduceStrength = false;
+    if (off & NoPeephole) options.peepholeWindow = 0;
+
+    std::string code = compile(readFile(path + ".src"), options);
+    ASSERT_FALSE(code.empty()) << path;
+
+    std::string expected = readFile(path + ".out");
+    ASSERT_FALSE(expected.empty()) << path;
+    MoonSimulator moon;
+    std::string output;
+    ASSERT_NO_THROW(output = moon.run({code, readFile(MOON_LIBRARY)}, readFile(path + ".in"))) << code;
+    EXPECT_EQ(output, expected) << code;
+}
+
+static std::string benchName(const ::testing::TestParamInfo<std::tuple<const char *, int>> &info) {
+    int off = std::get<1>(info.param);
+    std::string name = std::get<0>(info.param);
+    name += off & NoInlining ? "_noinline" : "";
+    name += off & StackCalls ? "_stack" : "";
+    name += off & NoFolding ? "_nofold" : "";
+    name += off & NoStrengthReduction ? "_nosr" : "";
+    name += off & NoPeephole ? "_nopeephole" : "";
+    return name;
+}
+
+INSTANTIATE_TEST_SUITE_P(Options, BenchOutput,
+                         ::testing::Combine(::testing::ValuesIn(PROGRAMS), ::testing::Range(0, (int)AllOptions)),
+                         benchName);
@@ -0,0 +1,491 @@
+#include<gtest/gtest.h>
+#include<constfold.hpp>
+#include<inliner.hpp>
+#include<strength.hpp>
+#include<sstream>
+#include<stdexcept>
+
+static IROperand v(int vreg) {
+    return IROperand::vreg(vreg);
+}
+
+static IROperand k(int value) {
+    return IROperand::imm(value);
+}
+
+static IRInstr instr(IROp op, int dst = -1, IROperand a = IROperand(), IROperand b = IROperand(), int imm = 0) {
+    IRInstr instr;
+    instr.op = op;
+    instr.dst = dst;
+    instr.a = a;
+    instr.b = b;
+    instr.imm = imm;
+    return instr;
+}
+
+static IRInstr jump(int target) {
+    IRInstr jump = instr(IROp::Jump);
+    jump.target = target;
+    return jump;
+}
+
+static IRInstr branch(IROperand condition, int target, int alt) {
+    IRInstr branch = instr(IROp::Branch, -1, condition);
+    branch.target = target;
+    branch.alt = alt;
+    return branch;
+}
+
+static IRInstr call(IRFunction &callee, int dst, std::vector<IROperand> args) {
+    IRInstr call = instr(IROp::Call, dst);
+    call.callee = &callee;
+    call.args = std::move(args);
+    return call;
+}
+
+/* a function of the program with vregs virtual registers and blocks empty blocks */
+static IRFunction &function(IRProgram &program, const std::string &name, int vregs, int blocks) {
+    std::unique_ptr<IRFunction> function(new IRFunction());
+    function->name = name;
+    function->label = name;
+    function->isMain = name == "main";
+    for (int i = 0; i < vregs; i++) function->newVReg(IRType::Int);
+    for (int i = 0; i < blocks; i++) function->newBlock();
+    program.functions.push_back(std::move(function));
+    return *program.functions.back();
+}
+
+static std::vector<const IRInstr*> find(const IRFunction &function, IROp op) {
+    std::vector<const IRInstr*> found;
+    for (const auto &block : function.blocks) {
+        for (const auto &instr : block.instrs) {
+            if (instr.op == op) found.push_back(&instr);
+        }
+    }
+    return found;
+}
+
+static std::string dump(const IRProgram &program) {
+    std::ostringstream out;
+    dumpIR(program, out);
+    return out.str();
+}
+
+/*
+ * Runs the IR of a program the way its moon code would, slots laid out one after the other in a flat memory of
+ * words, and collects what it writes. The passes must not change that.
+ * */
+class IRInterpreter {
+public:
+    std::vector<int> input;
+    std::vector<int> output;
+
+    std::vector<int> run(const IRProgram &program) {
+        output.clear();
+        for (const auto &function : program.functions) {
+            if (function->isMain) call(*function, {});
+        }
+        return output;
+    }
+
+private:
+    std::vector<int> memory = std::vector<int>(1024);
+    int top = 0;
+    size_t read = 0;
+    size_t steps = 0;
+
+    int &word(int address) {
+        if (address % 4 != 0 || address < 0 || address / 4 >= (int)memory.size()) {
+            throw std::runtime_error("bad address " + std::to_string(address));
+        }
+        return memory[address / 4];
+    }
+
+    int call(const IRFunction &function, const std::vector<int> &args) {
+        int frame = top;
+        std::vector<int> slots;
+        for (const auto &slot : function.slots) {
+            slots.push_back(top);
+            top += slot.size;
+        }
+        std::vector<int> regs(function.vregs.size());
+        auto value = [&](const IROperand &operand) {
+            return operand.isVReg() ? regs.at(operand.value) : operand.value;
+        };
+
+        int result = 0;
+        for (int b = 0; b >= 0;) {
+            int next = -1;
+            for (const auto &instr : function.blocks.at(b).instrs) {
+                if (++steps > 100000) throw std::runtime_error("too many steps");
+                int a = value(instr.a);
+                int c = value(instr.b);
+                int out = 0;
+                switch (instr.op) {
+                    case IROp::Copy: out = a; break;
+                    case IROp::Add: out = (int)((unsigned)a + (unsigned)c); break;
+                    case IROp::Sub: out = (int)((unsigned)a - (unsigned)c); break;
+                    case IROp::Mul: out = (int)((unsigned)a * (unsigned)c); break;
+                    case IROp::Div: out = a / c; break;
+                    case IROp::And: out = a & c; break;
+                    case IROp::Or: out = a | c; break;
+                    case IROp::Shl: out = (int)((unsigned)a << c); break;
+                    case IROp::Eq: out = a == c; break;
+                    case IROp::Ne: out = a != c; break;
+                    case IROp::Lt: out = a < c; break;
+                    case IROp::Le: out = a <= c; break;
+                    case IROp::Gt: out = a > c; break;
+                    case IROp::Ge: out = a >= c; break;
+                    case IROp::Not: out = a == 0; break;
+                    case IROp::Neg: out = (int)(0u - (unsigned)a); break;
+                    case IROp::Param: out = args.at(instr.imm); break;
+                    case IROp::FrameAddr: out = slots.at(instr.imm); break;
+                    case IROp::Load: out = word(a + instr.imm); break;
+                    case IROp::Store: word(a + instr.imm) = c; break;
+                    case IROp::Call: {
+                        std::vector<int> values;
+                        for (const auto &arg : instr.args) values.push_back(value(arg));
+                        out = call(*instr.callee, values);
+                        break;
+                    }
+                    case IROp::Write: output.push_back(a); break;
+                    case IROp::Read: out = input.at(read++); break;
+                    case IROp::Jump: next = instr.target; break;
+                    case IROp::Branch: next = a != 0 ? instr.target : instr.alt; break;
+                    case IROp::Return: result = a; break;
+                }
+                if (instr.dst >= 0) regs.at(instr.dst) = out;
+            }
+            b = next;
+        }
+        top = frame;
+        return result;
+    }
+};
+
+static std::vector<int> run(const IRProgram &program, std::vector<int> input = {}) {
+    IRInterpreter interpreter;
+    interpreter.input = std::move(input);
+    return interpreter.run(program);
+}
+
+TEST(FoldConstants, PropagatesThroughCopiesAndArithmetic) {
+    IRProgram program;
+    IRFunction &main = function(program, "main", 3, 1);
+    main.blocks[0].instrs = {
+            instr(IROp::Copy, 0, k(6)),
+            instr(IROp::Mul, 1, v(0), k(7)),
+            instr(IROp::Sub, 2, v(1), v(0)),
+            instr(IROp::Write, -1, v(2)),
+            instr(IROp::Return),
+    };
+    foldConstants(main);
+
+    ASSERT_EQ(main.blocks[0].instrs.size(), 2u) << dump(program);
+    const IRInstr &write = main.blocks[0].instrs[0];
+    EXPECT_EQ(write.op, IROp::Write);
+    EXPECT_TRUE(write.a.isImm());
+    EXPECT_EQ(write.a.value, 36);
+}
+
+TEST(FoldConstants, BranchOnConstantBecomesJump) {
+    IRProgram program;
+    IRFunction &main = function(program, "main", 2, 3);
+    main.blocks[0].instrs = {
+            instr(IROp::Copy, 0, k(3)),
+            instr(IROp::Gt, 1, v(0), k(2)),
+            branch(v(1), 1, 2),
+    };
+    main.blocks[1].instrs = {instr(IROp::Write, -1, k(1)), instr(IROp::Return)};
+    main.blocks[2].instrs = {instr(IROp::Write, -1, k(2)), instr(IROp::Return)};
+    foldConstants(main);
+
+    EXPECT_TRUE(find(main, IROp::Branch).empty()) << dump(program);
+    EXPECT_EQ(main.blocks.size(), 2u) << dump(program);
+    EXPECT_EQ(run(program), std::vector<int>({1}));
+}
+
+TEST(FoldConstants, ValueVariesWhereTwoPathsDisagree) {
+    IRProgram program;
+    IRFunction &main = function(program, "main", 3, 4);
+    main.blocks[0].instrs = {instr(IROp::Read, 0), branch(v(0), 1, 2)};
+    main.blocks[1].instrs = {instr(IROp::Copy, 1, k(1)), instr(IROp::Copy, 2, k(5)), jump(3)};
+    main.blocks[2].instrs = {instr(IROp::Copy, 1, k(2)), instr(IROp::Copy, 2, k(5)), jump(3)};
+    main.blocks[3].instrs = {instr(IROp::Write, -1, v(1)), instr(IROp::Write, -1, v(2)), instr(IROp::Return)};
+    foldConstants(main);
+
+    auto writes = find(main, IROp::Write);
+    ASSERT_EQ(writes.size(), 2u);
+    EXPECT_TRUE(writes[0]->a.isVReg()) << dump(program);
+    EXPECT_TRUE(writes[1]->a.isImm()) << dump(program);
+    EXPECT_EQ(run(program, {0}), std::vector<int>({2, 5}));
+    EXPECT_EQ(run(program, {1}), std::vector<int>({1, 5}));
+}
+
+TEST(FoldConstants, DivisionByZeroIsLeft) {
+    IRProgram program;
+    IRFunction &main = function(program, "main", 3, 1);
+    main.blocks[0].instrs = {
+            instr(IROp::Copy, 0, k(1)),
+            instr(IROp::Copy, 1, k(0)),
+            instr(IROp::Div, 2, v(0), v(1)),
+            instr(IROp::Write, -1, v(2)),
+            instr(IROp::Return),
+    };
+    foldConstants(main);
+
+    EXPECT_EQ(find(main, IROp::Div).size(), 1u) << dump(program);
+}
+
+TEST(FoldConstants, ConstantsAddedInARowAddUp) {
+    IRProgram program;
+    IRFunction &main = function(program, "main", 3, 1);
+    main.blocks[0].instrs = {
+            instr(IROp::Read, 0),
+            instr(IROp::Sub, 1, k(10), v(0)),
+            instr(IROp::Sub, 2, v(1), k(1)),
+            instr(IROp::Write, -1, v(2)),
+            instr(IROp::Return),
+    };
+    foldConstants(main);
+
+    auto subs = find(main, IROp::Sub);
+    ASSERT_EQ(subs.size(), 1u) << dump(program);
+    EXPECT_TRUE(subs[0]->a.isImm());
+    EXPECT_EQ(subs[0]->a.value, 9);
+    EXPECT_EQ(run(program, {4}), std::vector<int>({5}));
+}
+
+TEST(FoldConstants, ConstantOffsetMovesIntoLoadsAndStores) {
+    IRProgram program;
+    IRFunction &main = function(program, "main", 4, 1);
+    main.vregs[0] = main.vregs[1] = IRType::Addr;
+    main.newSlot("a", 16);
+    main.blocks[0].instrs = {
+            instr(IROp::FrameAddr, 0, IROperand(), IROperand(), 0),
+            instr(IROp::Add, 1, v(0), k(8)),
+            instr(IROp::Read, 2),
+            instr(IROp::Store, -1, v(1), v(2), 4),
+            instr(IROp::Load, 3, v(1), IROperand(), 4),
+            instr(IROp::Write, -1, v(3)),
+            instr(IROp::Return),
+    };
+    foldConstants(main);
+
+    EXPECT_TRUE(find(main, IROp::Add).empty()) << dump(program);
+    auto stores = find(main, IROp::Store);
+    auto loads = find(main, IROp::Load);
+    ASSERT_EQ(stores.size(), 1u);
+    ASSERT_EQ(loads.size(), 1u);
+    EXPECT_EQ(stores[0]->a.value, 0);
+    EXPECT_EQ(stores[0]->imm, 12);
+    EXPECT_EQ(loads[0]->a.value, 0);
+    EXPECT_EQ(loads[0]->imm, 12);
+    EXPECT_EQ(run(program, {7}), std::vector<int>({7}));
+}
+
+TEST(ReduceStrength, MultiplicationByPowerOfTwoBecomesShift) {
+    IRProgram program;
+    IRFunction &main = function(program, "main", 4, 1);
+    main.blocks[0].instrs = {
+            instr(IROp::Read, 0),
+            instr(IROp::Mul, 1, v(0), k(8)),
+            instr(IROp::Mul, 2, k(4), v(0)),
+            instr(IROp::Mul, 3, v(0), k(6)),
+            instr(IROp::Write, -1, v(1)),
+            instr(IROp::Write, -1, v(2)),
+            instr(IROp::Write, -1, v(3)),
+            instr(IROp::Return),
+    };
+    reduceStrength(main);
+
+    auto shifts = find(main, IROp::Shl);
+    ASSERT_EQ(shifts.size(), 2u) << dump(program);
+    EXPECT_EQ(shifts[0]->b.value, 3);
+    EXPECT_TRUE(shifts[1]->a.isVReg());
+    EXPECT_EQ(shifts[1]->b.value, 2);
+    EXPECT_EQ(find(main, IROp::Mul).size(), 1u);
+    EXPECT_EQ(run(program, {3}), std::vector<int>({24, 12, 18}));
+}
+
+// i = 0 ; while (i < 8) { a[i] = i ; i = i + 1 ; } ; write(a[5])
+TEST(ReduceStrength, ArrayIndexedByInductionVariableIsReadOffAPointer) {
+    IRProgram program;
+    IRFunction &main = function(program, "main", 7, 4);
+    main.vregs[1] = main.vregs[3] = main.vregs[4] = IRType::Addr;
+    main.newSlot("a", 32);
+    main.blocks[0].instrs = {
+            instr(IROp::Copy, 0, k(0)),
+            instr(IROp::FrameAddr, 1, IROperand(), IROperand(), 0),
+            jump(1),
+    };
+    main.blocks[1].instrs = {instr(IROp::Lt, 2, v(0), k(8)), branch(v(2), 2, 3)};
+    main.blocks[2].instrs = {
+            instr(IROp::Mul, 5, v(0), k(4)),
+            instr(IROp::Add, 3, v(1), v(5)),
+            instr(IROp::Store, -1, v(3), v(0)),
+            instr(IROp::Add, 0, v(0), k(1)),
+            jump(1),
+    };
+    main.blocks[3].instrs = {
+            instr(IROp::Load, 6, v(1), IROperand(), 20),
+            instr(IROp::Write, -1, v(6)),
+            instr(IROp::Return),
+    };
+    reduceStrength(main);
+
+    const auto &body = main.blocks[2].instrs;
+    ASSERT_EQ(body.size(), 4u) << dump(program);
+    int pointer = body[0].a.value;
+    EXPECT_EQ(body[0].op, IROp::Store);
+    EXPECT_GE(pointer, 7);
+    EXPECT_EQ(main.vregs[pointer], IRType::Addr);
+    EXPECT_EQ(body[1].op, IROp::Add);
+    EXPECT_EQ(body[1].dst, 0);
+    // the pointer moves right after the induction variable, by its step times the scale
+    EXPECT_EQ(body[2].op, IROp::Add);
+    EXPECT_EQ(body[2].dst, pointer);
+    EXPECT_EQ(body[2].a.value, pointer);
+    EXPECT_EQ(body[2].b.value, 4);
+    EXPECT_TRUE(find(main, IROp::Mul).empty()) << dump(program);
+    EXPECT_EQ(run(program), std::vector<int>({5}));
+}
+
+// f(n) = n < 1 ? 0 : f(n - 1)
+TEST(InlineCalls, RecursiveFunctionIsKept) {
+    IRProgram program;
+    IRFunction &f = function(program, "f", 4, 3);
+    f.paramCount = 1;
+    f.returnsValue = true;
+    f.blocks[0].instrs = {instr(IROp::Param, 0), instr(IROp::Lt, 1, v(0), k(1)), branch(v(1), 1, 2)};
+    f.blocks[1].instrs = {instr(IROp::Return, -1, k(0))};
+    f.blocks[2].instrs = {instr(IROp::Sub, 2, v(0), k(1)), call(f, 3, {v(2)}), instr(IROp::Return, -1, v(3))};
+    IRFunction &main = function(program, "main", 1, 1);
+    main.blocks[0].instrs = {call(f, 0, {k(5)}), instr(IROp::Write, -1, v(0)), instr(IROp::Return)};
+
+    std::ostringstream report;
+    inlineCalls(program, 100, &report);
+
+    ASSERT_EQ(program.functions.size(), 2u);
+    auto calls = find(main, IROp::Call);
+    ASSERT_EQ(calls.size(), 1u) << dump(program);
+    EXPECT_EQ(calls[0]->callee, &f);
+    EXPECT_NE(report.str().find("kept call to f in main, it makes calls"), std::string::npos) << report.str();
+    EXPECT_EQ(run(program), std::vector<int>({0}));
+}
+
+// sq(n) = n * n, called twice
+TEST(InlineCalls, SmallLeafIsInlinedAtEveryCallAndDropped) {
+    IRProgram program;
+    IRFunction &sq = function(program, "sq", 2, 1);
+    sq.paramCount = 1;
+    sq.returnsValue = true;
+    sq.blocks[0].instrs = {instr(IROp::Param, 0), instr(IROp::Mul, 1, v(0), v(0)), instr(IROp::Return, -1, v(1))};
+    IRFunction &main = function(program, "main", 3, 1);
+    main.blocks[0].instrs = {
+            instr(IROp::Read, 0),
+            call(sq, 1, {v(0)}),
+            call(sq, 2, {v(1)}),
+            instr(IROp::Write, -1, v(2)),
+            instr(IROp::Return),
+    };
+    std::vector<int> before = run(program, {3});
+
+    std::ostringstream report;
+    inlineCalls(program, 12, &report);
+
+    ASSERT_EQ(program.functions.size(), 1u) << dump(program);
+    EXPECT_TRUE(find(main, IROp::Call).empty()) << dump(program);
+    EXPECT_EQ(find(main, IROp::Mul).size(), 2u);
+    EXPECT_EQ(report.str(), "inlined sq into main, 1 instructions\ninlined sq into main, 1 instructions\n");
+    EXPECT_EQ(run(program, {3}), before);
+}
+
+/* a leaf of five instructions: ((n * 3 + 1) * 3 + 1) - n */
+static IRFunction &bigLeaf(IRProgram &program, const std::string &name) {
+    IRFunction &leaf = function(program, name, 6, 1);
+    leaf.paramCount = 1;
+    leaf.returnsValue = true;
+    leaf.blocks[0].instrs = {
+            instr(IROp::Param, 0),
+            instr(IROp::Mul, 1, v(0), k(3)),
+            instr(IROp::Add, 2, v(1), k(1)),
+            instr(IROp::Mul, 3, v(2), k(3)),
+            instr(IROp::Add, 4, v(3), k(1)),
+            instr(IROp::Sub, 5, v(4), v(0)),
+            instr(IROp::Return, -1, v(5)),
+    };
+    return leaf;
+}
+
+TEST(InlineCalls, LargeLeafCalledOnceMovesIntoItsCaller) {
+    IRProgram program;
+    IRFunction &once = bigLeaf(program, "once");
+    IRFunction &twice = bigLeaf(program, "twice");
+    IRFunction &main = function(program, "main", 3, 1);
+    main.blocks[0].instrs = {
+            call(once, 0, {k(2)}),
+            call(twice, 1, {v(0)}),
+            call(twice, 2, {v(1)}),
+            instr(IROp::Write, -1, v(2)),
+            instr(IROp::Return),
+    };
+    std::vector<int> before = run(program);
+
+    std::ostringstream report;
+    inlineCalls(program, 2, &report);
+
+    ASSERT_EQ(program.functions.size(), 2u) << dump(program);
+    EXPECT_EQ(program.functions[0].get(), &twice);
+    auto calls = find(main, IROp::Call);
+    ASSERT_EQ(calls.size(), 2u) << dump(program);
+    EXPECT_EQ(calls[0]->callee, &twice);
+    EXPECT_EQ(report.str(), "inlined once into main, 5 instructions, its only call\n"
+                            "kept call to twice in main, 5 instructions\n"
+                            "kept call to twice in main, 5 instructions\n");
+    EXPECT_EQ(run(program), before);
+}
+
+// g(n) stores n in the second word of its second slot and loads it back, main keeps 7 in the same place of its own
+TEST(InlineCalls, CalleeSlotsAreAddedAfterTheCallers) {
+    IRProgram program;
+    IRFunction &g = function(program, "g", 3, 1);
+    g.paramCount = 1;
+    g.returnsValue = true;
+    g.vregs[0] = IRType::Addr;
+    g.newSlot("x", 4);
+    g.newSlot("y", 8);
+    g.blocks[0].instrs = {
+            instr(IROp::FrameAddr, 0, IROperand(), IROperand(), 1),
+            instr(IROp::Param, 1),
+            instr(IROp::Store, -1, v(0), v(1), 4),
+            instr(IROp::Load, 2, v(0), IROperand(), 4),
+            instr(IROp::Return, -1, v(2)),
+    };
+    IRFunction &main = function(program, "main", 3, 1);
+    main.vregs[0] = IRType::Addr;
+    main.newSlot("a", 4);
+    main.newSlot("b", 8);
+    main.blocks[0].instrs = {
+            instr(IROp::FrameAddr, 0, IROperand(), IROperand(), 1),
+            instr(IROp::Store, -1, v(0), k(7), 4),
+            call(g, 1, {k(3)}),
+            instr(IROp::Load, 2, v(0), IROperand(), 4),
+            instr(IROp::Write, -1, v(1)),
+            instr(IROp::Write, -1, v(2)),
+            instr(IROp::Return),
+    };
+
+    inlineCalls(program, 12, nullptr);
+
+    ASSERT_EQ(program.functions.size(), 1u) << dump(program);
+    ASSERT_EQ(main.slots.size(), 4u);
+    EXPECT_EQ(main.slots[2].name, "g.x");
+    EXPECT_EQ(main.slots[3].name, "g.y");
+    EXPECT_EQ(main.slots[3].size, 8);
+    auto addresses = find(main, IROp::FrameAddr);
+    ASSERT_EQ(addresses.size(), 2u) << dump(program);
+    EXPECT_EQ(addresses[0]->imm, 1);
+    EXPECT_EQ(addresses[1]->imm, 3);
+    EXPECT_EQ(run(program), std::vector<int>({3, 7}));
+}
@@ -0,0 +1,318 @@
+#ifndef COMPILER_MOONSIM_HPP
+#define COMPILER_MOONSIM_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+ * A moon machine for the tests: assembles the sources one after the other, as moon does with several files, and runs
+ * them from the entry. Memory is MEMORY_SIZE bytes and topaddr stands for its end. getc reads the input, then line
+ * feeds, and putc appends to the output. Throws on a bad line, a misaligned or out of range word and when the
+ * program runs more than stepLimit instructions.
+ * */
+class MoonSimulator {
+public:
+    static const int MEMORY_SIZE = 64000;
+
+    size_t steps = 0;
+    size_t loads = 0;
+    size_t stores = 0;
+
+    std::string run(const std::vector<std::string> &sources, const std::string &input, size_t stepLimit = 50000000) {
+        assemble(sources);
+        return execute(input, stepLimit);
+    }
+
+private:
+    struct Line {
+        std::string label;
+        std::string op;
+        std::vector<std::string> args;
+    };
+
+    struct Instr {
+        std::string op;
+        int i = 0;
+        int j = 0;
+        int k = 0;
+    };
+
+    std::vector<unsigned char> memory;
+    std::map<std::string, int> symbols;
+    std::map<int, Instr> code;
+    int entry = 0;
+
+    static const std::set<std::string> &operations() {
+        static const std::set<std::string> ops = {
+                "add", "sub", "mul", "div", "mod", "and", "or", "ceq", "cne", "clt", "cle", "cgt", "cge",
+                "addi", "subi", "muli", "divi", "modi", "andi", "ori", "ceqi", "cnei", "clti", "clei", "cgti", "cgei",
+                "lw", "lb", "sw", "sb", "not", "sl", "sr", "getc", "putc", "bz", "bnz", "j", "jr", "jl", "jlr",
+                "nop", "hlt", "entry", "align", "org", "dw", "db", "res"};
+        return ops;
+    }
+
+    static std::string trim(const std::string &text) {
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos) return "";
+        size_t last = text.find_last_not_of(" \t\r");
+        return text.substr(first, last - first + 1);
+    }
+
+    /* a line without its comment, false if nothing is left */
+    static bool tokenize(const std::string &text, Line &line) {
+        std::istringstream words(text.substr(0, text.find('%')));
+        std::string word;
+        if (!(words >> word)) return false;
+        if (operations().count(word) == 0) {
+            line.label = word;
+            if (!(words >> word)) return true;
+        }
+        line.op = word;
+
+        std::string rest;
+        std::getline(words, rest);
+        // strings of db keep their commas
+        for (size_t at = 0; at < rest.size();) {
+            size_t start = rest.find_first_not_of(" \t", at);
+            if (start == std::string::npos) break;
+            size_t end = rest[start] == '"' ? rest.find('"', start + 1) : rest.find(',', start);
+            if (end != std::string::npos && rest[start] == '"') end++;
+            if (end == std::string::npos) end = rest.size();
+            std::string arg = trim(rest.substr(start, end - start));
+            if (!arg.empty()) line.args.push_back(arg);
+            at = rest.find(',', end);
+            if (at == std::string::npos) break;
+            at++;
+        }
+        return true;
+    }
+
+    int evaluate(const std::string &text) const {
+        std::string expr = trim(text);
+        char *end = nullptr;
+        long value = std::strtol(expr.c_str(), &end, 10);
+        if (!expr.empty() && *end == '\0') return (int)value;
+
+        size_t sign = expr.find_first_of("+-");
+        std::string name = trim(expr.substr(0, sign));
+        auto symbol = symbols.find(name);
+        if (symbol == symbols.end()) throw std::runtime_error("unknown symbol " + name);
+        if (sign == std::string::npos) return symbol->second;
+        int offset = evaluate(expr.substr(sign + 1));
+        return expr[sign] == '+' ? symbol->second + offset : symbol->second - offset;
+    }
+
+    static int reg(const std::string &text) {
+        std::string name = trim(text);
+        if (name.size() < 2 || name[0] != 'r') throw std::runtime_error("bad register " + name);
+        return std::atoi(name.c_str() + 1);
+    }
+
+    /* k(rj) */
+    void address(const std::string &text, Instr &instr) const {
+        size_t open = text.find('(');
+        if (open == std::string::npos) throw std::runtime_error("bad address " + text);
+        instr.k = evaluate(text.substr(0, open));
+        instr.j = reg(text.substr(open + 1, text.find(')') - open - 1));
+    }
+
+    void assemble(const std::vector<std::string> &sources) {
+        std::vector<Line> lines;
+        for (const auto &source : sources) {
+            std::istringstream in(source);
+            std::string text;
+            while (std::getline(in, text)) {
+                Line line;
+                if (tokenize(text, line)) lines.push_back(line);
+            }
+        }
+
+        // where everything goes, then what it holds once every symbol is known
+        memory.assign(MEMORY_SIZE, 0);
+        symbols.clear();
+        symbols["topaddr"] = MEMORY_SIZE;
+        code.clear();
+        entry = 0;
+        std::vector<std::pair<int, const Line *>> placed;
+        int at = 0;
+        for (const auto &line : lines) {
+            if (line.op == "align") at = (at + 3) & ~3;
+            if (line.op == "org") at = evaluate(line.args.at(0));
+            if (!line.label.empty()) symbols[line.label] = at;
+            if (line.op.empty() || line.op == "align" || line.op == "org") continue;
+
+            if (line.op == "entry") {
+                entry = at;
+            } else if (line.op == "dw") {
+                placed.emplace_back(at, &line);
+                at += 4 * (int)line.args.size();
+            } else if (line.op == "db") {
+                placed.emplace_back(at, &line);
+                for (const auto &arg : line.args) {
+                    at += arg[0] == '"' ? (int)arg.size() - 2 : 1;
+                }
+            } else if (line.op == "res") {
+                at += evaluate(line.args.at(0));
+            } else {
+                at = (at + 3) & ~3;
+                if (!line.label.empty()) symbols[line.label] = at;
+                placed.emplace_back(at, &line);
+                at += 4;
+            }
+        }
+
+        for (const auto &item : placed) {
+            const Line &line = *item.second;
+            int address = item.first;
+            if (line.op == "dw") {
+                for (const auto &arg : line.args) {
+                    store(address, evaluate(arg));
+                    address += 4;
+                }
+            } else if (line.op == "db") {
+                for (const auto &arg : line.args) {
+                    if (arg[0] == '"') {
+                        for (size_t c = 1; c + 1 < arg.size(); c++) memory.at(address++) = (unsigned char)arg[c];
+                    } else {
+                        memory.at(address++) = (unsigned char)evaluate(arg);
+                    }
+                }
+            } else {
+                code[address] = decode(line);
+            }
+        }
+    }
+
+    Instr decode(const Line &line) const {
+        Instr instr;
+        instr.op = line.op;
+        const std::string &op = line.op;
+        const std::vector<std::string> &args = line.args;
+        bool immediate = op.size() > 1 && op.back() == 'i';
+
+        if (op == "lw" || op == "lb") {
+            instr.i = reg(args.at(0));
+            address(args.at(1), instr);
+        } else if (op == "sw" || op == "sb") {
+            address(args.at(0), instr);
+            instr.i = reg(args.at(1));
+        } else if (op == "not" || op == "jlr") {
+            instr.i = reg(args.at(0));
+            instr.j = reg(args.at(1));
+        } else if (op == "sl" || op == "sr" || op == "bz" || op == "bnz" || op == "jl") {
+            instr.i = reg(args.at(0));
+            instr.k = evaluate(args.at(1));
+        } else if (op == "getc" || op == "putc" || op == "jr") {
+            instr.i = reg(args.at(0));
+        } else if (op == "j") {
+            instr.k = evaluate(args.at(0));
+        } else if (op == "nop" || op == "hlt") {
+        } else if (args.size() == 3) {
+            instr.i = reg(args[0]);
+            instr.j = reg(args[1]);
+            instr.k = immediate ? evaluate(args[2]) : reg(args[2]);
+        } else {
+            throw std::runtime_error("bad instruction " + op);
+        }
+        return instr;
+    }
+
+    int load(int address) const {
+        if (address % 4 != 0 || address < 0 || address + 4 > MEMORY_SIZE) {
+            throw std::runtime_error("bad lw address " + std::to_string(address));
+        }
+        uint32_t word = 0;
+        for (int b = 3; b >= 0; b--) word = word << 8 | memory[address + b];
+        return (int32_t)word;
+    }
+
+    void store(int address, int value) {
+        if (address % 4 != 0 || address < 0 || address + 4 > MEMORY_SIZE) {
+            throw std::runtime_error("bad sw address " + std::to_string(address));
+        }
+        for (int b = 0; b < 4; b++) memory[address + b] = (unsigned char)((uint32_t)value >> (8 * b));
+    }
+
+    static int wrap(int64_t value) {
+        return (int32_t)(uint32_t)value;
+    }
+
+    /* rounds toward zero, as moon does */
+    static int divide(int a, int b) {
+        if (b == 0) throw std::runtime_error("division by zero");
+        return wrap((int64_t)a / b);
+    }
+
+    std::string execute(const std::string &input, size_t stepLimit) {
+        int r[16] = {0};
+        std::string output;
+        size_t read = 0;
+        steps = loads = stores = 0;
+
+        int pc = entry;
+        while (true) {
+            if (++steps > stepLimit) throw std::runtime_error("too many steps");
+            auto found = code.find(pc);
+            if (found == code.end()) throw std::runtime_error("no instruction at " + std::to_string(pc));
+            const Instr &instr = found->second;
+            const std::string &op = instr.op;
+            int i = instr.i, j = instr.j, k = instr.k;
+            bool immediate = op.size() > 1 && op.back() == 'i';
+            int64_t a = r[j];
+            int64_t b = immediate ? k : r[k & 15];
+            std::string base = immediate ? op.substr(0, op.size() - 1) : op;
+            int next = pc + 4;
+
+            if (base == "add") r[i] = wrap(a + b);
+            else if (base == "sub") r[i] = wrap(a - b);
+            else if (base == "mul") r[i] = wrap(a * b);
+            else if (base == "div") r[i] = divide((int)a, (int)b);
+            else if (base == "mod") r[i] = wrap(a - (int64_t)divide((int)a, (int)b) * b);
+            else if (base == "and") r[i] = wrap(a & b);
+            else if (base == "or") r[i] = wrap(a | b);
+            else if (base == "ceq") r[i] = a == b;
+            else if (base == "cne") r[i] = a != b;
+            else if (base == "clt") r[i] = a < b;
+            else if (base == "cle") r[i] = a <= b;
+            else if (base == "cgt") r[i] = a > b;
+            else if (base == "cge") r[i] = a >= b;
+            else if (op == "not") r[i] = ~r[j];
+            else if (op == "sl") r[i] = wrap((int64_t)((uint32_t)r[i] << k));
+            else if (op == "sr") r[i] = wrap((uint32_t)r[i] >> k);
+            else if (op == "lw") {
+                r[i] = load(r[j] + k);
+                loads++;
+            } else if (op == "lb") r[i] = memory.at(r[j] + k);
+            else if (op == "sw") {
+                store(r[j] + k, r[i]);
+                stores++;
+            } else if (op == "sb") memory.at(r[j] + k) = (unsigned char)r[i];
+            else if (op == "putc") output.push_back((char)(r[i] & 0xFF));
+            else if (op == "getc") r[i] = read < input.size() ? (unsigned char)input[read++] : 10;
+            else if (op == "bz") next = r[i] == 0 ? k : next;
+            else if (op == "bnz") next = r[i] != 0 ? k : next;
+            else if (op == "j") next = k;
+            else if (op == "jr") next = r[i];
+            else if (op == "jl") {
+                r[i] = next;
+                next = k;
+            } else if (op == "jlr") {
+                r[i] = next;
+                next = r[j];
+            } else if (op == "hlt") break;
+            else if (op != "nop") throw std::runtime_error("bad instruction " + op);
+
+            r[0] = 0;
+            pc = next;
+        }
+        return output;
+    }
+};
+
+#endif //COMPILER_MOONSIM_HPP
@@ -0,0 +1,187 @@
+#include<gtest/gtest.h>
+#include<peephole.hpp>
+#include<sstream>
+
+/* scratch registers as the emitter uses them */
+static const PeepholeContext CONTEXT{4, 1u << 10 | 1u << 11};
+
+/* builds moon code one instruction at a time, labels and branches by name */
+class Code {
+public:
+    MoonCode code;
+
+    Code &add(MoonOp op, int ri = 0, int rj = 0, int rk = 0, int k = 0) {
+        code.instrs.emplace_back(op, ri, rj, rk, k);
+        return *this;
+    }
+
+    Code &to(MoonOp op, const std::string &label, int ri = 0) {
+        code.instrs.emplace_back(op, ri);
+        code.instrs.back().symbol = code.symbol(label);
+        return *this;
+    }
+
+    Code &label(const std::string &name) {
+        return to(MoonOp::Label, name);
+    }
+
+    /* the listing after the peephole pass, and the hits of the rule named */
+    std::string optimized(const std::string &rule, size_t &ruleHits, const PeepholeContext &context = CONTEXT) {
+        std::vector<size_t> hits;
+        peephole(code.instrs, context, hits);
+        ruleHits = 0;
+        for (size_t r = 0; r < peepholeRules.size(); r++) {
+            if (rule == peepholeRules[r].name) ruleHits = hits[r];
+        }
+        return listing();
+    }
+
+    std::string listing() const {
+        std::ostringstream out;
+        printMoon(code, out);
+        return out.str();
+    }
+};
+
+/* the listing of moon lines given without their indent */
+static std::string lines(std::initializer_list<const char *> text) {
+    std::string listing;
+    for (const char *line : text) {
+        listing += std::string("          ") + line + "\n";
+    }
+    return listing;
+}
+
+TEST(Peephole, StoreThenLoadOfTheSameWordKeepsTheRegister) {
+    size_t hits;
+    Code code;
+    code.add(MoonOp::Sw, 1, 14, 0, -8).add(MoonOp::Lw, 2, 14, 0, -8).add(MoonOp::Putc, 2);
+    EXPECT_EQ(code.optimized("store-load", hits), lines({"sw -8(r14),r1", "addi r2,r1,0", "putc r2"}));
+    EXPECT_EQ(hits, 1u);
+
+    // a call in between may change the word
+    Code call;
+    call.add(MoonOp::Sw, 1, 14, 0, -8).to(MoonOp::Jl, "f", 15).add(MoonOp::Lw, 2, 14, 0, -8);
+    std::string before = call.listing();
+    EXPECT_EQ(call.optimized("store-load", hits), before);
+    EXPECT_EQ(hits, 0u);
+}
+
+TEST(Peephole, StoreLoadLooksNoFurtherThanTheWindow) {
+    size_t hits;
+    Code code;
+    code.add(MoonOp::Sw, 1, 14, 0, -8).add(MoonOp::Putc, 3).add(MoonOp::Putc, 4).add(MoonOp::Lw, 2, 14, 0, -8);
+    std::string before = code.listing();
+    EXPECT_EQ(code.optimized("store-load", hits, PeepholeContext{2, 0}), before);
+    EXPECT_EQ(hits, 0u);
+    EXPECT_EQ(code.optimized("store-load", hits, PeepholeContext{3, 0}),
+              lines({"sw -8(r14),r1", "putc r3", "putc r4", "addi r2,r1,0"}));
+    EXPECT_EQ(hits, 1u);
+}
+
+TEST(Peephole, StoreOverwrittenBeforeAnyLoadIsDropped) {
+    size_t hits;
+    Code code;
+    code.add(MoonOp::Sw, 1, 14, 0, -8).add(MoonOp::Addi, 3, 0, 0, 1).add(MoonOp::Sw, 3, 14, 0, -8);
+    EXPECT_EQ(code.optimized("dead-store", hits), lines({"addi r3,r0,1", "sw -8(r14),r3"}));
+    EXPECT_EQ(hits, 1u);
+
+    Code load;
+    load.add(MoonOp::Sw, 1, 14, 0, -8).add(MoonOp::Lw, 3, 14, 0, -12).add(MoonOp::Sw, 3, 14, 0, -8);
+    std::string before = load.listing();
+    EXPECT_EQ(load.optimized("dead-store", hits), before);
+    EXPECT_EQ(hits, 0u);
+}
+
+TEST(Peephole, SecondLoadOfTheSameWordKeepsTheRegister) {
+    size_t hits;
+    Code code;
+    code.add(MoonOp::Lw, 1, 14, 0, -8).add(MoonOp::Lw, 2, 14, 0, -8).add(MoonOp::Add, 3, 1, 2);
+    EXPECT_EQ(code.optimized("redundant-load", hits), lines({"lw r1,-8(r14)", "addi r2,r1,0", "add r3,r1,r2"}));
+    EXPECT_EQ(hits, 1u);
+
+    Code store;
+    store.add(MoonOp::Lw, 1, 14, 0, -8).add(MoonOp::Sw, 3, 14, 0, -12).add(MoonOp::Lw, 2, 14, 0, -8);
+    std::string before = store.listing();
+    EXPECT_EQ(store.optimized("redundant-load", hits), before);
+    EXPECT_EQ(hits, 0u);
+}
+
+TEST(Peephole, ConstantInAScratchRegisterBecomesAnImmediate) {
+    size_t hits;
+    Code code;
+    code.add(MoonOp::Addi, 10, 0, 0, 5).add(MoonOp::Add, 1, 2, 10);
+    EXPECT_EQ(code.optimized("immediate-operand", hits), lines({"addi r1,r2,5"}));
+    EXPECT_EQ(hits, 1u);
+
+    // 5 < r2 is r2 > 5
+    Code swapped;
+    swapped.add(MoonOp::Addi, 10, 0, 0, 5).add(MoonOp::Clt, 1, 10, 2);
+    EXPECT_EQ(swapped.optimized("immediate-operand", hits), lines({"cgti r1,r2,5"}));
+    EXPECT_EQ(hits, 1u);
+
+    // r3 may be read again later
+    Code live;
+    live.add(MoonOp::Addi, 3, 0, 0, 5).add(MoonOp::Add, 1, 2, 3);
+    std::string before = live.listing();
+    EXPECT_EQ(live.optimized("immediate-operand", hits), before);
+    EXPECT_EQ(hits, 0u);
+
+    // 5 - r2 has no immediate form
+    Code sub;
+    sub.add(MoonOp::Addi, 10, 0, 0, 5).add(MoonOp::Sub, 1, 10, 2);
+    before = sub.listing();
+    EXPECT_EQ(sub.optimized("immediate-operand", hits), before);
+    EXPECT_EQ(hits, 0u);
+}
+
+TEST(Peephole, AddressOffsetMovesIntoTheLoad) {
+    size_t hits;
+    Code code;
+    code.add(MoonOp::Addi, 10, 14, 0, -8).add(MoonOp::Lw, 1, 10, 0, 4);
+    EXPECT_EQ(code.optimized("address-offset", hits), lines({"lw r1,-4(r14)"}));
+    EXPECT_EQ(hits, 1u);
+
+    // r10 is stored itself
+    Code stored;
+    stored.add(MoonOp::Addi, 10, 14, 0, -8).add(MoonOp::Sw, 10, 10, 0, 4);
+    std::string before = stored.listing();
+    EXPECT_EQ(stored.optimized("address-offset", hits), before);
+    EXPECT_EQ(hits, 0u);
+}
+
+TEST(Peephole, AdjustmentsOfOneRegisterMerge) {
+    size_t hits;
+    Code code;
+    code.add(MoonOp::Addi, 14, 14, 0, 8).add(MoonOp::Subi, 14, 14, 0, 12);
+    EXPECT_EQ(code.optimized("merge-adjust", hits), lines({"subi r14,r14,4"}));
+    EXPECT_EQ(hits, 1u);
+
+    // adjustments cancelling out leave nothing
+    Code cancel;
+    cancel.add(MoonOp::Subi, 14, 14, 0, 8).add(MoonOp::Addi, 14, 14, 0, 8);
+    EXPECT_EQ(cancel.optimized("self-move", hits), "");
+    EXPECT_EQ(hits, 1u);
+}
+
+TEST(Peephole, MoveToItselfIsDropped) {
+    size_t hits;
+    Code code;
+    code.add(MoonOp::Addi, 1, 1, 0, 0).add(MoonOp::Addi, 2, 1, 0, 0);
+    EXPECT_EQ(code.optimized("self-move", hits), lines({"addi r2,r1,0"}));
+    EXPECT_EQ(hits, 1u);
+}
+
+TEST(Peephole, JumpToTheNextLineIsDropped) {
+    size_t hits;
+    Code code;
+    code.to(MoonOp::J, "next").label("other").label("next").add(MoonOp::Hlt);
+    EXPECT_EQ(code.optimized("jump-to-next", hits), " other    nop\n next     hlt\n");
+    EXPECT_EQ(hits, 1u);
+
+    Code over;
+    over.to(MoonOp::J, "next").add(MoonOp::Nop).label("next").add(MoonOp::Hlt);
+    std::string before = over.listing();
+    EXPECT_EQ(over.optimized("jump-to-next", hits), before);
+    EXPECT_EQ(hits, 0u);
+}
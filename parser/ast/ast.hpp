@@ -5,11 +5,18 @@
 #include <vector>
 #include <algorithm>
 #include <cctype>
+#include <cstdlib>
 #include <iostream>
+#include <iterator>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 
 class ASTNodeVisitor;
 class SymbolTable;
 class SymbolTableEntry;
+struct MemberSlot;
 class SymbolTableCreationVisitor;
 
 class StructEntry;
@@ -56,6 +63,143 @@ class VisibilityNode;
 class VarDeclNode;
 class EpsilonNode;
 
+/* $begin Types */
+
+const int INT_SIZE = 4;
+const int FLOAT_SIZE = 8;
+
+/*
+ * Structure of an interned type such as "integer[3][4]": its element type "integer", its dimensions {3, 4} (an
+ * unsized dimension "[]" is 0) and the number of elements it holds. Primitive element types also know their byte
+ * size ; a struct's size is only known once its table is sized, so it stays 0 here.
+ * */
+struct TypeInfo {
+    std::string name;
+    unsigned base;
+    std::vector<int> dims;
+    int elementCount;
+    int baseSize;
+};
+
+/*
+ * Every type spelling seen by the compiler is parsed once and given a small id. Ids are never reused, so two types
+ * are equal iff their ids are. Interning may happen from several checking threads at once.
+ * */
+class TypeTable {
+public:
+    static TypeTable &instance() {
+        static TypeTable table;
+        return table;
+    }
+
+    unsigned intern(const std::string &name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return internLocked(name);
+    }
+
+    /* lock-free: entries never move once interned, and an id is only known after its entry is published */
+    const TypeInfo &info(unsigned id) const {
+        return chunks[id / CHUNK_SIZE][id % CHUNK_SIZE];
+    }
+
+private:
+    static const unsigned CHUNK_SIZE = 1024;
+    static const unsigned MAX_CHUNKS = 4096;
+
+    std::unique_ptr<TypeInfo[]> chunks[MAX_CHUNKS];
+    unsigned count = 0;
+    std::unordered_map<std::string, unsigned> ids;
+    std::mutex mutex;
+
+    TypeTable() {
+        // well-known types get fixed ids, see TypeId
+        intern("");
+        intern("errortype");
+        intern("integer");
+        intern("float");
+        intern("void");
+    }
+
+    unsigned internLocked(const std::string &name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) {
+            return it->second;
+        }
+
+        size_t bracket = name.find('[');
+        unsigned base = bracket == std::string::npos ? count : internLocked(name.substr(0, bracket));
+        if (count == CHUNK_SIZE * MAX_CHUNKS) {
+            throw std::length_error("too many distinct types");
+        }
+        if (count % CHUNK_SIZE == 0) {
+            chunks[count / CHUNK_SIZE].reset(new TypeInfo[CHUNK_SIZE]);
+        }
+
+        unsigned id = count;
+        auto &info = chunks[id / CHUNK_SIZE][id % CHUNK_SIZE];
+        info = TypeInfo{name, base, std::vector<int>(), 1, 0};
+        for (size_t i = bracket; i != std::string::npos && i < name.size(); i = name.find('[', i + 1)) {
+            int dim = std::atoi(name.c_str() + i + 1);
+            info.dims.push_back(dim);
+            if (dim > 0) {
+                info.elementCount *= dim;
+            }
+        }
+        const std::string &baseName = base == id ? name : this->info(base).name;
+        if (baseName == "integer") {
+            info.baseSize = INT_SIZE;
+        } else if (baseName == "float") {
+            info.baseSize = FLOAT_SIZE;
+        }
+
+        ids.emplace(name, id);
+        count++;
+        return id;
+    }
+};
+
+/*
+ * Handle to an interned type. Converts from and to its spelling, so it can be built from a type node's value and
+ * printed as before, but comparing two handles is an integer compare.
+ * */
+class TypeId {
+public:
+    TypeId() : id(0) {}
+    TypeId(const std::string &name) : id(TypeTable::instance().intern(name)) {}
+    TypeId(const char *name) : id(TypeTable::instance().intern(name)) {}
+
+    static TypeId errorType() { return TypeId(1u); }
+    static TypeId integerType() { return TypeId(2u); }
+    static TypeId floatType() { return TypeId(3u); }
+    static TypeId voidType() { return TypeId(4u); }
+
+    const TypeInfo &info() const { return TypeTable::instance().info(id); }
+    const std::string &str() const { return info().name; }
+    operator const std::string&() const { return str(); }
+
+    /* the type with its dimensions removed, e.g. integer for integer[3][4] */
+    TypeId element() const { return TypeId(info().base); }
+    int numDims() const { return (int)info().dims.size(); }
+    bool isArray() const { return !info().dims.empty(); }
+    bool isBase() const { return id == integerType().id || id == floatType().id; }
+
+    bool operator==(const TypeId &other) const { return id == other.id; }
+    bool operator!=(const TypeId &other) const { return id != other.id; }
+    bool operator==(const char *name) const { return str() == name; }
+    bool operator!=(const char *name) const { return str() != name; }
+
+private:
+    unsigned id;
+
+    explicit TypeId(unsigned id) : id(id) {}
+};
+
+inline std::ostream &operator<<(std::ostream &out, const TypeId &type) {
+    return out << type.str();
+}
+
+/* $end Types */
+
 /* $begin ASTNodes */
 
 enum ASTNodeType {
@@ -100,24 +244,116 @@ enum ASTNodeType {
     VarDecl
 };
 
+class ASTNode;
+class LeafPool;
+
+/*
+ * Child list of an AST node. Most nodes have at most 4 children, so those are stored inline in the node and only
+ * longer lists (statement blocks, member lists, ...) spill to the heap.
+ * */
+class ASTChildren {
+public:
+    using iterator = ASTNode**;
+    using const_iterator = ASTNode* const*;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    ASTChildren() : items(inlineItems), count(0), capacity(INLINE_CAPACITY) {}
+
+    ASTChildren(const ASTChildren&) = delete;
+    ASTChildren& operator=(const ASTChildren&) = delete;
+
+    ~ASTChildren() {
+        if (items != inlineItems) {
+            delete[] items;
+        }
+    }
+
+    void push_back(ASTNode *child) {
+        if (count == capacity) {
+            reserve(capacity * 2);
+        }
+        items[count++] = child;
+    }
+
+    /* forget the children without freeing them, e.g. once they are handed to another tree */
+    void clear() {
+        count = 0;
+    }
+
+    /* replace the contents with a range, e.g. a slice of the semantic stack */
+    template <typename It>
+    void assign(It first, It last) {
+        count = 0;
+        reserve((size_t)std::distance(first, last));
+        for (; first != last; ++first) {
+            items[count++] = *first;
+        }
+    }
+
+    void reserve(size_t newCapacity) {
+        if (newCapacity <= capacity) return;
+        auto **grown = new ASTNode*[newCapacity];
+        std::copy(items, items + count, grown);
+        if (items != inlineItems) {
+            delete[] items;
+        }
+        items = grown;
+        capacity = newCapacity;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    ASTNode*& operator[](size_t i) { return items[i]; }
+    ASTNode* operator[](size_t i) const { return items[i]; }
+
+    iterator begin() { return items; }
+    iterator end() { return items + count; }
+    const_iterator begin() const { return items; }
+    const_iterator end() const { return items + count; }
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+private:
+    static const size_t INLINE_CAPACITY = 4;
+
+    ASTNode **items;
+    size_t count;
+    size_t capacity;
+    ASTNode *inlineItems[INLINE_CAPACITY];
+};
+
 class ASTNode {
 public:
     ASTNodeType type;
     std::string value;
-    std::vector<ASTNode*> children;
-    std::string semanticType;
+    ASTChildren children;
+    TypeId semanticType;
 
     ASTNode *parent = nullptr;
     SymbolTable *symbolTable = nullptr;
     SymbolTableEntry *symbolTableEntry = nullptr;
 
-    std::string subtreeString;
+    // canonical leaf shared between occurrences, owned by its LeafPool rather than by its parent
+    bool interned = false;
 
     explicit ASTNode(ASTNodeType type, std::string value) : type(type), value(std::move(value)) {}
 
+    /* links a child to this node and its scope ; a shared leaf is under many nodes at once, so it gets neither */
+    void adopt(ASTNode *child) {
+        if (child->interned) return;
+        child->parent = this;
+        child->symbolTable = symbolTable;
+    }
+
     virtual ~ASTNode() {
         for (auto child : children) {
-            delete child;
+            if (!child->interned) {
+                delete child;
+            }
         }
     }
 
@@ -259,10 +495,27 @@ public:
     }
 };
 
+/*
+ * What a bare id used as a variable resolved to. The id is a shared leaf, so the dot or the assignment it occurs in
+ * keeps this for it, set by semantic checking.
+ * */
+struct OperandAnnotation {
+    TypeId semanticType;
+    SymbolTableEntry *symbolTableEntry = nullptr;
+};
+
 class DotNode : public ASTNode {
 public:
+    MemberSlot *member = nullptr; // the data member accessed, set by semantic checking
+    OperandAnnotation operands[2]; // of the object and the member, when they are bare ids
+
     DotNode() : ASTNode(Dot, "") {}
 
+    /* the type of an operand, kept here when it is a bare id */
+    TypeId &operandType(int i) {
+        return children[i]->type == Id ? operands[i].semanticType : children[i]->semanticType;
+    }
+
     void accept(ASTNodeVisitor &visitor) override {
         visitor.visit(*this);
     }
@@ -270,7 +523,9 @@ public:
 
 class IntlitNode : public ASTNode {
 public:
-    explicit IntlitNode(const std::string& value) : ASTNode(Intlit, value) {}
+    explicit IntlitNode(const std::string& value) : ASTNode(Intlit, value) {
+        semanticType = TypeId::integerType();
+    }
 
     void accept(ASTNodeVisitor &visitor) override {
         visitor.visit(*this);
@@ -306,6 +561,8 @@ public:
 
 class FunctionCallNode : public ASTNode {
 public:
+    SymbolTableEntry *callee = nullptr; // the overload the call resolved to, set by semantic checking
+
     FunctionCallNode() : ASTNode(FunctionCall, "") {}
 
     void accept(ASTNodeVisitor &visitor) override {
@@ -468,8 +725,14 @@ public:
 
 class AssignStatNode : public ASTNode {
 public:
+    OperandAnnotation target; // of the variable assigned, when it is a bare id
+
     AssignStatNode() : ASTNode(AssignStat, "") {}
 
+    TypeId &targetType() {
+        return children[0]->type == Id ? target.semanticType : children[0]->semanticType;
+    }
+
     void accept(ASTNodeVisitor &visitor) override {
         visitor.visit(*this);
     }
@@ -513,13 +776,82 @@ public:
 
 class ProgNode : public ASTNode {
 public:
+    std::shared_ptr<LeafPool> leaves; // of the tree, kept until the nodes sharing them are freed
+
     ProgNode() : ASTNode(Prog, "") {}
 
+    ~ProgNode() override {
+        for (auto child : children) {
+            if (!child->interned) {
+                delete child;
+            }
+        }
+        children.clear();
+    }
+
     void accept(ASTNodeVisitor &visitor) override {
         visitor.visit(*this);
     }
 };
 
+/*
+ * Hash-consing of immutable leaves. Identical type, visibility, operator, id and integer literal leaves share one
+ * canonical node, flagged interned and owned by the pool. A parse interns into the pool it is given, or into one of
+ * its own, and the root it returns keeps that pool alive. Successive versions of a program are parsed into the same
+ * pool, so that a subtree can move from the tree of one version to the next.
+ * No annotation of a single occurrence is kept in a shared leaf: adopt leaves its parent and scope unset, a literal
+ * has the same type everywhere, and a bare id's entry and type are kept by the node it occurs in, see
+ * OperandAnnotation.
+ * */
+class LeafPool {
+public:
+    LeafPool() = default;
+    LeafPool(const LeafPool&) = delete;
+    LeafPool &operator=(const LeafPool&) = delete;
+
+    ~LeafPool() {
+        for (auto &kind : leaves) {
+            for (auto &leaf : kind) {
+                delete leaf.second;
+            }
+        }
+    }
+
+    ASTNode *leaf(ASTNodeType type, const std::string &value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ASTNode *&node = leaves[type][value];
+        if (node != nullptr) {
+            return node;
+        }
+
+        switch (type) {
+            case Id: node = new IdNode(value); break;
+            case Intlit: node = new IntlitNode(value); break;
+            case Type: node = new TypeNode(value); break;
+            case Visibility: node = new VisibilityNode(value); break;
+            case RelOp: node = new RelOpNode(value); break;
+            case AssignOp: node = new AssignOpNode(value); break;
+            default: throw std::invalid_argument("not a shared leaf kind");
+        }
+        node->interned = true;
+        return node;
+    }
+
+    /* the distinct leaves in the pool */
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t count = 0;
+        for (const auto &kind : leaves) {
+            count += kind.size();
+        }
+        return count;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, ASTNode*> leaves[VarDecl + 1];
+};
+
 /* $end ASTNodes */
 
 /* $begin SymbolTables */
@@ -528,7 +860,7 @@ class SymbolTableEntry {
 public:
     std::string name;
     std::string kind;
-    std::string type;
+    TypeId type;
     SymbolTable *link;
 
     std::string visibility;
@@ -537,7 +869,7 @@ public:
     int offset;
     std::vector<int> dims;
 
-    SymbolTableEntry(std::string name, std::string kind, std::string type, SymbolTable *link) : name(std::move(name)), kind(std::move(kind)), type(std::move(type)), link(link) {
+    SymbolTableEntry(std::string name, std::string kind, TypeId type, SymbolTable *link) : name(std::move(name)), kind(std::move(kind)), type(type), link(link) {
         size = 0;
         offset = 0;
         dims = std::vector<int>();
@@ -546,22 +878,38 @@ public:
 
 class StructEntry : public SymbolTableEntry {
 public:
-    StructEntry(std::string name, std::string type, SymbolTable *link) : SymbolTableEntry(std::move(name), "struct", std::move(type), link) {}
+    StructEntry(std::string name, TypeId type, SymbolTable *link) : SymbolTableEntry(std::move(name), "struct", type, link) {}
 };
 
 class FuncEntry : public SymbolTableEntry {
 public:
-    FuncEntry(std::string name, std::string type, SymbolTable *link) : SymbolTableEntry(std::move(name), "func", std::move(type), link) {}
+    FuncEntry(std::string name, TypeId type, SymbolTable *link) : SymbolTableEntry(std::move(name), "func", type, link) {}
 };
 
 class VarEntry : public SymbolTableEntry {
 public:
-    VarEntry(std::string name, std::string type) : SymbolTableEntry(std::move(name), "var", std::move(type),nullptr) {}
+    VarEntry(std::string name, TypeId type) : SymbolTableEntry(std::move(name), "var", type,nullptr) {}
 };
 
 class ImplEntry : public SymbolTableEntry {
 public:
-    ImplEntry(std::string name, std::string type, SymbolTable *link) : SymbolTableEntry(std::move(name), "impl", std::move(type), link) {}
+    ImplEntry(std::string name, TypeId type, SymbolTable *link) : SymbolTableEntry(std::move(name), "impl", type, link) {}
+};
+
+/*
+ * A data member as seen from a struct, possibly through inheritance: its entry, the struct declaring it and its byte
+ * offset from the start of the struct (-1 until codegen lays the struct out).
+ * */
+struct MemberSlot {
+    SymbolTableEntry *entry;
+    SymbolTable *owner;
+    int offset;
+};
+
+/* a function of a scope along with the types of its parameters, in order */
+struct Overload {
+    SymbolTableEntry *entry;
+    std::vector<TypeId> paramTypes;
 };
 
 class SymbolTable {
@@ -569,14 +917,34 @@ public:
     std::string name;
     std::vector<SymbolTableEntry*> symList;
     SymbolTable* upperScope;
+    SymbolTable* global; // the outermost scope
+    SymbolTable* enclosingStruct = nullptr; // the struct this scope belongs to, the table itself for a struct
+    SymbolTable* enclosingImpl = nullptr; // the impl this scope belongs to, the table itself for an impl
     int size;
     int offset;
     int level;
 
+    // struct tables only, filled by flattenInheritance
+    std::vector<SymbolTable*> ancestors;
+    std::vector<std::string> missingAncestors;
+
     SymbolTable(std::string name, SymbolTable* upperScope, int level) : name(std::move(name)), upperScope(upperScope), level(level) {
         symList = std::vector<SymbolTableEntry*>();
         size = 0;
         offset = 0;
+        global = upperScope ? upperScope->global : this;
+        if (upperScope) {
+            enclosingStruct = upperScope->enclosingStruct;
+            enclosingImpl = upperScope->enclosingImpl;
+        }
+    }
+
+    /*
+     * moves this scope under another one, e.g. an impl under its struct ; the scopes nested in it follow
+     * */
+    void reparent(SymbolTable *newUpperScope) {
+        upperScope = newUpperScope;
+        refreshEnclosingScopes();
     }
 
     ~SymbolTable() {
@@ -587,52 +955,42 @@ public:
 
     void insert(SymbolTableEntry* entry) {
         symList.push_back(entry);
+        index[SymbolKey{foldCase(entry->name), entry->kind}].push_back(entry);
+        kindIndex[foldCase(entry->kind)].push_back(entry);
     }
 
     void remove(SymbolTableEntry* entry) {
         for (int i = 0; i < symList.size(); i++) {
             if (symList[i] == entry) {
                 symList.erase(symList.begin() + i);
+                unindex(index, SymbolKey{foldCase(entry->name), entry->kind}, entry);
+                unindex(kindIndex, foldCase(entry->kind), entry);
                 break;
             }
         }
     }
 
     SymbolTableEntry* lookup(const std::string& lookup, const std::string& kind) {
-        std::string copy = lookup;
-        std::transform(copy.begin(), copy.end(), copy.begin(), ::tolower);
-        for (auto entry : symList) {
-            std::string entryName = entry->name;
-            std::transform(entryName.begin(), entryName.end(), entryName.begin(), ::tolower);
-            if (entryName == copy && entry->kind == kind) {
-                return entry;
-            }
+        auto it = index.find(SymbolKey{foldCase(lookup), kind});
+        if (it == index.end()) {
+            return nullptr;
         }
-        return nullptr;
+        return it->second.front();
     }
 
     std::vector<SymbolTableEntry*> lookupAll(const std::string& lookup, const std::string& kind) {
-        std::vector<SymbolTableEntry*> entries;
-        std::string copy = lookup;
-        std::transform(copy.begin(), copy.end(), copy.begin(), ::tolower);
-        for (auto entry : symList) {
-            std::string entryName = entry->name;
-            std::transform(entryName.begin(), entryName.end(), entryName.begin(), ::tolower);
-            if (entryName == copy && entry->kind == kind) {
-                entries.push_back(entry);
-            }
+        auto it = index.find(SymbolKey{foldCase(lookup), kind});
+        if (it == index.end()) {
+            return std::vector<SymbolTableEntry*>();
         }
-        return entries;
+        return it->second;
     }
 
    std::vector<std::string> lookupAllNamesOfKind(const std::string& kind) {
         std::vector<std::string> names;
-        std::string copy = kind;
-        std::transform(copy.begin(), copy.end(), copy.begin(), ::tolower);
-        for (auto entry : symList) {
-            std::string entryKind = entry->kind;
-            std::transform(entryKind.begin(), entryKind.end(), entryKind.begin(), ::tolower);
-            if (entryKind == copy) {
+        auto it = kindIndex.find(foldCase(kind));
+        if (it != kindIndex.end()) {
+            for (auto entry : it->second) {
                 names.push_back(entry->name);
             }
         }
@@ -641,104 +999,158 @@ public:
 
     std::vector<SymbolTableEntry*> lookupAllOfKind(const std::string& kind) {
         std::vector<SymbolTableEntry*> entries;
-        for (auto entry : symList) {
-            if (entry->kind == kind) {
-                entries.push_back(entry);
+        auto it = kindIndex.find(foldCase(kind));
+        if (it != kindIndex.end()) {
+            for (auto entry : it->second) {
+                if (entry->kind == kind) {
+                    entries.push_back(entry);
+                }
             }
         }
         return entries;
     }
 
-    SymbolTableEntry* lookupVarEntryFromFunctionScope(const std::string& lookup, std::ostream &symerrors) {
-        auto *varEntry = this->lookup(lookup, "var");
-        if (varEntry == nullptr) {
-            // first look if it's a param
-            varEntry = this->lookup(lookup, "param");
-            if (varEntry != nullptr) {
-                return varEntry;
-            } else if (this->level == 1) {
-                symerrors << "11.1 [error] undeclared variable in free function " << this->name << "::" << lookup << std::endl;
-            } else {
-                // look in the struct table
-                auto *structTable = this->upperScope->upperScope;
-                varEntry = structTable->lookup(lookup, "var");
-                if (varEntry == nullptr) {
-                    // look in the inherited structs
-                    std::vector<std::string> inheritNames = structTable->lookupAllNamesOfKind("inherit");
-                    if (!inheritNames.empty()) {
-                        auto *globalTable = structTable->upperScope;
-                        for (const auto &inheritName : inheritNames) {
-                            auto *inheritedStructEntry = globalTable->lookup(inheritName, "struct");
-                            if (inheritedStructEntry == nullptr) {
-                                symerrors << "11.5 [error] undeclared inherited struct " << inheritName << std::endl;
-                                return nullptr;
-                            }
-                            auto *inheritedStructTable = inheritedStructEntry->link;
-                            varEntry = inheritedStructTable->lookup(lookup, "var");
-                            if (varEntry != nullptr) {
-                                break;
-                            }
-                        }
-                        if (varEntry == nullptr) {
-                            symerrors << "11.2 [error] undeclared variable (not in inherited structs) " << structTable->name << "::" << this->name << "::" << lookup << std::endl;
-                        } else {
-                            // found it in the inherited struct table
-                            return varEntry;
-                        }
-                    } else {
-                        // it's not that we didn't find it in the inherited structs, it's that there are no inherited structs
-                        symerrors << "11.2 [error] undeclared variable (no inherited structs to look in)" << structTable->name << "::" << this->name << "::" << lookup << std::endl;
-                    }
-
-                } else {
-                    // found it in the struct table
-                    return varEntry;
+    /*
+     * Linearizes the inheritance of a struct table once impls are bound: ancestors lists every inherited struct once,
+     * depth-first and left to right, and every data member visible from the struct (own members first, then those of
+     * each ancestor in that order) is indexed by name. Inherited structs that are not declared are set aside in
+     * missingAncestors.
+     * */
+    void flattenInheritance() {
+        ancestors.clear();
+        missingAncestors.clear();
+        flatMembers.clear();
+
+        collectAncestors(this);
+        addMembers(this);
+        for (auto *ancestor : ancestors) {
+            addMembers(ancestor);
+        }
+    }
+
+    /* a data member of this struct or of any of its ancestors, nullptr if there is none */
+    MemberSlot *lookupMember(const std::string &lookup) {
+        auto it = flatMembers.find(foldCase(lookup));
+        return it == flatMembers.end() ? nullptr : &it->second;
+    }
+
+    /*
+     * Indexes the functions of this scope by name and number of parameters, once their params are declared.
+     * Overloads with as many parameters keep their declaration order.
+     * */
+    void indexOverloads() {
+        overloadIndex.clear();
+        for (auto *funcEntry : lookupAllOfKind("func")) {
+            Overload overload{funcEntry, {}};
+            if (funcEntry->link != nullptr) {
+                for (auto *param : funcEntry->link->lookupAllOfKind("param")) {
+                    overload.paramTypes.push_back(param->type);
                 }
             }
-        } else {
-            // found it in the function scope
-            return varEntry;
-        }
-
-        return nullptr;
-    }
-
-    SymbolTableEntry *lookupMemberEntryFromStructTable(const std::string &lookup, std::ostream &symerrors) {
-        auto *memberEntry = this->lookup(lookup, "var");
-        if (memberEntry == nullptr) {
-            // look in inherited struct table
-            std::vector<std::string> inheritNames = this->lookupAllNamesOfKind("inherit");
-            if (!inheritNames.empty()) {
-                auto *globalTable = this->upperScope;
-                for (const auto &inheritName : inheritNames) {
-                    auto *inheritedStructEntry = globalTable->lookup(inheritName, "struct");
-                    if (inheritedStructEntry == nullptr) {
-                        symerrors << "11.5 [error] undeclared inherited struct " << inheritName << std::endl;
-                        return nullptr;
-                    }
-                    auto *inheritedStructTable = inheritedStructEntry->link;
-                    memberEntry = inheritedStructTable->lookup(lookup, "var");
-                    if (memberEntry != nullptr) {
-                        break;
-                    }
-                }
-                if (memberEntry == nullptr) {
-                    symerrors << "11.2 [error] undeclared member (not in inherited structs) " << this->name << "::" << lookup << std::endl;
-                } else {
-                    // found it in the inherited struct table
-                    return memberEntry;
-                }
-            } else {
-                // it's not that we didn't find it in the inherited structs, it's that there are no inherited structs
-                symerrors << "11.2 [error] undeclared data member (no inherited structs to look in)" << this->name << "::" << lookup << std::endl;
+            overloadIndex[OverloadKey{foldCase(funcEntry->name), overload.paramTypes.size()}].push_back(std::move(overload));
+        }
+    }
+
+    /* the functions of this scope with that name taking arity parameters, nullptr if there are none */
+    const std::vector<Overload> *lookupOverloads(const std::string &lookup, size_t arity) const {
+        auto it = overloadIndex.find(OverloadKey{foldCase(lookup), arity});
+        return it == overloadIndex.end() ? nullptr : &it->second;
+    }
+
+private:
+    /*
+     * Entries are indexed by (case-folded name, kind) so that a lookup folds only the query and hashes once instead
+     * of folding every entry name in a linear scan. Buckets keep insertion order, so lookup still returns the first
+     * declaration and lookupAll returns them in the order symList prints them.
+     * */
+    struct SymbolKey {
+        std::string name;
+        std::string kind;
+
+        bool operator==(const SymbolKey &other) const {
+            return name == other.name && kind == other.kind;
+        }
+    };
+
+    struct SymbolKeyHash {
+        size_t operator()(const SymbolKey &key) const {
+            size_t h = std::hash<std::string>()(key.name);
+            return h ^ (std::hash<std::string>()(key.kind) + 0x9e3779b9 + (h << 6) + (h >> 2));
+        }
+    };
+
+    std::unordered_map<SymbolKey, std::vector<SymbolTableEntry*>, SymbolKeyHash> index;
+    std::unordered_map<std::string, std::vector<SymbolTableEntry*>> kindIndex;
+    std::unordered_map<std::string, MemberSlot> flatMembers; // case-folded name
+
+    struct OverloadKey {
+        std::string name;
+        size_t arity;
+
+        bool operator==(const OverloadKey &other) const {
+            return arity == other.arity && name == other.name;
+        }
+    };
+
+    struct OverloadKeyHash {
+        size_t operator()(const OverloadKey &key) const {
+            size_t h = std::hash<std::string>()(key.name);
+            return h ^ (key.arity + 0x9e3779b9 + (h << 6) + (h >> 2));
+        }
+    };
+
+    std::unordered_map<OverloadKey, std::vector<Overload>, OverloadKeyHash> overloadIndex;
+
+    void refreshEnclosingScopes() {
+        global = upperScope ? upperScope->global : this;
+        if (enclosingStruct != this) enclosingStruct = upperScope ? upperScope->enclosingStruct : nullptr;
+        if (enclosingImpl != this) enclosingImpl = upperScope ? upperScope->enclosingImpl : nullptr;
+        for (auto *entry : symList) {
+            if (entry->link != nullptr && entry->link->upperScope == this) {
+                entry->link->refreshEnclosingScopes();
+            }
+        }
+    }
+
+    void collectAncestors(SymbolTable *table) {
+        for (const auto &inheritName : table->lookupAllNamesOfKind("inherit")) {
+            auto *structEntry = upperScope->lookup(inheritName, "struct");
+            if (structEntry == nullptr) {
+                missingAncestors.push_back(inheritName);
+                continue;
+            }
+            // shared ancestors and inheritance cycles are only walked once
+            auto *inherited = structEntry->link;
+            if (inherited == this || std::find(ancestors.begin(), ancestors.end(), inherited) != ancestors.end()) {
+                continue;
             }
-        } else {
-            return memberEntry;
+            ancestors.push_back(inherited);
+            collectAncestors(inherited);
         }
+    }
 
-        return nullptr;
+    void addMembers(SymbolTable *table) {
+        for (auto *entry : table->lookupAllOfKind("var")) {
+            // the first declaration along the linearization wins
+            flatMembers.emplace(foldCase(entry->name), MemberSlot{entry, table, -1});
+        }
     }
 
+    static std::string foldCase(std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        return s;
+    }
+
+    template <typename Map, typename Key>
+    static void unindex(Map &map, const Key &key, SymbolTableEntry *entry) {
+        auto it = map.find(key);
+        if (it == map.end()) return;
+        auto &bucket = it->second;
+        bucket.erase(std::remove(bucket.begin(), bucket.end(), entry), bucket.end());
+        if (bucket.empty()) {
+            map.erase(it);
+        }
+    }
 };
 
 /* $end SymbolTables */
@@ -0,0 +1,61 @@
+#include <astcache.hpp>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+/*
+ * Compares a cold compile front end (lex + parse) against a warm one (AST loaded from the parse cache).
+ * usage: compiler_parse_cache_bench <source file> <grammar table csv> [iterations]
+ * */
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <source file> <grammar table csv> [iterations]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream sourceFile(argv[1]);
+    std::stringstream ss;
+    ss << sourceFile.rdbuf();
+    std::string source = ss.str();
+
+    std::map<TableKey, ProductionRule> TT;
+    parseCSVIntoTT(argv[2], TT);
+    int iterations = argc > 3 ? std::stoi(argv[3]) : 20;
+    std::string cacheDir = "parse_cache_bench.d";
+
+    std::ofstream devnull("/dev/null");
+    double coldMs = 0, warmMs = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        Lexer lexer = lexerNew(source.c_str());
+        ASTNode *root = parse(lexer, TT, devnull, devnull, devnull);
+        auto end = std::chrono::steady_clock::now();
+        coldMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+        if (i == 0 && !storeCachedAST(cacheDir, source, TT, root)) {
+            std::cerr << "could not write the parse cache (did the source parse?)" << std::endl;
+            return 1;
+        }
+        delete root;
+        lexerFree(&lexer);
+    }
+
+    for (int i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        ASTNode *root = loadCachedAST(cacheDir, source, TT);
+        auto end = std::chrono::steady_clock::now();
+        warmMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+        if (root == nullptr) {
+            std::cerr << "parse cache miss" << std::endl;
+            return 1;
+        }
+        delete root;
+    }
+
+    std::cout << "cold (lex + parse): " << coldMs / iterations << " ms" << std::endl;
+    std::cout << "warm (cache load):  " << warmMs / iterations << " ms" << std::endl;
+    return 0;
+}
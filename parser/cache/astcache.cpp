@@ -0,0 +1,301 @@
+#include <astcache.hpp>
+#include <cstdio>
+#include <stack>
+#include <unordered_map>
+#include <sys/stat.h>
+
+static const char AST_MAGIC[3] = {'A', 'S', 'T'};
+static const unsigned char AST_VERSION = 1;
+
+/* $begin hashing */
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+static uint64_t fnv1a(const char *data, size_t length, uint64_t hash = FNV_OFFSET) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t fnv1a(const std::string &s, uint64_t hash) {
+    // include the terminator so that "ab","c" and "a","bc" hash differently
+    return fnv1a(s.c_str(), s.size() + 1, hash);
+}
+
+uint64_t hashSource(const std::string &source) {
+    return fnv1a(source.data(), source.size());
+}
+
+uint64_t hashParseTable(const std::map<TableKey, ProductionRule> &TT) {
+    uint64_t hash = FNV_OFFSET;
+    for (const auto &entry : TT) {
+        hash = fnv1a(entry.first.first, hash);
+        hash = fnv1a(entry.first.second, hash);
+        for (const auto &symbol : entry.second) {
+            hash = fnv1a(symbol, hash);
+        }
+    }
+    return hash;
+}
+
+/* $end hashing */
+
+/* $begin serialization */
+
+static void writeVarint(std::string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+static bool readVarint(const char *&p, const char *end, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        unsigned char byte = (unsigned char)*p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void serializeAST(const ASTNode *root, std::string &out) {
+    std::unordered_map<std::string, uint64_t> stringIds;
+    std::vector<const std::string*> strings;
+    std::string nodes;
+    uint64_t nodeCount = 0;
+
+    // pre-order walk with an explicit stack ; children are pushed in reverse to keep their order
+    std::stack<const ASTNode*> pending;
+    if (root) pending.push(root);
+    while (!pending.empty()) {
+        const ASTNode *node = pending.top();
+        pending.pop();
+
+        auto it = stringIds.find(node->value);
+        if (it == stringIds.end()) {
+            it = stringIds.emplace(node->value, strings.size()).first;
+            strings.push_back(&it->first);
+        }
+
+        writeVarint(nodes, node->type);
+        writeVarint(nodes, it->second);
+        writeVarint(nodes, node->children.size());
+        nodeCount++;
+
+        for (auto child = node->children.rbegin(); child != node->children.rend(); ++child) {
+            pending.push(*child);
+        }
+    }
+
+    out.assign(AST_MAGIC, sizeof(AST_MAGIC));
+    out.push_back((char)AST_VERSION);
+    writeVarint(out, strings.size());
+    for (auto *s : strings) {
+        writeVarint(out, s->size());
+        out.append(*s);
+    }
+    writeVarint(out, nodeCount);
+    out.append(nodes);
+}
+
+static void discardAST(ASTNode *root) {
+    if (root && !root->interned) {
+        delete root;
+    }
+}
+
+ASTNode *deserializeAST(const char *data, size_t length, std::shared_ptr<LeafPool> leaves) {
+    const char *p = data;
+    const char *end = data + length;
+
+    if (length < sizeof(AST_MAGIC) + 1 || std::string(p, sizeof(AST_MAGIC)) != std::string(AST_MAGIC, sizeof(AST_MAGIC))
+        || (unsigned char)p[sizeof(AST_MAGIC)] != AST_VERSION) {
+        return nullptr;
+    }
+    p += sizeof(AST_MAGIC) + 1;
+
+    uint64_t stringCount;
+    if (!readVarint(p, end, stringCount) || stringCount > length) return nullptr;
+
+    std::vector<std::string> strings;
+    strings.reserve(stringCount);
+    for (uint64_t i = 0; i < stringCount; i++) {
+        uint64_t size;
+        if (!readVarint(p, end, size) || size > (uint64_t)(end - p)) return nullptr;
+        strings.emplace_back(p, size);
+        p += size;
+    }
+
+    // a node takes at least three bytes, one per varint
+    uint64_t nodeCount;
+    if (!readVarint(p, end, nodeCount) || nodeCount == 0 || nodeCount > (uint64_t)(end - p) / 3) return nullptr;
+
+    if (leaves == nullptr) {
+        leaves = std::make_shared<LeafPool>();
+    }
+
+    // each open node remembers how many children it still expects ; the root is always a program
+    ASTNode *root = nullptr;
+    std::stack<std::pair<ASTNode*, uint64_t>> open;
+    for (uint64_t i = 0; i < nodeCount; i++) {
+        uint64_t kind, stringId, childCount;
+        if (!readVarint(p, end, kind) || !readVarint(p, end, stringId) || !readVarint(p, end, childCount)
+            || kind > VarDecl || stringId >= strings.size() || (i > 0 && open.empty()) || (i == 0 && kind != Prog)
+            || childCount > nodeCount - i - 1) {
+            discardAST(root);
+            return nullptr;
+        }
+
+        ASTNode *node = makeASTNode((ASTNodeType)kind, strings[stringId], *leaves);
+        if (node->interned && childCount > 0) {
+            // shared leaves never have children
+            discardAST(root);
+            return nullptr;
+        }
+        if (open.empty()) {
+            root = node;
+        } else {
+            open.top().first->children.push_back(node);
+            open.top().second--;
+        }
+
+        while (!open.empty() && open.top().second == 0) {
+            open.pop();
+        }
+        if (childCount > 0) {
+            node->children.reserve(childCount);
+            open.emplace(node, childCount);
+        }
+    }
+
+    if (!open.empty() || p != end) {
+        discardAST(root);
+        return nullptr;
+    }
+
+    static_cast<ProgNode*>(root)->leaves = leaves;
+    return root;
+}
+
+ASTNode *makeASTNode(ASTNodeType type, const std::string &value, LeafPool &leaves) {
+    switch (type) {
+        case Epsilon: return new EpsilonNode();
+        case Prog: return new ProgNode();
+        case StructDecl: return new StructDeclNode();
+        case FuncDef: return new FuncDefNode();
+        case ImplDef: return new ImplDefNode();
+        case InheritList: return new InheritListNode();
+        case AddOp: return new AddOpNode(value);
+        case AParamsList: return new AParamsListNode();
+        case ArraySizeList: return new ArraySizeListNode();
+        case AssignOp: return leaves.leaf(AssignOp, value);
+        case VarDeclOrStatBlock: return new VarDeclOrStatBlockNode();
+        case StatBlock: return new StatBlockNode();
+        case Dot: return new DotNode();
+        case Intlit: return leaves.leaf(Intlit, value);
+        case Floatlit: return new FloatlitNode(value);
+        case Not: return new NotNode(value);
+        case Sign: return new SignNode(value);
+        case FunctionCall: return new FunctionCallNode();
+        case Variable: return new VariableNode();
+        case FuncDecl: return new FuncDeclNode();
+        case FParam: return new FParamNode();
+        case FParamList: return new FParamListNode();
+        case Id: return leaves.leaf(Id, value);
+        case IndiceList: return new IndiceListNode();
+        case ImplFuncList: return new ImplFuncListNode();
+        case MultOp: return new MultOpNode(value);
+        case Member: return new MemberNode();
+        case RelOp: return leaves.leaf(RelOp, value);
+        case RelExpr: return new RelExprNode();
+        case MemberList: return new MemberListNode();
+        case IfStat: return new IfStatNode();
+        case WhileStat: return new WhileStatNode();
+        case ReadStat: return new ReadStatNode();
+        case WriteStat: return new WriteStatNode();
+        case ReturnStat: return new ReturnStatNode();
+        case AssignStat: return new AssignStatNode();
+        case Type: return leaves.leaf(Type, value);
+        case Visibility: return leaves.leaf(Visibility, value);
+        case VarDecl: return new VarDeclNode();
+    }
+    return nullptr;
+}
+
+/* $end serialization */
+
+/* $begin parse cache */
+
+std::string cachedASTPath(const std::string &cacheDir, const std::string &source, const std::map<TableKey, ProductionRule> &TT) {
+    char name[40];
+    snprintf(name, sizeof(name), "%016llx%016llx.ast",
+             (unsigned long long)hashSource(source), (unsigned long long)hashParseTable(TT));
+    return cacheDir + "/" + name;
+}
+
+/*
+ * returns the cached AST for this source and parse table, or nullptr on a miss.
+ * A hit costs a single read of the cache file.
+ * */
+ASTNode *loadCachedAST(const std::string &cacheDir, const std::string &source, const std::map<TableKey, ProductionRule> &TT,
+                       std::shared_ptr<LeafPool> leaves) {
+    std::string path = cachedASTPath(cacheDir, source, TT);
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 || st.st_size <= 0) {
+        fclose(fp);
+        return nullptr;
+    }
+
+    std::string buffer((size_t)st.st_size, '\0');
+    size_t n = fread(&buffer[0], 1, buffer.size(), fp);
+    fclose(fp);
+    if (n != buffer.size()) {
+        return nullptr;
+    }
+
+    return deserializeAST(buffer.data(), buffer.size(), std::move(leaves));
+}
+
+/*
+ * writes the AST to the cache ; the file is renamed into place so a concurrent reader never sees a partial entry
+ * */
+bool storeCachedAST(const std::string &cacheDir, const std::string &source, const std::map<TableKey, ProductionRule> &TT, const ASTNode *root) {
+    if (root == nullptr) {
+        return false;
+    }
+
+    mkdir(cacheDir.c_str(), 0755);
+
+    std::string buffer;
+    serializeAST(root, buffer);
+
+    std::string path = cachedASTPath(cacheDir, source, TT);
+    std::string tmpPath = path + ".tmp";
+    FILE *fp = fopen(tmpPath.c_str(), "wb");
+    if (fp == nullptr) {
+        return false;
+    }
+
+    bool ok = fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size();
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        remove(tmpPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/* $end parse cache */
@@ -0,0 +1,29 @@
+#ifndef COMPILER_ASTCACHE_HPP
+#define COMPILER_ASTCACHE_HPP
+
+#include <parser.hpp>
+#include <cstdint>
+#include <string>
+
+/*
+ * Binary AST format:
+ *   magic "AST" + version byte
+ *   varint string count, then (varint length, bytes) per interned string
+ *   varint node count, then per node in pre-order: varint kind, varint string index, varint child count
+ * */
+
+uint64_t hashSource(const std::string &source);
+uint64_t hashParseTable(const std::map<TableKey, ProductionRule> &TT);
+
+void serializeAST(const ASTNode *root, std::string &out);
+/* the leaves of the tree returned are shared in the given pool, or in a new one ; its root keeps the pool alive */
+ASTNode *deserializeAST(const char *data, size_t length, std::shared_ptr<LeafPool> leaves = nullptr);
+ASTNode *makeASTNode(ASTNodeType type, const std::string &value, LeafPool &leaves);
+
+/* on-disk parse cache, keyed by the source contents and the parse table */
+std::string cachedASTPath(const std::string &cacheDir, const std::string &source, const std::map<TableKey, ProductionRule> &TT);
+ASTNode *loadCachedAST(const std::string &cacheDir, const std::string &source, const std::map<TableKey, ProductionRule> &TT,
+                       std::shared_ptr<LeafPool> leaves = nullptr);
+bool storeCachedAST(const std::string &cacheDir, const std::string &source, const std::map<TableKey, ProductionRule> &TT, const ASTNode *root);
+
+#endif //COMPILER_ASTCACHE_HPP
@@ -3,17 +3,20 @@
 #include <parser.hpp>
 #include <algorithm>
 #include <iostream>
+#include <set>
+#include <cstdio>
 
 
 /* parse functions */
-void skipError(Lexer& lexer, std::stack<std::string>& parseStack, Token& lookahead);
+void skipError(Lexer& lexer, std::stack<std::string>& parseStack, Token& lookahead, const RecoverySets& sets);
 void inverseRHSMultiplePush(std::stack<std::string>& parseStack, const std::vector<std::string>& rule);
 bool isTerminal(const std::string& symbol);
 std::string tokenTypeToString(TokenType type);
+int terminalToTokenType(const std::string& terminal);
 void printStack(const std::stack<std::string>& stack, std::ofstream& outfile);
 
 /* print AST */
-std::string getASTNodeTypeToString(ASTNodeType type) {
+const char *getASTNodeTypeToString(ASTNodeType type) {
     switch (type) {
         case Epsilon: return "Epsilon";
         case Prog: return "Prog";
@@ -58,660 +61,527 @@ std::string getASTNodeTypeToString(ASTNodeType type) {
     }
 }
 
-void printAST(std::ofstream& astfile, const ASTNode* node, int depth = 0) {
-    if (!node) return;
+/*
+ * Buffered writer for AST dumps ; lines are accumulated and written in large blocks instead of flushed one by one
+ * */
+class ASTDumpWriter {
+public:
+    explicit ASTDumpWriter(std::ostream& out) : out(out) {
+        buffer.reserve(BUFFER_SIZE);
+    }
 
-    // Print leading spaces to indicate depth
-    std::string indent(depth * 2, ' ');
-    astfile << indent << getASTNodeTypeToString(node->type) << " : " << node->value << std::endl;
+    ~ASTDumpWriter() {
+        flush();
+    }
 
-    // Recursively print children
-    for (ASTNode* child : node->children) {
-        printAST(astfile, child, depth + 1);
+    ASTDumpWriter& operator<<(const char *s) {
+        buffer.append(s);
+        return flushIfFull();
     }
-}
 
-// hard-coded first and follow sets for use in error handling and recovery
-std::unordered_map<std::string, std::unordered_set<std::string>> FirstSets = {
-        {"ADDOP", {"plus", "minus", "or"}},
-        {"ARRAYSIZE2", {"intlit", "rsqbr"}},
-        {"ASSIGNSTAT", {"id"}},
-        {"EXPR2", {"eq", "neq", "lt", "gt", "leq", "geq"}},
-        {"FACTOR2", {"lpar", "lsqbr"}},
-        {"REPTVARIABLEORFUNCTIONCALL", {"dot"}},
-        {"IDNEST", {"id"}},
-        {"IDNEST3", {"dot"}},
-        {"IDNEST2", {"lpar", "lsqbr"}},
-        {"FUNCBODY", {"lcurbr"}},
-        {"FUNCHEAD", {"func"}},
-        {"FPARAMS", {"id"}},
-        {"FUNCDECL", {"func"}},
-        {"ARITHEXPR", {"id", "intlit", "floatlit", "lpar", "not", "plus", "minus"}},
-        {"RELOP", {"eq", "neq", "lt", "gt", "leq", "geq"}},
-        {"APARAMSTAIL", {"comma"}},
-        {"REPTAPARAMS1", {"comma"}},
-        {"REPTFPARAMS3", {"lsqbr"}},
-        {"FPARAMSTAIL", {"comma"}},
-        {"REPTFPARAMS4", {"comma"}},
-        {"REPTFPARAMSTAIL4", {"lsqbr"}},
-        {"REPTFUNCBODY1", {"let", "if", "while", "read", "write", "return", "id"}},
-        {"INDICE", {"lsqbr"}},
-        {"REPTIMPLDEF3", {"func"}},
-        {"REPTOPTSTRUCTDECL22", {"comma"}},
-        {"REPTPROG0", {"struct", "impl", "func"}},
-        {"MEMBERDECL", {"let", "func"}},
-        {"ARRAYSIZE", {"lsqbr"}},
-        {"RETURNTYPE", {"void", "integer", "float", "id"}},
-        {"RIGHTRECARITHEXPR", {"plus", "minus", "or"}},
-        {"MULTOP", {"mult", "div", "and"}},
-        {"SIGN", {"plus", "minus"}},
-        {"START", {"struct", "impl", "func"}},
-        {"PROG", {"struct", "impl", "func"}},
-        {"REPTSTATBLOCK1", {"if", "while", "read", "write", "return", "id"}},
-        {"RELEXPR", {"id", "intlit", "floatlit", "lpar", "not", "plus", "minus"}},
-        {"STATBLOCK", {"lcurbr", "if", "while", "read", "write", "return", "id"}},
-        {"STATEMENT2", {"lpar", "dot", "lsqbr", "equal"}},
-        {"OPTSTRUCTDECL2", {"inherits"}},
-        {"REPTSTRUCTDECL4", {"public", "private"}},
-        {"STRUCTORIMPLORFUNC", {"struct", "impl", "func"}},
-        {"STRUCTDECL", {"struct"}},
-        {"IMPLDEF", {"impl"}},
-        {"FUNCDEF", {"func"}},
-        {"TERM", {"id", "intlit", "floatlit", "lpar", "not", "plus", "minus"}},
-        {"FACTOR", {"id", "intlit", "floatlit", "lpar", "not", "plus", "minus"}},
-        {"RIGHTRECTERM", {"mult", "div", "and"}},
-        {"TYPE", {"integer", "float", "id"}},
-        {"REPTVARDECL4", {"lsqbr"}},
-        {"VARDECLORSTAT", {"let", "if", "while", "read", "write", "return", "id"}},
-        {"VARDECL", {"let"}},
-        {"STATEMENT", {"if", "while", "read", "write", "return", "id"}},
-        {"VARIABLE", {"id"}},
-        {"VARIABLE2", {"lpar", "lsqbr", "dot"}},
-        {"REPTVARIABLE", {"dot"}},
-        {"VARIDNEST2", {"lpar", "lsqbr"}},
-        {"APARAMS", {"id", "intlit", "floatlit", "lpar", "not", "plus", "minus"}},
-        {"VARIDNEST", {"dot"}},
-        {"REPTIDNEST1", {"lsqbr"}},
-        {"VISIBILITY", {"public", "private"}},
-        {"STATEMENT3", {"dot"}},
-        {"STATEMENT4", {"dot", "equal"}},
-        {"ASSIGNOP", {"equal"}},
-        {"EXPR", {"id", "intlit", "floatlit", "lpar", "not", "plus", "minus"}}
-};
+    ASTDumpWriter& operator<<(const std::string& s) {
+        buffer.append(s);
+        return flushIfFull();
+    }
+
+    ASTDumpWriter& operator<<(char c) {
+        buffer.push_back(c);
+        return flushIfFull();
+    }
+
+    ASTDumpWriter& operator<<(size_t n) {
+        buffer.append(std::to_string(n));
+        return flushIfFull();
+    }
+
+    void indent(size_t n) {
+        buffer.append(n, ' ');
+    }
+
+    void escaped(const std::string& s) {
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                buffer.push_back('\\');
+                buffer.push_back(c);
+            } else if ((unsigned char)c < 0x20) {
+                char hex[8];
+                snprintf(hex, sizeof(hex), "\\u%04x", c);
+                buffer.append(hex);
+            } else {
+                buffer.push_back(c);
+            }
+        }
+        flushIfFull();
+    }
 
-std::unordered_map<std::string, std::unordered_set<std::string>> FollowSets = {
-        {"ADDOP", {"id", "intlit", "floatlit", "lpar", "not", "plus", "minus"}},
-        {"ARRAYSIZE2", {"semi", "lsqbr", "rpar", "comma"}},
-        {"ASSIGNSTAT", {""}},
-        {"EXPR2", {"semi", "comma", "rpar"}},
-        {"FACTOR2", {"semi", "mult", "div", "and", "dot", "rsqbr", "eq", "neq", "lt", "gt", "leq", "geq", "plus", "minus", "or", "comma", "rpar"}},
-        {"REPTVARIABLEORFUNCTIONCALL", {"semi", "mult", "div", "and", "rsqbr", "eq", "neq", "lt", "gt", "leq", "geq", "plus", "minus", "or", "comma", "rpar"}},
-        {"IDNEST", {""}},
-        {"IDNEST3", {"semi", "mult", "div", "and", "dot", "rsqbr", "eq", "neq", "lt", "gt", "leq", "geq", "plus", "minus", "or", "comma", "rpar"}},
-        {"IDNEST2", {"semi", "mult", "div", "and", "dot", "rsqbr", "eq", "neq", "lt", "gt", "leq", "geq", "plus", "minus", "or", "comma", "rpar"}},
-        {"FUNCBODY", {"struct", "impl", "func", "rcurbr"}},
-        {"FUNCHEAD", {"semi", "lcurbr"}},
-        {"FPARAMS", {"rpar"}},
-        {"FUNCDECL", {"rcurbr", "public", "private"}},
-        {"ARITHEXPR", {"semi", "rsqbr", "eq", "neq", "lt", "gt", "leq", "geq", "comma", "rpar"}},
-        {"RELOP", {"id", "intlit", "floatlit", "lpar", "not", "plus", "minus"}},
-        {"APARAMSTAIL", {"comma", "rpar"}},
-        {"REPTAPARAMS1", {"rpar"}},
-        {"REPTFPARAMS3", {"rpar", "comma"}},
-        {"FPARAMSTAIL", {"comma", "rpar"}},
-        {"REPTFPARAMS4", {"rpar"}},
-        {"REPTFPARAMSTAIL4", {"comma", "rpar"}},
-        {"REPTFUNCBODY1", {"rcurbr"}},
-        {"INDICE", {"semi", "mult", "div", "and", "lsqbr", "dot", "rsqbr", "eq", "neq", "lt", "gt", "leq", "geq", "equal", "plus", "minus", "or", "comma", "rpar"}},
-        {"REPTIMPLDEF3", {"rcurbr"}},
-        {"REPTOPTSTRUCTDECL22", {"lcurbr"}},
-        {"REPTPROG0", {""}},
-        {"MEMBERDECL", {"rcurbr", "public", "private"}},
-        {"ARRAYSIZE", {"semi", "lsqbr", "rpar", "comma"}},
-        {"RETURNTYPE", {"semi", "lcurbr"}},
-        {"RIGHTRECARITHEXPR", {"semi", "rsqbr", "eq", "neq", "lt", "gt", "leq", "geq", "comma", "rpar"}},
-        {"MULTOP", {"id", "intlit", "floatlit", "lpar", "not", "plus", "minus"}},
-        {"SIGN", {"id", "intlit", "floatlit", "lpar", "not", "plus", "minus"}},
-        {"START", {""}},
-        {"PROG", {""}},
-        {"REPTSTATBLOCK1", {"rcurbr"}},
-        {"RELEXPR", {"rpar"}},
-        {"STATBLOCK", {"else", "semi"}},
-        {"STATEMENT2", {"semi"}},
-        {"STATEMENT3", {"semi"}},
-        {"STATEMENT4", {"semi"}},
-        {"ASSIGNOP", {"id", "intlit", "floatlit", "lpar", "not", "plus", "minus"}},
-        {"EXPR", {"semi", "comma", "rpar"}},
-        {"OPTSTRUCTDECL2", {"lcurbr"}},
-        {"REPTSTRUCTDECL4", {"rcurbr"}},
-        {"STRUCTORIMPLORFUNC", {"struct", "impl", "func"}},
-        {"STRUCTDECL", {"struct", "impl", "func"}},
-        {"IMPLDEF", {"struct", "impl", "func"}},
-        {"FUNCDEF", {"struct", "impl", "func", "rcurbr"}},
-        {"TERM", {"semi", "rsqbr", "eq", "neq", "lt", "gt", "leq", "geq", "plus", "minus", "or", "comma", "rpar"}},
-        {"FACTOR", {"semi", "mult", "div", "and", "rsqbr", "eq", "neq", "lt", "gt", "leq", "geq", "plus", "minus", "or", "comma", "rpar"}},
-        {"RIGHTRECTERM", {"semi", "rsqbr", "eq", "neq", "lt", "gt", "leq", "geq", "plus", "minus", "or", "comma", "rpar"}},
-        {"TYPE", {"rpar", "lcurbr", "comma", "lsqbr", "semi"}},
-        {"REPTVARDECL4", {"semi"}},
-        {"VARDECLORSTAT", {"let", "if", "while", "read", "write", "return", "id", "rcurbr"}},
-        {"VARDECL", {"public", "private", "let", "if", "while", "read", "write", "return", "id", "rcurbr"}},
-        {"STATEMENT", {"else", "semi", "let", "if", "while", "read", "write", "return", "id", "rcurbr"}},
-        {"VARIABLE", {"equal", "rpar"}},
-        {"VARIABLE2", {"equal", "rpar"}},
-        {"REPTVARIABLE", {"equal", "rpar"}},
-        {"VARIDNEST2", {"dot", "semi", "equal", "rpar"}},
-        {"APARAMS", {"rpar"}},
-        {"VARIDNEST", {"dot", "semi", "equal", "rpar"}},
-        {"REPTIDNEST1", {"semi", "mult", "div", "and", "dot", "rsqbr", "eq", "neq", "lt", "gt", "leq", "geq", "equal", "plus", "minus", "or", "comma", "rpar"}},
-        {"VISIBILITY", {"let", "func"}}
+    void flush() {
+        out.write(buffer.data(), (std::streamsize)buffer.size());
+        buffer.clear();
+    }
+
+private:
+    static const size_t BUFFER_SIZE = 1 << 16;
+
+    std::ostream& out;
+    std::string buffer;
+
+    ASTDumpWriter& flushIfFull() {
+        if (buffer.size() >= BUFFER_SIZE) {
+            flush();
+        }
+        return *this;
+    }
 };
 
+/*
+ * Non-recursive AST dump. The explicit stack holds nodes still to visit; for s-expressions a null node marks where a
+ * closing parenthesis goes.
+ *   ASTDumpTree:      indented "Type : value" lines
+ *   ASTDumpSExpr:     (Type "value" children...)
+ *   ASTDumpJSONLines: one {"id","parent","depth","type","value"} object per node, in pre-order
+ * */
+void dumpAST(std::ostream& out, const ASTNode* root, ASTDumpFormat format) {
+    if (!root || format == ASTDumpNone) return;
+
+    struct Pending {
+        const ASTNode *node;
+        size_t depth;
+        size_t parent;
+    };
+
+    ASTDumpWriter writer(out);
+    std::vector<Pending> stack;
+    stack.push_back({root, 0, 0});
+    size_t nextId = 1;
+
+    while (!stack.empty()) {
+        Pending current = stack.back();
+        stack.pop_back();
+
+        if (current.node == nullptr) {
+            writer << ')';
+            if (current.depth == 0) writer << '\n';
+            continue;
+        }
+
+        const ASTNode *node = current.node;
+        size_t id = nextId++;
+
+        switch (format) {
+            case ASTDumpTree:
+                writer.indent(current.depth * 2);
+                writer << getASTNodeTypeToString(node->type) << " : " << node->value << '\n';
+                break;
+            case ASTDumpSExpr:
+                if (current.depth > 0) writer << ' ';
+                writer << '(' << getASTNodeTypeToString(node->type);
+                if (!node->value.empty()) {
+                    writer << " \"";
+                    writer.escaped(node->value);
+                    writer << '"';
+                }
+                stack.push_back({nullptr, current.depth, 0});
+                break;
+            case ASTDumpJSONLines:
+                writer << "{\"id\":" << id << ",\"parent\":" << current.parent << ",\"depth\":" << current.depth
+                       << ",\"type\":\"" << getASTNodeTypeToString(node->type) << "\",\"value\":\"";
+                writer.escaped(node->value);
+                writer << "\"}\n";
+                break;
+            default:
+                break;
+        }
+
+        // push in reverse so children are visited in order
+        for (auto child = node->children.rbegin(); child != node->children.rend(); ++child) {
+            if (*child) stack.push_back({*child, current.depth + 1, id});
+        }
+    }
+}
+
+/*
+ * pop everything above the nearest epsilon marker into the list node's children in one move, keeping source order
+ * */
+static void reduceList(std::vector<ASTNode*>& semanticStack, ASTNode *list) {
+    auto first = semanticStack.end();
+    while ((*(first - 1))->type != Epsilon) {
+        --first;
+    }
+
+    list->children.assign(first, semanticStack.end());
+    delete *(first - 1); // the marker itself
+    semanticStack.erase(first - 1, semanticStack.end());
+    semanticStack.push_back(list);
+}
 
 /* switch on semantic action, call the appropriate function, return true if it was a semantic action */
-bool callSemanticAction(std::stack<ASTNode*>& semanticStack, const std::string& action, Token &a) {
+bool callSemanticAction(std::vector<ASTNode*>& semanticStack, const std::string& action, Token &a, LeafPool &leaves) {
     if (action == "AA") {
-        semanticStack.push(new EpsilonNode());
+        semanticStack.push_back(new EpsilonNode());
         return true;
     } else if (action == "A1") {
         if (a->type == TokenTypePlus || a->type == TokenTypeMinus || a->type == TokenTypeOr) {
-            semanticStack.push(new AddOpNode(a->value));
+            semanticStack.push_back(new AddOpNode(a->value));
             return true;
         } else {
             return false;
         }
     } else if (action == "A2") {
-        std::vector<ASTNode*> children;
-        while (semanticStack.top()->type != Epsilon) {
-            children.push_back(semanticStack.top());
-            semanticStack.pop();
-        }
-
-        semanticStack.pop();
-        std::reverse(children.begin(), children.end());
-
-        ASTNode* aparamslist = new AParamsListNode();
-        for (auto child : children) {
-            aparamslist->children.push_back(child);
-        }
-        semanticStack.push(aparamslist);
+        reduceList(semanticStack, new AParamsListNode());
         return true;
     } else if (action == "A3") {
-        std::vector<ASTNode*> children;
-        while (semanticStack.top()->type != Epsilon) {
-            children.push_back(semanticStack.top());
-            semanticStack.pop();
-        }
-
-        semanticStack.pop();
-        std::reverse(children.begin(), children.end());
-
-        ASTNode *arraysizelist = new ArraySizeListNode();
-        for (auto child : children) {
-            arraysizelist->children.push_back(child);
-        }
-        semanticStack.push(arraysizelist);
+        reduceList(semanticStack, new ArraySizeListNode());
         return true;
     } else if (action == "A4") {
-        ASTNode *term1 = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *addop = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *term2 = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *term1 = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *addop = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *term2 = semanticStack.back();
+        semanticStack.pop_back();
 
         addop->children.push_back(term2);
         addop->children.push_back(term1);
 
-        semanticStack.push(addop);
+        semanticStack.push_back(addop);
         return true;
     } else if (action == "A5") {
         if (a->type == TokenTypeAssign) {
-            semanticStack.push(new AssignOpNode(a->value));
+            semanticStack.push_back(leaves.leaf(AssignOp, a->value));
             return true;
         } else {
             return false;
         }
     } else if (action == "B1") {
-        std::vector<ASTNode*> children;
-        while (semanticStack.top()->type != Epsilon) {
-            children.push_back(semanticStack.top());
-            semanticStack.pop();
-        }
-
-        semanticStack.pop();
-        std::reverse(children.begin(), children.end());
-
-        ASTNode *vardecorstatblock = new VarDeclOrStatBlockNode();
-        for (auto child : children) {
-            vardecorstatblock->children.push_back(child);
-        }
-        semanticStack.push(vardecorstatblock);
+        reduceList(semanticStack, new VarDeclOrStatBlockNode());
         return true;
     } else if (action == "B2") {
         ASTNode *statBlock = new StatBlockNode();
-        semanticStack.push(statBlock);
+        semanticStack.push_back(statBlock);
         return true;
     } else if (action == "B3") {
-        ASTNode *statblock = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *statement = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *statblock = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *statement = semanticStack.back();
+        semanticStack.pop_back();
 
         statblock->children.push_back(statement);
-        semanticStack.push(statblock);
+        semanticStack.push_back(statblock);
 
         return true;
     } else if (action == "B4") {
-        std::vector<ASTNode*> children;
-        while (semanticStack.top()->type != Epsilon) {
-            children.push_back(semanticStack.top());
-            semanticStack.pop();
-        }
-
-        semanticStack.pop();
-        std::reverse(children.begin(), children.end());
-
-        ASTNode *statblock = new StatBlockNode();
-        for (auto child : children) {
-            statblock->children.push_back(child);
-        }
-        semanticStack.push(statblock);
+        reduceList(semanticStack, new StatBlockNode());
         return true;
     } else if (action == "D1") {
         ASTNode *dot = new DotNode();
-        semanticStack.push(dot);
+        semanticStack.push_back(dot);
         return true;
     } else if (action == "D2") {
-        ASTNode *dotParam2 = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *dot = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *dotParam1 = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *dotParam2 = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *dot = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *dotParam1 = semanticStack.back();
+        semanticStack.pop_back();
 
         dot->children.push_back(dotParam1);
         dot->children.push_back(dotParam2);
 
-        semanticStack.push(dot);
+        semanticStack.push_back(dot);
         return true;
     } else if (action == "F1") {
-        ASTNode *intlit = new IntlitNode(a->value);
-        semanticStack.push(intlit);
+        ASTNode *intlit = leaves.leaf(Intlit, a->value);
+        semanticStack.push_back(intlit);
         return true;
     } else if (action == "F2") {
         ASTNode *floatlit = new FloatlitNode(a->value);
-        semanticStack.push(floatlit);
+        semanticStack.push_back(floatlit);
         return true;
     } else if (action == "F3") {
         ASTNode *not_ = new NotNode("!");
-        semanticStack.push(not_);
+        semanticStack.push_back(not_);
         return true;
     } else if (action == "F4") {
-        ASTNode *factor = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *not_ = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *factor = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *not_ = semanticStack.back();
+        semanticStack.pop_back();
 
         not_->children.push_back(factor);
-        semanticStack.push(not_);
+        semanticStack.push_back(not_);
         return true;
     } else if (action == "F5") {
-        ASTNode *sign = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *factor = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *sign = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *factor = semanticStack.back();
+        semanticStack.pop_back();
 
         sign->children.push_back(factor);
-        semanticStack.push(sign);
+        semanticStack.push_back(sign);
         return true;
     } else if (action == "F7") {
         ASTNode *functionCall = new FunctionCallNode();
-        ASTNode *aparams = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *id = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *aparams = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *id = semanticStack.back();
+        semanticStack.pop_back();
 
         functionCall->children.push_back(id);
         functionCall->children.push_back(aparams);
-        semanticStack.push(functionCall);
+        semanticStack.push_back(functionCall);
         return true;
     } else if (action == "F8") {
         ASTNode *variable = new VariableNode();
-        ASTNode *indiceList = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *id = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *indiceList = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *id = semanticStack.back();
+        semanticStack.pop_back();
 
         variable->children.push_back(id);
         variable->children.push_back(indiceList);
 
-        semanticStack.push(variable);
+        semanticStack.push_back(variable);
         return true;
     } else if (action == "F10") {
         ASTNode *funcdecl = new FuncDeclNode();
-        ASTNode *rettype = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *fparamlist = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *id = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *rettype = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *fparamlist = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *id = semanticStack.back();
+        semanticStack.pop_back();
 
         funcdecl->children.push_back(id);
         funcdecl->children.push_back(fparamlist);
         funcdecl->children.push_back(rettype);
 
-        semanticStack.push(funcdecl);
+        semanticStack.push_back(funcdecl);
         return true;
     } else if (action == "F11") {
         ASTNode *fparam = new FParamNode();
-        ASTNode *arraysizelist = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *type = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *id = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *arraysizelist = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *type = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *id = semanticStack.back();
+        semanticStack.pop_back();
 
         fparam->children.push_back(id);
         fparam->children.push_back(type);
         fparam->children.push_back(arraysizelist);
 
-        semanticStack.push(fparam);
+        semanticStack.push_back(fparam);
         return true;
     } else if (action == "F12") {
-        std::vector<ASTNode*> children;
-        while (semanticStack.top()->type != Epsilon) {
-            children.push_back(semanticStack.top());
-            semanticStack.pop();
-        }
-
-        semanticStack.pop();
-        std::reverse(children.begin(), children.end());
-
-        ASTNode *fparamlist = new FParamListNode();
-        for (auto child : children) {
-            fparamlist->children.push_back(child);
-        }
-
-        semanticStack.push(fparamlist);
+        reduceList(semanticStack, new FParamListNode());
         return true;
     } else if (action == "F13") {
         ASTNode *funcdef = new FuncDefNode();
-        ASTNode *vardeclorstatblock = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *rettype = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *fparamlist = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *id = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *vardeclorstatblock = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *rettype = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *fparamlist = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *id = semanticStack.back();
+        semanticStack.pop_back();
 
         funcdef->children.push_back(id);
         funcdef->children.push_back(fparamlist);
         funcdef->children.push_back(rettype);
         funcdef->children.push_back(vardeclorstatblock);
 
-        semanticStack.push(funcdef);
+        semanticStack.push_back(funcdef);
         return true;
     } else if (action == "I1") {
-        ASTNode *id = new IdNode(a->value);
-        semanticStack.push(id);
+        ASTNode *id = leaves.leaf(Id, a->value);
+        semanticStack.push_back(id);
         return true;
     } else if (action == "I2") {
-        std::vector<ASTNode*> children;
-        while (semanticStack.top()->type != Epsilon) {
-            children.push_back(semanticStack.top());
-            semanticStack.pop();
-        }
-
-        semanticStack.pop();
-        std::reverse(children.begin(), children.end());
-
-        ASTNode *indiceList = new IndiceListNode();
-        for (auto child : children) {
-            indiceList->children.push_back(child);
-        }
-
-        semanticStack.push(indiceList);
+        reduceList(semanticStack, new IndiceListNode());
         return true;
     } else if (action == "I3") {
-        std::vector<ASTNode*> children;
-        while (semanticStack.top()->type != Epsilon) {
-            children.push_back(semanticStack.top());
-            semanticStack.pop();
-        }
-
-        semanticStack.pop();
-        std::reverse(children.begin(), children.end());
-
-        ASTNode *implFuncList = new ImplFuncListNode();
-        for (auto child : children) {
-            implFuncList->children.push_back(child);
-        }
-
-        semanticStack.push(implFuncList);
+        reduceList(semanticStack, new ImplFuncListNode());
         return true;
     } else if (action == "M1") {
         ASTNode *multop = new MultOpNode(a->value);
-        semanticStack.push(multop);
+        semanticStack.push_back(multop);
         return true;
     } else if (action == "M2") {
         ASTNode *member = new MemberNode();
-        ASTNode *memberdecl = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *visibility = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *memberdecl = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *visibility = semanticStack.back();
+        semanticStack.pop_back();
 
         member->children.push_back(visibility);
         member->children.push_back(memberdecl);
 
-        semanticStack.push(member);
+        semanticStack.push_back(member);
         return true;
     } else if (action == "P1") {
         ASTNode *structdecl = new StructDeclNode();
-        ASTNode *memberlist = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *inheritlist = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *id = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *memberlist = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *inheritlist = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *id = semanticStack.back();
+        semanticStack.pop_back();
 
         structdecl->children.push_back(id);
         structdecl->children.push_back(inheritlist);
         structdecl->children.push_back(memberlist);
 
-        semanticStack.push(structdecl);
+        semanticStack.push_back(structdecl);
         return true;
     } else if (action == "P2") {
         ASTNode *impldef = new ImplDefNode();
-        ASTNode *implfuncList = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *id = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *implfuncList = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *id = semanticStack.back();
+        semanticStack.pop_back();
 
         impldef->children.push_back(id);
         impldef->children.push_back(implfuncList);
 
-        semanticStack.push(impldef);
+        semanticStack.push_back(impldef);
         return true;
     } else if (action == "R1") {
-        ASTNode *relop = new RelOpNode(a->value);
-        semanticStack.push(relop);
+        ASTNode *relop = leaves.leaf(RelOp, a->value);
+        semanticStack.push_back(relop);
         return true;
     } else if (action == "R2") {
-        ASTNode *factor2 = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *multop = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *factor1 = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *factor2 = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *multop = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *factor1 = semanticStack.back();
+        semanticStack.pop_back();
 
         multop->children.push_back(factor1);
         multop->children.push_back(factor2);
 
-        semanticStack.push(multop);
+        semanticStack.push_back(multop);
         return true;
     } else if (action == "R3") {
         ASTNode *relexpr = new RelExprNode();
-        ASTNode *arithExpr2 = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *relop = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *arithExpr1 = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *arithExpr2 = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *relop = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *arithExpr1 = semanticStack.back();
+        semanticStack.pop_back();
 
         relexpr->children.push_back(arithExpr1);
         relexpr->children.push_back(relop);
         relexpr->children.push_back(arithExpr2);
 
-        semanticStack.push(relexpr);
+        semanticStack.push_back(relexpr);
         return true;
     } else if (action == "S1") {
         ASTNode *sign = new SignNode(a->value);
-        semanticStack.push(sign);
+        semanticStack.push_back(sign);
         return true;
     } else if (action == "S2") {
-        std::vector<ASTNode*> children;
-        while (semanticStack.top()->type != Epsilon) {
-            children.push_back(semanticStack.top());
-            semanticStack.pop();
-        }
-
-        semanticStack.pop();
-        std::reverse(children.begin(), children.end());
-
-        ASTNode *inheritlist = new InheritListNode();
-        for (auto child : children) {
-            inheritlist->children.push_back(child);
-        }
-
-        semanticStack.push(inheritlist);
+        reduceList(semanticStack, new InheritListNode());
         return true;
     } else if (action == "S3") {
-        std::vector<ASTNode*> children;
-        while (semanticStack.top()->type != Epsilon) {
-            children.push_back(semanticStack.top());
-            semanticStack.pop();
-        }
-
-        semanticStack.pop();
-        std::reverse(children.begin(), children.end());
-
-        ASTNode *memberlist = new MemberListNode();
-        for (auto child : children) {
-            memberlist->children.push_back(child);
-        }
-
-        semanticStack.push(memberlist);
+        reduceList(semanticStack, new MemberListNode());
         return true;
     } else if (action == "S10") {
         ASTNode *ifStat = new IfStatNode();
-        ASTNode *statblock2 = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *statblock1 = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *relexpr = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *statblock2 = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *statblock1 = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *relexpr = semanticStack.back();
+        semanticStack.pop_back();
 
         ifStat->children.push_back(relexpr);
         ifStat->children.push_back(statblock1);
         ifStat->children.push_back(statblock2);
 
-        semanticStack.push(ifStat);
+        semanticStack.push_back(ifStat);
         return true;
     } else if (action == "S11") {
         ASTNode *whileStat = new WhileStatNode();
-        ASTNode *statblock = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *relexpr = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *statblock = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *relexpr = semanticStack.back();
+        semanticStack.pop_back();
 
         whileStat->children.push_back(relexpr);
         whileStat->children.push_back(statblock);
 
-        semanticStack.push(whileStat);
+        semanticStack.push_back(whileStat);
         return true;
     } else if (action == "S12") {
         ASTNode *readStat = new ReadStatNode();
-        ASTNode *variable = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *variable = semanticStack.back();
+        semanticStack.pop_back();
 
         readStat->children.push_back(variable);
 
-        semanticStack.push(readStat);
+        semanticStack.push_back(readStat);
         return true;
     } else if (action == "S13") {
         ASTNode *writeStat = new WriteStatNode();
-        ASTNode *expression = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *expression = semanticStack.back();
+        semanticStack.pop_back();
 
         writeStat->children.push_back(expression);
 
-        semanticStack.push(writeStat);
+        semanticStack.push_back(writeStat);
         return true;
     } else if (action == "S14") {
         ASTNode *returnStat = new ReturnStatNode();
-        ASTNode *expression = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *expression = semanticStack.back();
+        semanticStack.pop_back();
 
         returnStat->children.push_back(expression);
 
-        semanticStack.push(returnStat);
+        semanticStack.push_back(returnStat);
         return true;
     } else if (action == "S15") {
         ASTNode *assignStat = new AssignStatNode();
-        ASTNode *expression = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *assignop = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *variable = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *expression = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *assignop = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *variable = semanticStack.back();
+        semanticStack.pop_back();
 
         assignStat->children.push_back(variable);
         assignStat->children.push_back(assignop);
         assignStat->children.push_back(expression);
 
-        semanticStack.push(assignStat);
+        semanticStack.push_back(assignStat);
         return true;
     } else if (action == "T1") {
-        ASTNode *type = new TypeNode(a->value);
-        semanticStack.push(type);
+        ASTNode *type = leaves.leaf(Type, a->value);
+        semanticStack.push_back(type);
         return true;
     } else if (action == "V1") {
-        ASTNode *visibility = new VisibilityNode(a->value);
-        semanticStack.push(visibility);
+        ASTNode *visibility = leaves.leaf(Visibility, a->value);
+        semanticStack.push_back(visibility);
         return true;
     } else if (action == "V2") {
         ASTNode *vardecl = new VarDeclNode();
-        ASTNode *arraysizelist = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *type = semanticStack.top();
-        semanticStack.pop();
-        ASTNode *id = semanticStack.top();
-        semanticStack.pop();
+        ASTNode *arraysizelist = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *type = semanticStack.back();
+        semanticStack.pop_back();
+        ASTNode *id = semanticStack.back();
+        semanticStack.pop_back();
 
         vardecl->children.push_back(id);
         vardecl->children.push_back(type);
         vardecl->children.push_back(arraysizelist);
 
-        semanticStack.push(vardecl);
+        semanticStack.push_back(vardecl);
         return true;
     } else if (action == "ZZ") {
-        std::vector<ASTNode*> children;
-
-        while (semanticStack.top()->type != Epsilon) {
-            children.push_back(semanticStack.top());
-            semanticStack.pop();
-        }
-
-        semanticStack.pop();
-        std::reverse(children.begin(), children.end());
-
-        ASTNode *prog = new ProgNode();
-        for (auto child : children) {
-            prog->children.push_back(child);
-        }
-
-        semanticStack.push(prog);
+        reduceList(semanticStack, new ProgNode());
         return true;
     }
 
@@ -775,10 +645,130 @@ void parseCSVIntoTT(const std::string& filePath, std::map<TableKey, ProductionRu
     TT[key2] = production2;
 }
 
-ASTNode *parse(Lexer lexer, std::map<TableKey, ProductionRule> &TT, std::ofstream &outfile, std::ofstream &errorfile, std::ofstream &astfile) {
+/*
+ * FIRST and FOLLOW sets derived from the productions stored in the parse table, so that error recovery always agrees
+ * with the grammar that was loaded. Semantic action symbols derive epsilon and are skipped.
+ * */
+void computeRecoverySets(const std::map<TableKey, ProductionRule>& TT, RecoverySets& sets) {
+    std::set<ProductionRule> productions;
+    std::set<std::string> nullableAtEOF;
+
+    for (const auto& entry : TT) {
+        if (!sets.nonTerminalIds.count(entry.first.first)) {
+            sets.nonTerminalIds[entry.first.first] = (int)sets.nonTerminalIds.size();
+        }
+
+        if (entry.first.second == "EOF") {
+            // REPTPROG0 may end at EOF
+            nullableAtEOF.insert(entry.first.first);
+        } else if (entry.second.size() >= 2 && entry.second[0] == entry.first.first) {
+            productions.insert(entry.second);
+        }
+    }
+
+    int n = (int)sets.nonTerminalIds.size();
+    sets.first.assign(n, TerminalSet());
+    sets.follow.assign(n, TerminalSet());
+    std::vector<bool> nullable(n, false);
+
+    for (const auto& name : nullableAtEOF) {
+        nullable[sets.nonTerminalIds[name]] = true;
+    }
+
+    // right-hand sides as symbol ids ; non-terminals are >= 0, terminals are encoded as -(tokenType + 1)
+    std::vector<std::pair<int, std::vector<int>>> rules;
+    for (const auto& production : productions) {
+        std::vector<int> rhs;
+        for (size_t i = 2; i < production.size(); i++) {
+            auto it = sets.nonTerminalIds.find(production[i]);
+            if (it != sets.nonTerminalIds.end()) {
+                rhs.push_back(it->second);
+            } else if (isTerminal(production[i])) {
+                int tokenType = terminalToTokenType(production[i]);
+                if (tokenType >= 0) {
+                    rhs.push_back(-(tokenType + 1));
+                }
+            }
+        }
+        rules.emplace_back(sets.nonTerminalIds.at(production[0]), rhs);
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& rule : rules) {
+            TerminalSet first = sets.first[rule.first];
+            bool allNullable = true;
+            for (int symbol : rule.second) {
+                if (symbol < 0) {
+                    first.set(-symbol - 1);
+                    allNullable = false;
+                    break;
+                }
+                first |= sets.first[symbol];
+                if (!nullable[symbol]) {
+                    allNullable = false;
+                    break;
+                }
+            }
+
+            if (first != sets.first[rule.first]) {
+                sets.first[rule.first] = first;
+                changed = true;
+            }
+            if (allNullable && !nullable[rule.first]) {
+                nullable[rule.first] = true;
+                changed = true;
+            }
+        }
+    }
+
+    auto start = sets.nonTerminalIds.find("START");
+    if (start != sets.nonTerminalIds.end()) {
+        sets.follow[start->second].set(TokenTypeEOF);
+    }
+
+    changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& rule : rules) {
+            // walk the right-hand side backwards carrying what can follow the current symbol
+            TerminalSet trailer = sets.follow[rule.first];
+            for (auto it = rule.second.rbegin(); it != rule.second.rend(); ++it) {
+                int symbol = *it;
+                if (symbol < 0) {
+                    trailer.reset();
+                    trailer.set(-symbol - 1);
+                    continue;
+                }
+
+                TerminalSet follow = sets.follow[symbol] | trailer;
+                if (follow != sets.follow[symbol]) {
+                    sets.follow[symbol] = follow;
+                    changed = true;
+                }
+
+                if (nullable[symbol]) {
+                    trailer |= sets.first[symbol];
+                } else {
+                    trailer = sets.first[symbol];
+                }
+            }
+        }
+    }
+}
+
+ASTNode *parse(Lexer lexer, std::map<TableKey, ProductionRule> &TT, std::ofstream &outfile, std::ofstream &errorfile, std::ofstream &astfile, ASTDumpFormat astFormat,
+              std::shared_ptr<LeafPool> leaves) {
     bool accepted = true;
+    if (leaves == nullptr) {
+        leaves = std::make_shared<LeafPool>();
+    }
     std::stack<std::string> parseStack;
-    std::stack<ASTNode*> semanticStack;
+    std::vector<ASTNode*> semanticStack;
+
+    RecoverySets sets;
+    computeRecoverySets(TT, sets);
 
     parseStack.emplace("$");
     parseStack.emplace("START");
@@ -789,7 +779,7 @@ ASTNode *parse(Lexer lexer, std::map<TableKey, ProductionRule> &TT, std::ofstrea
         printStack(parseStack, outfile);
         std::string x = parseStack.top();
 
-        if (callSemanticAction(semanticStack, x, prev)) {
+        if (callSemanticAction(semanticStack, x, prev, *leaves)) {
             parseStack.pop();
             continue;
         }
@@ -802,7 +792,7 @@ ASTNode *parse(Lexer lexer, std::map<TableKey, ProductionRule> &TT, std::ofstrea
 
                 errorfile << "ERROR - stack symbol " << x << "  has unexpected token: " << tokenTypeToString(a->type) << " " << a->value << " " << a->line << std::endl;
 
-                skipError(lexer, parseStack, a);
+                skipError(lexer, parseStack, a, sets);
                 accepted = false;
             }
         } else {
@@ -823,7 +813,7 @@ ASTNode *parse(Lexer lexer, std::map<TableKey, ProductionRule> &TT, std::ofstrea
             } else {
                 errorfile << "ERROR - stack symbol " << x << "  has unexpected token: " << tokenTypeToString(a->type) << " " << a->value << " " << a->line << std::endl;
 
-                skipError(lexer, parseStack, a);
+                skipError(lexer, parseStack, a, sets);
                 accepted = false;
             }
 
@@ -833,11 +823,13 @@ ASTNode *parse(Lexer lexer, std::map<TableKey, ProductionRule> &TT, std::ofstrea
     printStack(parseStack, outfile);
 
     // print AST
-    std::stack<ASTNode*> tempStack = semanticStack;
-    printAST(astfile, tempStack.top(), 0);
+    if (!semanticStack.empty()) {
+        dumpAST(astfile, semanticStack.back(), astFormat);
+    }
 
     if (accepted) {
-        return semanticStack.top();
+        static_cast<ProgNode*>(semanticStack.back())->leaves = leaves;
+        return semanticStack.back();
     } else {
         return nullptr;
     }
@@ -913,13 +905,34 @@ std::string tokenTypeToString(TokenType type) {
     }
 }
 
-void skipError(Lexer& lexer, std::stack<std::string>& parseStack, Token& lookahead) {
+int terminalToTokenType(const std::string& terminal) {
+    static std::unordered_map<std::string, int> tokenTypes;
+    if (tokenTypes.empty()) {
+        for (int type = 0; type <= TokenTypeEOF; type++) {
+            tokenTypes[tokenTypeToString((TokenType)type)] = type;
+        }
+        tokenTypes["$"] = TokenTypeEOF; // end of input is the EOF token
+    }
+
+    auto it = tokenTypes.find(terminal);
+    return it == tokenTypes.end() ? -1 : it->second;
+}
+
+void skipError(Lexer& lexer, std::stack<std::string>& parseStack, Token& lookahead, const RecoverySets& sets) {
     std::string x = parseStack.top();
-    if (FollowSets[x].find(tokenTypeToString(lookahead->type)) != FollowSets[x].end()) {
+
+    // terminals have no recovery sets
+    TerminalSet first, follow;
+    auto it = sets.nonTerminalIds.find(x);
+    if (it != sets.nonTerminalIds.end()) {
+        first = sets.first[it->second];
+        follow = sets.follow[it->second];
+    }
+
+    if (follow.test(lookahead->type)) {
         parseStack.pop();
     } else {
-        while (FirstSets[x].find(tokenTypeToString(lookahead->type)) == FirstSets[x].end()
-                && FollowSets[x].find(tokenTypeToString(lookahead->type)) == FollowSets[x].end()) {
+        while (!first.test(lookahead->type) && !follow.test(lookahead->type)) {
             if (x == "semi" || x == "$" || lookahead->type == TokenTypeEOF) {
                 parseStack.pop();
                 return;
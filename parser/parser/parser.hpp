@@ -6,6 +6,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
+#include <bitset>
 #include <fstream>
 #include <sstream>
 #include <ast.hpp>
@@ -14,8 +15,24 @@
 using ProductionRule = std::vector<std::string>;
 using TableKey = std::pair<std::string, std::string>;
 
-ASTNode *parse(Lexer lexer, std::map<TableKey, ProductionRule>& TT, std::ofstream& outfile, std::ofstream& errorfile, std::ofstream& astfile);
+/* error recovery ; terminals are indexed by their TokenType */
+using TerminalSet = std::bitset<TokenTypeEOF + 1>;
+
+struct RecoverySets {
+    std::unordered_map<std::string, int> nonTerminalIds;
+    std::vector<TerminalSet> first;
+    std::vector<TerminalSet> follow;
+};
+
+/* AST dump formats ; ASTDumpNone skips dumping entirely for production runs */
+enum ASTDumpFormat { ASTDumpNone, ASTDumpTree, ASTDumpSExpr, ASTDumpJSONLines };
+
+/* leaves: the pool the leaves of the tree are shared in, a new one if null ; the root returned keeps it alive */
+ASTNode *parse(Lexer lexer, std::map<TableKey, ProductionRule>& TT, std::ofstream& outfile, std::ofstream& errorfile, std::ofstream& astfile, ASTDumpFormat astFormat = ASTDumpTree,
+               std::shared_ptr<LeafPool> leaves = nullptr);
+void dumpAST(std::ostream& out, const ASTNode* root, ASTDumpFormat format);
 void parseCSVIntoTT(const std::string& filePath, std::map<TableKey, ProductionRule>& TT);
+void computeRecoverySets(const std::map<TableKey, ProductionRule>& TT, RecoverySets& sets);
 
 
 
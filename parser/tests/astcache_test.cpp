@@ -0,0 +1,201 @@
+#include<gtest/gtest.h>
+#include<astcache.hpp>
+
+/* the trees built by a test share the leaves of its pool */
+class ASTCache : public ::testing::Test {
+protected:
+    std::shared_ptr<LeafPool> leaves = std::make_shared<LeafPool>();
+
+    ASTNode *node(ASTNodeType type, const std::string &value, std::vector<ASTNode*> children = {}) {
+        ASTNode *n = makeASTNode(type, value, *leaves);
+        for (auto child : children) {
+            n->children.push_back(child);
+        }
+        if (type == Prog) {
+            static_cast<ProgNode*>(n)->leaves = leaves;
+        }
+        return n;
+    }
+
+    // func main() -> void { let x: integer; x = 1 + 2; write(x); }
+    ASTNode *sampleAST() {
+        return node(Prog, "", {
+            node(FuncDef, "", {
+                node(Id, "main"),
+                node(FParamList, ""),
+                node(Type, "void"),
+                node(VarDeclOrStatBlock, "", {
+                    node(VarDecl, "", {node(Id, "x"), node(Type, "integer"), node(ArraySizeList, "")}),
+                    node(AssignStat, "", {
+                        node(Variable, "", {node(Id, "x"), node(IndiceList, "")}),
+                        node(AssignOp, "="),
+                        node(AddOp, "+", {node(Intlit, "1"), node(Intlit, "2")}),
+                    }),
+                    node(WriteStat, "", {node(Variable, "", {node(Id, "x"), node(IndiceList, "")})}),
+                }),
+            }),
+        });
+    }
+};
+
+static void freeAST(ASTNode *root) {
+    if (root && !root->interned) {
+        delete root;
+    }
+}
+
+static void expectSameAST(const ASTNode *expected, const ASTNode *actual) {
+    ASSERT_NE(actual, nullptr);
+    ASSERT_EQ(actual->type, expected->type);
+    ASSERT_EQ(actual->value, expected->value);
+    ASSERT_EQ(actual->children.size(), expected->children.size());
+    for (size_t i = 0; i < expected->children.size(); i++) {
+        expectSameAST(expected->children[i], actual->children[i]);
+    }
+}
+
+/* magic, version, one empty string, then the nodes as given */
+static std::string entry(std::vector<uint64_t> varints) {
+    std::string out = "AST";
+    out.push_back(1);
+    out.push_back(1);
+    out.push_back(0);
+    for (uint64_t value : varints) {
+        while (value >= 0x80) {
+            out.push_back((char)((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back((char)value);
+    }
+    return out;
+}
+
+TEST_F(ASTCache, RoundTrip) {
+    ASTNode *root = sampleAST();
+    std::string buffer;
+    serializeAST(root, buffer);
+
+    ASTNode *copy = deserializeAST(buffer.data(), buffer.size());
+    expectSameAST(root, copy);
+
+    std::string again;
+    serializeAST(copy, again);
+    ASSERT_EQ(again, buffer);
+
+    freeAST(root);
+    freeAST(copy);
+}
+
+TEST_F(ASTCache, RoundTripSingleNode) {
+    ASTNode *root = node(Prog, "");
+    std::string buffer;
+    serializeAST(root, buffer);
+
+    ASTNode *copy = deserializeAST(buffer.data(), buffer.size());
+    expectSameAST(root, copy);
+
+    freeAST(root);
+    freeAST(copy);
+}
+
+TEST_F(ASTCache, TruncatedIsMiss) {
+    ASTNode *root = sampleAST();
+    std::string buffer;
+    serializeAST(root, buffer);
+    freeAST(root);
+
+    for (size_t length = 0; length < buffer.size(); length++) {
+        ASSERT_EQ(deserializeAST(buffer.data(), length), nullptr) << "length " << length;
+    }
+}
+
+TEST_F(ASTCache, TrailingBytesIsMiss) {
+    ASTNode *root = sampleAST();
+    std::string buffer;
+    serializeAST(root, buffer);
+    freeAST(root);
+
+    buffer.push_back(0);
+    ASSERT_EQ(deserializeAST(buffer.data(), buffer.size()), nullptr);
+}
+
+TEST_F(ASTCache, BadHeaderIsMiss) {
+    ASTNode *root = sampleAST();
+    std::string buffer;
+    serializeAST(root, buffer);
+    freeAST(root);
+
+    std::string magic = buffer;
+    magic[0] = 'X';
+    ASSERT_EQ(deserializeAST(magic.data(), magic.size()), nullptr);
+
+    std::string version = buffer;
+    version[3]++;
+    ASSERT_EQ(deserializeAST(version.data(), version.size()), nullptr);
+}
+
+TEST_F(ASTCache, LeavesAreShared) {
+    ASTNode *root = sampleAST();
+    ASTNode *body = root->children[0]->children[3];
+    ASSERT_EQ(body->children[0]->children[0], body->children[2]->children[0]->children[0]); // x
+    ASSERT_TRUE(body->children[0]->children[0]->interned);
+    ASSERT_FALSE(body->children[2]->children[0]->interned);
+
+    // a tree loaded into the pool of another one shares its leaves
+    std::string buffer;
+    serializeAST(root, buffer);
+    ASTNode *copy = deserializeAST(buffer.data(), buffer.size(), leaves);
+    ASSERT_EQ(copy->children[0]->children[0], root->children[0]->children[0]); // main
+    ASSERT_EQ(static_cast<ProgNode*>(copy)->leaves, leaves);
+
+    freeAST(root);
+    freeAST(copy);
+}
+
+TEST_F(ASTCache, RootMustBeProgram) {
+    std::string buffer = entry({1, Intlit, 0, 0});
+    ASSERT_EQ(deserializeAST(buffer.data(), buffer.size()), nullptr);
+}
+
+TEST_F(ASTCache, HugeChildCountIsMiss) {
+    std::string buffer = entry({1, Prog, 0, 1ULL << 60});
+    ASSERT_EQ(deserializeAST(buffer.data(), buffer.size()), nullptr);
+}
+
+TEST_F(ASTCache, MoreChildrenThanNodesIsMiss) {
+    std::string buffer = entry({2, Prog, 0, 2, Intlit, 0, 0});
+    ASSERT_EQ(deserializeAST(buffer.data(), buffer.size()), nullptr);
+}
+
+TEST_F(ASTCache, HugeNodeCountIsMiss) {
+    std::string buffer = entry({1ULL << 60, Prog, 0, 0});
+    ASSERT_EQ(deserializeAST(buffer.data(), buffer.size()), nullptr);
+}
+
+TEST_F(ASTCache, BadKindIsMiss) {
+    std::string buffer = entry({1, (uint64_t)VarDecl + 1, 0, 0});
+    ASSERT_EQ(deserializeAST(buffer.data(), buffer.size()), nullptr);
+}
+
+TEST_F(ASTCache, BadStringIdIsMiss) {
+    std::string buffer = entry({1, Prog, 1, 0});
+    ASSERT_EQ(deserializeAST(buffer.data(), buffer.size()), nullptr);
+}
+
+TEST_F(ASTCache, CorruptedByteNeverThrows) {
+    ASTNode *root = sampleAST();
+    std::string buffer;
+    serializeAST(root, buffer);
+    freeAST(root);
+
+    // whatever a corrupted entry decodes to, it is a tree or a miss
+    for (size_t i = 0; i < buffer.size(); i++) {
+        for (int byte : {0x00, 0x7F, 0x80, 0xFF}) {
+            std::string corrupted = buffer;
+            corrupted[i] = (char)byte;
+            ASTNode *copy = nullptr;
+            ASSERT_NO_THROW(copy = deserializeAST(corrupted.data(), corrupted.size())) << "byte " << i;
+            freeAST(copy);
+        }
+    }
+}
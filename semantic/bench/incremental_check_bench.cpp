@@ -0,0 +1,88 @@
+#include <incremental.hpp>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+/*
+ * Generates a program with many free functions, then times a fresh semantic analysis of it against an incremental one
+ * after the body of a single function is edited.
+ * usage: compiler_incremental_check_bench <grammar table csv> [functions] [iterations]
+ * */
+static std::string generateProgram(int functions, int edited) {
+    std::ostringstream src;
+    src << "struct POINT {\n"
+           "    public let x: integer;\n"
+           "    public let y: float;\n"
+           "};\n\n";
+    for (int f = 0; f < functions; f++) {
+        src << "func f" << f << "(n: integer) -> integer\n"
+               "{\n"
+               "    let p: POINT;\n"
+               "    let v: integer[8];\n"
+               "    let k: integer;\n"
+               "    k = " << (f == edited ? 1 : 0) << ";\n"
+               "    while (k < 8) {\n"
+               "      v[k] = p.x + n;\n"
+               "      k = k + 1;\n"
+               "    };\n"
+               "    return (k" << (f > 0 ? " + f" + std::to_string(f - 1) + "(n)" : "") << ");\n"
+               "}\n\n";
+    }
+    src << "func main() -> void\n{\n    let r: integer;\n    r = f0(3);\n    write(r);\n}\n";
+    return src.str();
+}
+
+static ASTNode *parseSource(const std::string &source, std::map<TableKey, ProductionRule> &TT, std::shared_ptr<LeafPool> leaves = nullptr) {
+    std::ofstream devnull("/dev/null");
+    Lexer lexer = lexerNew(source.c_str());
+    return parse(lexer, TT, devnull, devnull, devnull, ASTDumpTree, std::move(leaves));
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <grammar table csv> [functions] [iterations]" << std::endl;
+        return 1;
+    }
+
+    std::map<TableKey, ProductionRule> TT;
+    parseCSVIntoTT(argv[1], TT);
+    int functions = argc > 2 ? std::stoi(argv[2]) : 4000;
+    int iterations = argc > 3 ? std::stoi(argv[3]) : 5;
+    std::string original = generateProgram(functions, -1);
+    std::string edited = generateProgram(functions, functions / 2);
+
+    double freshMs = 0, incrementalMs = 0;
+    for (int i = 0; i < iterations; i++) {
+        std::ostringstream symfile, symerrors, log;
+        ASTNode *root = parseSource(edited, TT);
+        if (root == nullptr) {
+            std::cerr << "generated program did not parse" << std::endl;
+            return 1;
+        }
+        auto start = std::chrono::steady_clock::now();
+        semanticAnalysis(*root, symfile, symerrors);
+        freshMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        delete root;
+
+        // both versions share their leaves, as in a watch session
+        auto leaves = std::make_shared<LeafPool>();
+        IncrementalAnalysis session;
+        session.analyse(parseSource(original, TT, leaves), symfile, symerrors, log);
+        ASTNode *next = parseSource(edited, TT, leaves);
+        start = std::chrono::steady_clock::now();
+        bool accepted = session.analyse(next, symfile, symerrors, log);
+        incrementalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (!accepted) {
+            std::cerr << "generated program has semantic errors:" << std::endl << symerrors.str();
+            return 1;
+        }
+    }
+
+    freshMs /= iterations;
+    incrementalMs /= iterations;
+    std::cout << functions << " functions, one body edited: fresh " << freshMs << " ms, incremental " << incrementalMs
+              << " ms (x" << freshMs / incrementalMs << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <semantic.hpp>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+/*
+ * Generates a program with many free and member functions and times semantic analysis with 1, 2, 4, ... jobs.
+ * usage: compiler_parallel_check_bench <grammar table csv> [functions] [iterations] [max jobs]
+ * */
+static std::string generateProgram(int functions) {
+    std::ostringstream src;
+    src << "struct POINT {\n"
+           "    public let x: integer;\n"
+           "    public let y: float;\n";
+    for (int f = 0; f < functions / 2; f++) {
+        src << "    public func m" << f << "(a: integer, b: float) -> integer;\n";
+    }
+    src << "};\n\nimpl POINT {\n";
+    for (int f = 0; f < functions / 2; f++) {
+        src << "  func m" << f << "(a: integer, b: float) -> integer {\n"
+               "    let i: integer;\n"
+               "    let s: integer;\n"
+               "    i = 0;\n"
+               "    while (i < a) {\n"
+               "      s = s + i * x - a;\n"
+               "      i = i + 1;\n"
+               "    };\n"
+               "    y = b * 2.5;\n"
+               "    return (s);\n"
+               "  }\n";
+    }
+    src << "}\n\n";
+    for (int f = 0; f < functions - functions / 2; f++) {
+        src << "func f" << f << "(n: integer) -> integer\n"
+               "{\n"
+               "    let p: POINT;\n"
+               "    let v: integer[8];\n"
+               "    let k: integer;\n"
+               "    k = 0;\n"
+               "    while (k < 8) {\n"
+               "      v[k] = p.m" << f % (functions / 2 > 0 ? functions / 2 : 1) << "(k, 1.5) + n;\n"
+               "      k = k + 1;\n"
+               "    };\n"
+               "    if (n > 0) then {\n"
+               "      k = k - p.x;\n"
+               "    } else {\n"
+               "      write(k);\n"
+               "    };\n"
+               "    return (k);\n"
+               "}\n\n";
+    }
+    src << "func main() -> void\n{\n    let r: integer;\n    r = f0(3);\n    write(r);\n}\n";
+    return src.str();
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <grammar table csv> [functions] [iterations] [max jobs]" << std::endl;
+        return 1;
+    }
+
+    std::map<TableKey, ProductionRule> TT;
+    parseCSVIntoTT(argv[1], TT);
+    int functions = argc > 2 ? std::stoi(argv[2]) : 4000;
+    int iterations = argc > 3 ? std::stoi(argv[3]) : 5;
+    std::string source = generateProgram(functions);
+
+    unsigned maxJobs = argc > 4 ? (unsigned)std::stoi(argv[4]) : std::thread::hardware_concurrency();
+    if (maxJobs == 0) maxJobs = 1;
+
+    std::ofstream devnull("/dev/null");
+    double sequentialMs = 0;
+    for (unsigned jobs = 1; jobs <= maxJobs; jobs *= 2) {
+        double totalMs = 0;
+        for (int i = 0; i < iterations; i++) {
+            // analysis annotates the tree, so every run gets a fresh one
+            Lexer lexer = lexerNew(source.c_str());
+            ASTNode *root = parse(lexer, TT, devnull, devnull, devnull);
+            if (root == nullptr) {
+                std::cerr << "generated program did not parse" << std::endl;
+                return 1;
+            }
+
+            std::ostringstream symfile, symerrors;
+            auto start = std::chrono::steady_clock::now();
+            bool accepted = semanticAnalysis(*root, symfile, symerrors, jobs);
+            auto end = std::chrono::steady_clock::now();
+            totalMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+            if (!accepted) {
+                std::cerr << "generated program has semantic errors:" << std::endl << symerrors.str();
+                return 1;
+            }
+            delete root;
+            lexerFree(&lexer);
+        }
+
+        double ms = totalMs / iterations;
+        if (jobs == 1) sequentialMs = ms;
+        std::cout << functions << " functions, " << jobs << " job(s): " << ms << " ms (x" << sequentialMs / ms << ")" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+#ifndef COMPILER_DIAGNOSTICS_HPP
+#define COMPILER_DIAGNOSTICS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+enum class Severity : unsigned char { Warning, Error };
+
+/*
+ * Phases of semantic analysis, in the order their diagnostics are listed for a same location.
+ * */
+enum DiagnosticPhase : unsigned char { DECLARATIONS, BINDING, CHECKING, STRUCT_GRAPH };
+
+/*
+ * A diagnostic, as recorded: its code (e.g. 11.4), severity, where it was reported from and its message, kept as a
+ * slice of the engine's text arena.
+ * */
+struct Diagnostic {
+    const char *code;
+    Severity severity;
+    DiagnosticPhase phase;
+    uint32_t location;
+    uint32_t textBegin;
+    uint32_t textLength;
+};
+
+/*
+ * Diagnostics engine of semantic analysis.
+ * A report streams its message into a single text arena and records where it lies, so reporting allocates nothing
+ * per message and flushes nothing ; messages are only formatted as "code [severity] message" by flush, ordered by
+ * location, i.e. the top-level declaration being analysed, then by phase. Once errorLimit errors are reported (0 means
+ * no limit), further reports are discarded, warnings included, and limitReached tells the analysis to stop.
+ * */
+class Diagnostics {
+public:
+    explicit Diagnostics(size_t errorLimit = 0) : errorLimit(errorLimit), arenaBuffer(arena), messages(&arenaBuffer), discarded(nullptr) {}
+
+    Diagnostics(const Diagnostics&) = delete;
+    Diagnostics &operator=(const Diagnostics&) = delete;
+
+    /* the returned stream takes the message of the new diagnostic, without the code nor a trailing newline */
+    std::ostream &error(const char *code) {
+        return report(code, Severity::Error);
+    }
+
+    std::ostream &warning(const char *code) {
+        return report(code, Severity::Warning);
+    }
+
+    void setLocation(uint32_t location) {
+        currentLocation = location;
+    }
+
+    void setPhase(DiagnosticPhase phase) {
+        currentPhase = phase;
+    }
+
+    size_t errorCount() const {
+        return errors;
+    }
+
+    bool limitReached() const {
+        return errorLimit > 0 && errors >= errorLimit;
+    }
+
+    /* moves the diagnostics of another engine after these ones, e.g. those of a function analysed on another thread */
+    void append(Diagnostics &other) {
+        other.closeRecord();
+        closeRecord();
+        for (const auto &diagnostic : other.records) {
+            if (limitReached()) break;
+            if (diagnostic.severity == Severity::Error) errors++;
+            records.push_back(diagnostic);
+            records.back().textBegin += (uint32_t)arena.size();
+        }
+        arena += other.arena;
+        other.records.clear();
+        other.arena.clear();
+        other.errors = 0;
+    }
+
+    /* copies the diagnostics another engine reported at a location in a phase to the current location, e.g. those of a
+     * declaration whose analysis is reused from a previous run */
+    void replay(Diagnostics &other, uint32_t location, DiagnosticPhase phase) {
+        other.closeRecord();
+        closeRecord();
+        for (const auto &diagnostic : other.records) {
+            if (diagnostic.location != location || diagnostic.phase != phase) continue;
+            if (limitReached()) break;
+            if (diagnostic.severity == Severity::Error) errors++;
+            records.push_back(Diagnostic{diagnostic.code, diagnostic.severity, phase, currentLocation, (uint32_t)arena.size(), diagnostic.textLength});
+            arena.append(other.arena, diagnostic.textBegin, diagnostic.textLength);
+        }
+    }
+
+    void flush(std::ostream &out) {
+        closeRecord();
+        std::stable_sort(records.begin(), records.end(), [](const Diagnostic &a, const Diagnostic &b) {
+            return a.location != b.location ? a.location < b.location : a.phase < b.phase;
+        });
+
+        std::string text;
+        for (const auto &diagnostic : records) {
+            text.append(diagnostic.code);
+            text.append(diagnostic.severity == Severity::Error ? " [error] " : " [warning] ");
+            text.append(arena, diagnostic.textBegin, diagnostic.textLength);
+            text.push_back('\n');
+        }
+        if (limitReached()) {
+            text.append("[fatal] too many errors emitted, stopping now [-ferror-limit=" + std::to_string(errorLimit) + "]\n");
+        }
+        out << text;
+        out.flush();
+    }
+
+private:
+    /* streambuf appending to the arena */
+    class ArenaBuffer : public std::streambuf {
+    public:
+        explicit ArenaBuffer(std::string &arena) : arena(arena) {}
+
+    protected:
+        int_type overflow(int_type c) override {
+            if (c != traits_type::eof()) arena.push_back((char)c);
+            return c;
+        }
+
+        std::streamsize xsputn(const char *s, std::streamsize n) override {
+            arena.append(s, (size_t)n);
+            return n;
+        }
+
+    private:
+        std::string &arena;
+    };
+
+    size_t errorLimit;
+    size_t errors = 0;
+    uint32_t currentLocation = 0;
+    DiagnosticPhase currentPhase = DECLARATIONS;
+    bool recordOpen = false;
+    std::vector<Diagnostic> records;
+    std::string arena;
+    ArenaBuffer arenaBuffer;
+    std::ostream messages;
+    std::ostream discarded; // no buffer, so whatever is streamed into it is dropped
+
+    std::ostream &report(const char *code, Severity severity) {
+        closeRecord();
+        if (limitReached()) return discarded;
+        if (severity == Severity::Error) errors++;
+        records.push_back(Diagnostic{code, severity, currentPhase, currentLocation, (uint32_t)arena.size(), 0});
+        recordOpen = true;
+        return messages;
+    }
+
+    void closeRecord() {
+        if (recordOpen) {
+            records.back().textLength = (uint32_t)arena.size() - records.back().textBegin;
+            recordOpen = false;
+        }
+    }
+};
+
+#endif //COMPILER_DIAGNOSTICS_HPP
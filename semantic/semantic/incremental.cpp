@@ -0,0 +1,366 @@
+#include <incremental.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+static std::string foldName(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+static uint64_t combineHash(uint64_t hash, uint64_t part) {
+    return (hash ^ part) * 1099511628211ULL;
+}
+
+/*
+ * hash of the kinds, values and shape of a subtree, in pre-order ; uses, if given, gets the names the subtree depends
+ * on: the types it uses, the structs it inherits from and the functions it calls
+ * */
+static uint64_t scanSubtree(const ASTNode *node, std::set<std::string> *uses = nullptr) {
+    uint64_t hash = 14695981039346656037ULL;
+    std::vector<const ASTNode*> pending{node};
+    while (!pending.empty()) {
+        const ASTNode *current = pending.back();
+        pending.pop_back();
+
+        hash = combineHash(hash, current->type);
+        for (char c : current->value) {
+            hash = combineHash(hash, (unsigned char)c);
+        }
+        hash = combineHash(hash, current->children.size());
+
+        if (uses != nullptr) {
+            if (current->type == ASTNodeType::Type) {
+                uses->insert(foldName(current->value.substr(0, current->value.find('['))));
+            } else if (current->type == ASTNodeType::InheritList) {
+                for (auto child : current->children) {
+                    uses->insert(foldName(child->value));
+                }
+            } else if (current->type == ASTNodeType::FunctionCall) {
+                uses->insert(foldName(current->children[0]->value));
+            }
+        }
+
+        for (auto child = current->children.rbegin(); child != current->children.rend(); ++child) {
+            pending.push_back(*child);
+        }
+    }
+    return hash;
+}
+
+/* id, params and return type of a function definition */
+static uint64_t hashHeader(const ASTNode *funcDef) {
+    uint64_t hash = 0;
+    for (size_t i = 0; i < 3; i++) {
+        hash = combineHash(hash, scanSubtree(funcDef->children[i]));
+    }
+    return hash;
+}
+
+std::vector<IncrementalAnalysis::Unit> IncrementalAnalysis::describeUnits(const ASTNode &root) {
+    std::vector<Unit> described;
+    std::vector<std::set<std::string>> directUses;
+    std::unordered_map<std::string, std::set<std::string>> structUses;
+    std::unordered_map<std::string, int> ranks;
+
+    for (auto child : root.children) {
+        Unit unit;
+        unit.name = child->children[0]->value;
+        unit.declares = foldName(unit.name);
+        std::set<std::string> uses;
+        unit.hash = scanSubtree(child, &uses);
+        if (child->type == ASTNodeType::StructDecl) {
+            unit.kind = "struct";
+            unit.interfaceHash = unit.hash;
+            structUses[unit.declares].insert(uses.begin(), uses.end());
+        } else if (child->type == ASTNodeType::ImplDef) {
+            unit.kind = "impl";
+            unit.interfaceHash = scanSubtree(child->children[0]);
+            for (auto funcDef : child->children[1]->children) {
+                unit.interfaceHash = combineHash(unit.interfaceHash, hashHeader(funcDef));
+            }
+            // an impl is checked against its struct
+            uses.insert(unit.declares);
+        } else {
+            unit.kind = "func";
+            unit.interfaceHash = hashHeader(child);
+        }
+
+        std::string kindAndName = unit.kind + " " + unit.declares;
+        unit.key = kindAndName + "#" + std::to_string(ranks[kindAndName]++);
+        described.push_back(unit);
+        directUses.push_back(uses);
+    }
+
+    // a unit using a struct also depends on whatever the struct's declaration depends on
+    for (size_t i = 0; i < described.size(); i++) {
+        std::set<std::string> closed;
+        std::vector<std::string> pending(directUses[i].begin(), directUses[i].end());
+        while (!pending.empty()) {
+            std::string name = pending.back();
+            pending.pop_back();
+            if (!closed.insert(name).second) continue;
+            auto it = structUses.find(name);
+            if (it != structUses.end()) {
+                pending.insert(pending.end(), it->second.begin(), it->second.end());
+            }
+        }
+        described[i].uses.assign(closed.begin(), closed.end());
+    }
+    return described;
+}
+
+/*
+ * maps the function entries of a previous unit to those of the unit re-analysed in its place, headers unchanged, and
+ * collects the names of these functions
+ * */
+static void mapFunctionEntries(ASTNode *previous, ASTNode *next, std::unordered_map<SymbolTableEntry*, SymbolTableEntry*> &moved,
+                               std::unordered_set<std::string> &movedNames) {
+    if (previous->type == ASTNodeType::FuncDef) {
+        moved[previous->symbolTableEntry] = next->symbolTableEntry;
+        movedNames.insert(foldName(next->children[0]->value));
+    } else if (previous->type == ASTNodeType::ImplDef) {
+        const ASTChildren &previousFuncs = previous->children[1]->children;
+        const ASTChildren &nextFuncs = next->children[1]->children;
+        for (size_t i = 0; i < previousFuncs.size() && i < nextFuncs.size(); i++) {
+            moved[previousFuncs[i]->symbolTableEntry] = nextFuncs[i]->symbolTableEntry;
+            movedNames.insert(foldName(nextFuncs[i]->children[0]->value));
+        }
+    }
+}
+
+/* points the calls of a reused unit at the entries of the re-analysed functions they resolved to */
+static void retargetCalls(ASTNode *unit, const std::unordered_map<SymbolTableEntry*, SymbolTableEntry*> &moved) {
+    std::vector<ASTNode*> pending{unit};
+    while (!pending.empty()) {
+        ASTNode *current = pending.back();
+        pending.pop_back();
+
+        if (current->type == ASTNodeType::FunctionCall) {
+            auto *call = static_cast<FunctionCallNode*>(current);
+            auto it = moved.find(call->callee);
+            if (it != moved.end()) {
+                call->callee = it->second;
+            }
+        }
+        for (auto child : current->children) {
+            pending.push_back(child);
+        }
+    }
+}
+
+/* frees a scope, its entries and the scopes nested in it ; an impl bound into a struct scope belongs to its impl unit */
+static void freeScope(SymbolTable *table) {
+    for (auto *entry : table->symList) {
+        if (entry->kind == "impl") continue;
+        if (entry->link != nullptr && entry->link->upperScope == table) {
+            freeScope(entry->link);
+        }
+        delete entry;
+    }
+    delete table;
+}
+
+/* frees the entry a unit declared in the global scope and everything under it */
+static void freeDeclarations(ASTNode *unit) {
+    auto *entry = unit->symbolTableEntry;
+    if (entry == nullptr) return;
+    if (entry->link != nullptr) {
+        freeScope(entry->link);
+    }
+    delete entry;
+}
+
+IncrementalAnalysis::~IncrementalAnalysis() {
+    if (root != nullptr) {
+        for (auto *unit : root->children) {
+            freeDeclarations(unit);
+        }
+        delete root->symbolTable;
+    }
+    delete root;
+}
+
+/*
+ * The next version is analysed like semanticAnalysis does, unit by unit in source order, except that a reused unit
+ * is grafted from the previous tree in place of the new subtree: its entry joins the new global table, its tables are
+ * reparented there and its diagnostics are replayed at its new location.
+ * */
+bool IncrementalAnalysis::analyse(ASTNode *nextRoot, std::ostream &symfile, std::ostream &symerrors, std::ostream &log) {
+    std::vector<Unit> nextUnits = describeUnits(*nextRoot);
+
+    std::unordered_map<std::string, size_t> previousByKey;
+    for (size_t j = 0; j < units.size(); j++) {
+        previousByKey[units[j].key] = j;
+    }
+
+    // names whose declarations were added, removed or changed interface
+    std::unordered_set<std::string> changedNames;
+    std::vector<long> match(nextUnits.size(), -1);
+    std::vector<char> previousMatched(units.size(), 0);
+    for (size_t i = 0; i < nextUnits.size(); i++) {
+        auto it = previousByKey.find(nextUnits[i].key);
+        if (it != previousByKey.end()) {
+            match[i] = (long)it->second;
+            previousMatched[it->second] = 1;
+            if (units[it->second].interfaceHash == nextUnits[i].interfaceHash) continue;
+        }
+        changedNames.insert(nextUnits[i].declares);
+    }
+    for (size_t j = 0; j < units.size(); j++) {
+        if (!previousMatched[j]) {
+            changedNames.insert(units[j].declares);
+            log << std::left << std::setw(12) << "removed" << units[j].kind << " " << units[j].name << "\n";
+        }
+    }
+
+    // a reused subtree keeps its leaves, so it can only move to a tree sharing them
+    bool sameLeaves = root != nullptr && static_cast<ProgNode*>(root)->leaves == static_cast<ProgNode*>(nextRoot)->leaves;
+    std::vector<char> reused(nextUnits.size(), 0);
+    for (size_t i = 0; sameLeaves && i < nextUnits.size(); i++) {
+        const Unit &unit = nextUnits[i];
+        if (match[i] < 0 || units[match[i]].hash != unit.hash || changedNames.count(unit.declares)) continue;
+        reused[i] = std::none_of(unit.uses.begin(), unit.uses.end(), [&](const std::string &name) {
+            return changedNames.count(name) > 0;
+        });
+    }
+
+    std::unique_ptr<Diagnostics> nextDiags(new Diagnostics());
+    auto *globalTable = new SymbolTable("global", nullptr, 0);
+    nextRoot->symbolTable = globalTable;
+    std::unordered_set<SymbolTable*> reusedTables;
+    std::vector<char> previousReused(units.size(), 0);
+    std::vector<ASTNode*> discarded; // new subtrees of the reused units, freed once the results are out
+
+    nextDiags->setPhase(DECLARATIONS);
+    SymbolTableCreationVisitor declarer(*nextDiags, true);
+    for (size_t i = 0; i < nextRoot->children.size(); i++) {
+        nextDiags->setLocation(i);
+        if (!reused[i]) {
+            auto *child = nextRoot->children[i];
+            nextRoot->adopt(child);
+            declarer.accept = true;
+            child->accept(declarer);
+            nextUnits[i].accepted = declarer.accept;
+            continue;
+        }
+
+        auto *previous = root->children[match[i]];
+        previousReused[match[i]] = 1;
+        discarded.push_back(nextRoot->children[i]);
+        nextRoot->children[i] = previous;
+        previous->parent = nextRoot;
+
+        auto *entry = previous->symbolTableEntry;
+        globalTable->insert(entry);
+        entry->link->reparent(globalTable);
+        reusedTables.insert(entry->link);
+        if (previous->type == ASTNodeType::StructDecl) {
+            // impls are bound again below
+            for (auto *implEntry : entry->link->lookupAllOfKind("impl")) {
+                entry->link->remove(implEntry);
+            }
+        }
+
+        nextDiags->replay(*diags, match[i], DECLARATIONS);
+        nextUnits[i].accepted = units[match[i]].accepted;
+    }
+
+    nextDiags->setPhase(BINDING);
+    ImplToStructAddingVisitor binder(*nextDiags);
+    nextRoot->accept(binder);
+
+    // the hierarchy of a reused struct is unchanged, and reused units point into its flattened members
+    globalTable->indexOverloads();
+    for (auto *structEntry : globalTable->lookupAllOfKind("struct")) {
+        if (!reusedTables.count(structEntry->link)) {
+            structEntry->link->flattenInheritance();
+        }
+        structEntry->link->indexOverloads();
+    }
+
+    SemanticCheckingVisitor checker(*nextDiags);
+    auto scopeAndCheck = [&](ASTNode *funcDef) {
+        nextDiags->setPhase(DECLARATIONS);
+        declarer.visitFunctionBody(*funcDef);
+        nextDiags->setPhase(CHECKING);
+        funcDef->accept(checker);
+    };
+
+    for (size_t i = 0; i < nextRoot->children.size(); i++) {
+        auto *child = nextRoot->children[i];
+        nextDiags->setLocation(i);
+        if (reused[i]) {
+            nextDiags->replay(*diags, match[i], CHECKING);
+            continue;
+        }
+
+        declarer.accept = true;
+        checker.accept = true;
+        if (child->type == ASTNodeType::FuncDef) {
+            scopeAndCheck(child);
+        } else if (child->type == ASTNodeType::ImplDef) {
+            for (auto funcDef : child->children[1]->children) {
+                scopeAndCheck(funcDef);
+            }
+        } else {
+            nextDiags->setPhase(CHECKING);
+            child->accept(checker);
+        }
+        nextUnits[i].accepted = nextUnits[i].accepted && declarer.accept && checker.accept;
+    }
+
+    bool acyclic = checkStructGraph(*nextRoot, *nextDiags);
+
+    // reused calls to a function re-analysed with the same header resolve to its new entry
+    std::unordered_map<SymbolTableEntry*, SymbolTableEntry*> moved;
+    std::unordered_set<std::string> movedNames;
+    for (size_t i = 0; i < nextUnits.size(); i++) {
+        if (!reused[i] && match[i] >= 0 && units[match[i]].interfaceHash == nextUnits[i].interfaceHash) {
+            mapFunctionEntries(root->children[match[i]], nextRoot->children[i], moved, movedNames);
+        }
+    }
+    bool accept = binder.accept && acyclic;
+    size_t reanalysed = 0;
+    for (size_t i = 0; i < nextUnits.size(); i++) {
+        const Unit &unit = nextUnits[i];
+        if (reused[i] && std::any_of(unit.uses.begin(), unit.uses.end(), [&](const std::string &name) { return movedNames.count(name) > 0; })) {
+            retargetCalls(nextRoot->children[i], moved);
+        }
+        accept = accept && unit.accepted;
+        reanalysed += !reused[i];
+
+        const char *status = reused[i] ? "reused" : match[i] < 0 ? "added" : "re-analysed";
+        log << std::left << std::setw(12) << status << unit.kind << " " << unit.name << "\n";
+    }
+    log << reanalysed << " of " << nextUnits.size() << " declarations re-analysed\n";
+
+    nextDiags->flush(symerrors);
+    printSymbolTable(globalTable, 0, symfile);
+
+    // the previous tree gives up the subtrees grafted into the new one before it is freed, and its pool of leaves
+    // with it, so the subtrees it discards go first ; the tables of the units it discards and its global table, which
+    // only lists entries, go with them
+    if (root != nullptr) {
+        for (size_t j = 0; j < units.size(); j++) {
+            if (previousReused[j]) continue;
+            freeDeclarations(root->children[j]);
+            discarded.push_back(root->children[j]);
+        }
+        delete root->symbolTable;
+    }
+    for (auto *node : discarded) {
+        delete node;
+    }
+    if (root != nullptr) {
+        root->children.clear();
+        delete root;
+    }
+    root = nextRoot;
+    units = std::move(nextUnits);
+    diags = std::move(nextDiags);
+
+    return accept;
+}
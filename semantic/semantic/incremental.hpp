@@ -0,0 +1,59 @@
+#ifndef COMPILER_INCREMENTAL_HPP
+#define COMPILER_INCREMENTAL_HPP
+
+#include <semantic.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Semantic analysis of successive versions of a program, e.g. on every save in a watch mode, that only redoes what an
+ * edit invalidates.
+ * The units of analysis are the top-level declarations. Each one records the names it declares and the names it
+ * depends on: the struct types it uses, the structs it inherits from and the functions it calls, closed over the
+ * declarations of the structs it uses. A name is changed when a declaration of it is added, removed or has its
+ * interface edited (a function header, the headers of an impl, a whole struct). A unit is re-analysed when it is new,
+ * its text changed, or it declares or depends on a changed name ; every other unit keeps its symbol tables, its
+ * annotated subtree and the diagnostics it got in the previous run. Impl binding, inheritance flattening of the
+ * re-analysed structs and the struct cycle checks always run over the whole program.
+ * Units are only reused between versions parsed into the same LeafPool ; a version with leaves of its own is analysed
+ * whole. The output is the one semanticAnalysis gives for the same tree, with no error limit. Codegen lays out and adds
+ * temporaries to the tables it is given, so code must be generated from a fresh analysis rather than from a session.
+ * */
+class IncrementalAnalysis {
+public:
+    IncrementalAnalysis() = default;
+    ~IncrementalAnalysis();
+
+    IncrementalAnalysis(const IncrementalAnalysis&) = delete;
+    IncrementalAnalysis &operator=(const IncrementalAnalysis&) = delete;
+
+    /* analyses the next version of the program, taking ownership of its tree ; log gets one line per unit telling
+     * whether it was reused or re-analysed */
+    bool analyse(ASTNode *root, std::ostream &symfile, std::ostream &symerrors, std::ostream &log);
+
+    /* the annotated tree of the last version analysed, owned by the session */
+    ASTNode *tree() const {
+        return root;
+    }
+
+private:
+    struct Unit {
+        std::string kind;
+        std::string name;
+        std::string key; // kind, case-folded name and rank among the units of that kind and name
+        uint64_t hash;
+        uint64_t interfaceHash;
+        std::string declares; // case-folded
+        std::vector<std::string> uses; // case-folded
+        bool accepted = true;
+    };
+
+    ASTNode *root = nullptr;
+    std::vector<Unit> units;
+    std::unique_ptr<Diagnostics> diags;
+
+    static std::vector<Unit> describeUnits(const ASTNode &root);
+};
+
+#endif //COMPILER_INCREMENTAL_HPP
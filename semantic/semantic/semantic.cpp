@@ -1,10 +1,13 @@
 #include <semantic.hpp>
+#include <workpool.hpp>
+#include <atomic>
+#include <memory>
 #include <iomanip>
 
 /*
  * function to recursively print symbol tables in a nice format
  * */
-static void printSymbolTable(const SymbolTable* table, int indent = 0, std::ostream& out = std::cout) {
+void printSymbolTable(const SymbolTable* table, int indent, std::ostream& out) {
     const int maxWidth = 81;
     std::string indentStr;
     if (indent == 0)
@@ -50,53 +53,309 @@ static void printSymbolTable(const SymbolTable* table, int indent = 0, std::ostr
 }
 
 /*
- * function to start the cycle checking
+ * struct graph of the global scope ; edges to undeclared structs are left out, they are reported elsewhere
  * */
-bool detectCyclicStructDependency(const std::map<std::string, std::vector<std::string>> &graph, std::ostream &symerrors, bool isDependencyGraph) {
-    std::map<std::string, NodeState> state;
-    std::set<std::string> visited;
-    std::vector<std::string> currPath;
-
-    for (const auto &node : graph) {
-        if (state[node.first] == NOT_VISITED) {
-            if (hasCycle(node.first, graph, state, currPath, visited, symerrors, isDependencyGraph)) {
-                return true;
+StructGraph buildStructGraph(SymbolTable *globalTable) {
+    StructGraph graph;
+    std::unordered_map<SymbolTable*, int> ids;
+    for (auto *structEntry : globalTable->lookupAllOfKind("struct")) {
+        ids.emplace(structEntry->link, graph.structs.size());
+        graph.structs.push_back(structEntry->link);
+    }
+
+    auto idOf = [&](const std::string &name) {
+        auto *structEntry = globalTable->lookup(name, "struct");
+        return structEntry == nullptr ? -1 : ids.at(structEntry->link);
+    };
+
+    graph.inherits.resize(graph.structs.size());
+    graph.members.resize(graph.structs.size());
+    for (size_t id = 0; id < graph.structs.size(); id++) {
+        for (const auto &inheritName : graph.structs[id]->lookupAllNamesOfKind("inherit")) {
+            int inherited = idOf(inheritName);
+            if (inherited >= 0) graph.inherits[id].push_back(inherited);
+        }
+        for (auto *var : graph.structs[id]->lookupAllOfKind("var")) {
+            if (var->type == TypeId::errorType() || var->type.isBase()) continue;
+            int memberType = idOf(trimVariableType(var->type));
+            if (memberType >= 0) graph.members[id].push_back(memberType);
+        }
+    }
+    return graph;
+}
+
+/*
+ * Tarjan's algorithm with an explicit stack. Components come out in reverse topological order: a component is emitted
+ * after every component it has an edge to.
+ * */
+std::vector<std::vector<int>> stronglyConnectedComponents(const std::vector<std::vector<int>> &edges) {
+    const size_t n = edges.size();
+    std::vector<int> index(n, -1), lowlink(n, 0);
+    std::vector<char> onStack(n, 0);
+    std::vector<int> stack;
+    std::vector<std::pair<int, size_t>> callStack; // node, next edge to follow
+    std::vector<std::vector<int>> components;
+    int counter = 0;
+
+    auto open = [&](int node) {
+        index[node] = lowlink[node] = counter++;
+        stack.push_back(node);
+        onStack[node] = 1;
+        callStack.emplace_back(node, 0);
+    };
+
+    for (size_t root = 0; root < n; root++) {
+        if (index[root] >= 0) continue;
+        open((int)root);
+
+        while (!callStack.empty()) {
+            int node = callStack.back().first;
+            if (callStack.back().second < edges[node].size()) {
+                int succ = edges[node][callStack.back().second++];
+                if (index[succ] < 0) {
+                    open(succ);
+                } else if (onStack[succ]) {
+                    lowlink[node] = std::min(lowlink[node], index[succ]);
+                }
+                continue;
+            }
+
+            callStack.pop_back();
+            if (!callStack.empty()) {
+                int caller = callStack.back().first;
+                lowlink[caller] = std::min(lowlink[caller], lowlink[node]);
+            }
+
+            if (lowlink[node] == index[node]) {
+                components.emplace_back();
+                int member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[member] = 0;
+                    components.back().push_back(member);
+                } while (member != node);
+            }
+        }
+    }
+    return components;
+}
+
+/*
+ * reports every cycle of the inheritance or member dependency graph, one per strongly connected component, in
+ * declaration order of the first struct involved
+ * */
+bool detectCyclicStructDependency(const StructGraph &graph, Diagnostics &diags, bool isDependencyGraph) {
+    const auto &edges = isDependencyGraph ? graph.members : graph.inherits;
+    std::vector<std::vector<int>> components = stronglyConnectedComponents(edges);
+
+    std::vector<int> componentOf(edges.size());
+    for (size_t c = 0; c < components.size(); c++) {
+        for (int node : components[c]) componentOf[node] = (int)c;
+    }
+
+    std::vector<int> starts;
+    for (auto &component : components) {
+        int start = *std::min_element(component.begin(), component.end());
+        bool selfLoop = std::find(edges[start].begin(), edges[start].end(), start) != edges[start].end();
+        if (component.size() > 1 || selfLoop) {
+            starts.push_back(start);
+        }
+    }
+    std::sort(starts.begin(), starts.end());
+
+    // the shortest cycle through the first struct of each component, found breadth-first within the component
+    std::vector<int> previous(edges.size(), -1);
+    for (int start : starts) {
+        std::vector<int> queue = {start};
+        int last = -1;
+        for (size_t head = 0; head < queue.size() && last < 0; head++) {
+            int node = queue[head];
+            for (int succ : edges[node]) {
+                if (succ == start) {
+                    last = node;
+                    break;
+                }
+                if (componentOf[succ] == componentOf[start] && previous[succ] < 0) {
+                    previous[succ] = node;
+                    queue.push_back(succ);
+                }
             }
         }
+
+        std::vector<int> path;
+        for (int node = last; node != start; node = previous[node]) {
+            path.push_back(node);
+        }
+        path.push_back(start);
+
+        std::ostream &message = diags.error("14.1");
+        message << (isDependencyGraph ? "cyclic dependency involving: " : "cyclic inheritance involving: ");
+        for (auto node = path.rbegin(); node != path.rend(); ++node) {
+            message << graph.structs[*node]->name << " -> ";
+        }
+        message << graph.structs[start]->name;
     }
 
-    return false;
+    return !starts.empty();
 }
 
 /*
- * function to perform semantic analysis on the AST intermediate representation
+ * struct tables ordered so that every struct comes after the structs it inherits from or holds as members
  * */
-bool semanticAnalysis(ASTNode &root, std::ostream &symfile, std::ostream &symerrors) {
-    SymbolTableCreationVisitor visitor(symerrors);
-    root.accept(visitor);
+std::vector<SymbolTable*> structsInDependencyOrder(SymbolTable *globalTable) {
+    StructGraph graph = buildStructGraph(globalTable);
+    std::vector<std::vector<int>> edges = graph.inherits;
+    for (size_t id = 0; id < edges.size(); id++) {
+        edges[id].insert(edges[id].end(), graph.members[id].begin(), graph.members[id].end());
+    }
 
-    ImplToStructAddingVisitor visitor2(symerrors);
-    root.accept(visitor2);
+    std::vector<SymbolTable*> order;
+    for (const auto &component : stronglyConnectedComponents(edges)) {
+        for (int id : component) {
+            order.push_back(graph.structs[id]);
+        }
+    }
+    return order;
+}
+
+/*
+ * reports inheritance and member cycles between structs, after every declaration ; true if there is none
+ * */
+bool checkStructGraph(ASTNode &root, Diagnostics &diags) {
+    diags.setLocation(root.children.size());
+    diags.setPhase(STRUCT_GRAPH);
+    StructGraph structGraph = buildStructGraph(root.symbolTable);
+    bool hasCyclicInher = detectCyclicStructDependency(structGraph, diags, false);
+    bool hasCyclicDep = detectCyclicStructDependency(structGraph, diags, true);
+    return !hasCyclicInher && !hasCyclicDep;
+}
 
-    SemanticCheckingVisitor semanticChecker(symerrors);
-    root.accept(semanticChecker);
+/*
+ * Scopes the function bodies, then checks them and the other top-level declarations, on a pool of jobs threads.
+ * A body is scoped into its own table only. Checking starts once every body is scoped, since a check reads other
+ * functions' tables (params of a callee, overridden members) ; from then on the shared tables are only read.
+ * Each unit reports into its own diagnostics engine and the engines are appended in source order, so the output does
+ * not depend on scheduling. Once the error limit is reached, units not yet started are skipped.
+ * */
+static bool checkInParallel(ASTNode &root, unsigned jobs, Diagnostics &diags, size_t errorLimit) {
+    std::vector<ASTNode*> units;
+    std::vector<uint32_t> unitLocations;
+    for (size_t i = 0; i < root.children.size(); i++) {
+        auto *child = root.children[i];
+        if (child->type == ASTNodeType::ImplDef) {
+            for (auto funcDef : child->children[1]->children) {
+                units.push_back(funcDef);
+                unitLocations.push_back(i);
+            }
+        } else {
+            units.push_back(child);
+            unitLocations.push_back(i);
+        }
+    }
+
+    std::vector<std::unique_ptr<Diagnostics>> unitDiags;
+    for (size_t i = 0; i < units.size(); i++) {
+        unitDiags.emplace_back(new Diagnostics(errorLimit));
+        unitDiags[i]->setLocation(unitLocations[i]);
+    }
+    std::vector<char> unitAccepted(units.size(), 1);
+    std::atomic<size_t> errors(diags.errorCount());
+    auto limitReached = [&] { return errorLimit > 0 && errors.load() >= errorLimit; };
+    WorkStealingPool pool(jobs);
 
-    bool hasCyclicInher = detectCyclicStructDependency(visitor2.inheritanceGraph, symerrors, false);
-    bool hasCyclicDep = detectCyclicStructDependency(visitor2.dependencyGraph, symerrors, true);
+    pool.run(units.size(), [&](size_t i) {
+        if (units[i]->type != ASTNodeType::FuncDef || limitReached()) return;
+        unitDiags[i]->setPhase(DECLARATIONS);
+        SymbolTableCreationVisitor scoper(*unitDiags[i], true);
+        size_t before = unitDiags[i]->errorCount();
+        scoper.visitFunctionBody(*units[i]);
+        errors += unitDiags[i]->errorCount() - before;
+        unitAccepted[i] = scoper.accept;
+    });
 
-    printSymbolTable(root.symbolTable, 0, symfile);
+    pool.run(units.size(), [&](size_t i) {
+        if (limitReached()) {
+            unitAccepted[i] = 0;
+            return;
+        }
+        unitDiags[i]->setPhase(CHECKING);
+        SemanticCheckingVisitor checker(*unitDiags[i]);
+        size_t before = unitDiags[i]->errorCount();
+        units[i]->accept(checker);
+        errors += unitDiags[i]->errorCount() - before;
+        unitAccepted[i] = unitAccepted[i] && checker.accept;
+    });
 
-    return visitor.accept && visitor2.accept && semanticChecker.accept && !hasCyclicInher && !hasCyclicDep;
+    bool accept = true;
+    for (size_t i = 0; i < units.size(); i++) {
+        diags.append(*unitDiags[i]);
+        accept = accept && unitAccepted[i];
+    }
+    return accept;
 }
 
 /*
- * Removes the array size from a type or semantic type
- */
-std::string trimVariableType(const std::string& type) {
-    std::string trimmedType;
-    for (char c : type) {
-        if (c == '[') break;
-        trimmedType += c;
+ * function to perform semantic analysis on the AST intermediate representation
+ *
+ * Declarations are collected first over the top-level nodes only: struct members, impl and free function headers
+ * with their params, then impl binding and inheritance flattening. Each function body is then scoped and checked in
+ * one go while it is hot.
+ * With jobs > 1 the bodies are scoped, then checked, in parallel.
+ * Diagnostics are reported in source order of the top-level declarations, and for each declaration in phase order, as
+ * if each phase walked the whole tree. With an errorLimit, analysis stops once that many errors are reported.
+ * */
+bool semanticAnalysis(ASTNode &root, std::ostream &symfile, std::ostream &symerrors, unsigned jobs, size_t errorLimit) {
+    Diagnostics diags(errorLimit);
+
+    diags.setPhase(DECLARATIONS);
+    SymbolTableCreationVisitor visitor(diags, true);
+    root.accept(visitor);
+
+    diags.setPhase(BINDING);
+    ImplToStructAddingVisitor visitor2(diags);
+    root.accept(visitor2);
+
+    // from here on, members resolve across the whole inheritance hierarchy with one lookup, and calls by arity
+    root.symbolTable->indexOverloads();
+    for (auto *structEntry : root.symbolTable->lookupAllOfKind("struct")) {
+        structEntry->link->flattenInheritance();
+        structEntry->link->indexOverloads();
     }
-    return trimmedType;
+
+    bool checkingAccepted;
+    if (jobs > 1) {
+        checkingAccepted = checkInParallel(root, jobs, diags, errorLimit);
+    } else {
+        SemanticCheckingVisitor semanticChecker(diags);
+        auto scopeAndCheck = [&](ASTNode *funcDef) {
+            diags.setPhase(DECLARATIONS);
+            visitor.visitFunctionBody(*funcDef);
+            diags.setPhase(CHECKING);
+            funcDef->accept(semanticChecker);
+        };
+
+        for (size_t i = 0; i < root.children.size() && !diags.limitReached(); i++) {
+            auto *child = root.children[i];
+            diags.setLocation(i);
+            if (child->type == ASTNodeType::FuncDef) {
+                scopeAndCheck(child);
+            } else if (child->type == ASTNodeType::ImplDef) {
+                for (auto funcDef : child->children[1]->children) {
+                    scopeAndCheck(funcDef);
+                }
+            } else {
+                diags.setPhase(CHECKING);
+                child->accept(semanticChecker);
+            }
+        }
+        checkingAccepted = semanticChecker.accept && !diags.limitReached();
+    }
+
+    bool acyclic = checkStructGraph(root, diags);
+
+    diags.flush(symerrors);
+    printSymbolTable(root.symbolTable, 0, symfile);
+
+    return visitor.accept && visitor2.accept && checkingAccepted && acyclic;
 }
@@ -2,112 +2,208 @@
 #define COMPILER_SEMANTIC_HPP
 
 #include <parser.hpp>
+#include <diagnostics.hpp>
 #include <iostream>
 #include <map>
-#include <set>
 
 
-/* inheritance node state */
-enum NodeState {NOT_VISITED, VISITING, VISITED};
+/*
+ * Structs as integer ids in declaration order, with an edge from each struct to every struct it inherits from and to
+ * the struct type of every data member that has one.
+ * */
+struct StructGraph {
+    std::vector<SymbolTable*> structs;
+    std::vector<std::vector<int>> inherits;
+    std::vector<std::vector<int>> members;
+};
 
-bool semanticAnalysis(ASTNode &root, std::ostream &symfile, std::ostream &symerrors);
-bool detectCyclicStructDependency(const std::map<std::string, std::vector<std::string>> &graph, std::ostream &symerrors, bool isDependencyGraph);
-std::string trimVariableType(const std::string& type);
+bool semanticAnalysis(ASTNode &root, std::ostream &symfile, std::ostream &symerrors, unsigned jobs = 1, size_t errorLimit = 0);
+StructGraph buildStructGraph(SymbolTable *globalTable);
+std::vector<std::vector<int>> stronglyConnectedComponents(const std::vector<std::vector<int>> &edges);
+bool detectCyclicStructDependency(const StructGraph &graph, Diagnostics &diags, bool isDependencyGraph);
+std::vector<SymbolTable*> structsInDependencyOrder(SymbolTable *globalTable);
+bool checkStructGraph(ASTNode &root, Diagnostics &diags);
+void printSymbolTable(const SymbolTable *table, int indent = 0, std::ostream &out = std::cout);
 
 /*
- * function to check for cycles
- * */
-static bool hasCycle(const std::string &nodeName, const std::map<std::string, std::vector<std::string>> &graph,
-                     std::map<std::string, NodeState> &state, std::vector<std::string> &currPath,
-                     std::set<std::string> &visited, std::ostream &symerrors, bool isDependencyGraph) {
-    if (state[nodeName] == VISITING) {
-        if (isDependencyGraph) {
-            symerrors << "14.1 [error] cyclic dependency involving: ";
-        } else {
-            symerrors << "14.1 [error] cyclic inheritance involving: ";
-        }
-        for (const auto &node : currPath) {
-            symerrors << node << " -> ";
-        }
-        symerrors << nodeName << std::endl;
-        return true;
-    }
+ * Removes the array size from a type or semantic type
+ */
+static inline TypeId trimVariableType(TypeId type) {
+    return type.element();
+}
 
-    if (visited.find(nodeName) != visited.end()) {
-        return false;
-    }
+/*
+ * Returns the number of dimensions of in a type
+ */
+static inline int getNumDims(TypeId type) {
+    return type.numDims();
+}
 
-    state[nodeName] = VISITING;
-    currPath.push_back(nodeName);
+/*
+ * Checks if two variable types are equal in type and dimension size
+ * Input: two variable types or semantic types
+ */
+static inline bool areTwoVarsTypesEqual(TypeId a, TypeId b) {
+    return a.element() == b.element() && a.numDims() == b.numDims();
+}
 
-    bool isCycle = false;
+/*
+ * Outcome of resolving a call. match is the first overload, in declaration order, whose parameter types agree with
+ * the arguments. Failing that, nearest is the first one taking as many parameters, first is the first same-named
+ * function at all and candidates counts the same-named functions ; scope is where match or nearest was found.
+ * */
+struct CallResolution {
+    const Overload *match = nullptr;
+    const Overload *nearest = nullptr;
+    SymbolTableEntry *first = nullptr;
+    SymbolTable *scope = nullptr;
+    size_t candidates = 0;
+};
 
-    if (graph.find(nodeName) == graph.end()) {
-        state[nodeName] = VISITED;
-        visited.insert(nodeName);
-        currPath.pop_back();
-        return false;
+/*
+ * Resolves a call of name with aparams in table, the global table for free functions or a struct table for member
+ * functions, in which case the struct's ancestors are searched after it. Scopes must have their overloads indexed.
+ * */
+static CallResolution resolveCall(SymbolTable *table, const std::string &name, const ASTChildren &aparams) {
+    CallResolution resolution;
+    std::vector<SymbolTable*> scopes = {table};
+    scopes.insert(scopes.end(), table->ancestors.begin(), table->ancestors.end());
+
+    for (auto *scope : scopes) {
+        auto *sameName = scope->lookup(name, "func");
+        if (sameName == nullptr) continue;
+        if (resolution.first == nullptr) resolution.first = sameName;
+        resolution.candidates += scope->lookupAll(name, "func").size();
+
+        auto *overloads = scope->lookupOverloads(name, aparams.size());
+        if (overloads == nullptr) continue;
+        for (const auto &overload : *overloads) {
+            bool sameTypes = true;
+            for (size_t i = 0; i < aparams.size() && sameTypes; i++) {
+                sameTypes = areTwoVarsTypesEqual(aparams[i]->semanticType, overload.paramTypes[i]);
+            }
+            if (sameTypes) {
+                resolution.match = &overload;
+                resolution.scope = scope;
+                return resolution;
+            }
+        }
+        if (resolution.nearest == nullptr) {
+            resolution.nearest = &overloads->front();
+            resolution.scope = scope;
+        }
     }
+    return resolution;
+}
 
-    for (const auto &child : graph.at(nodeName)) {
-        if (hasCycle(child, graph, state, currPath, visited, symerrors, isDependencyGraph)) {
-            isCycle = true;
-            break;
+/*
+ * the first argument passed with the wrong number of dimensions for its parameter, -1 if there is none
+ * */
+static int firstDimsMismatch(const Overload &overload, const ASTChildren &aparams) {
+    for (size_t i = 0; i < aparams.size(); i++) {
+        if (!areTwoVarsTypesEqual(aparams[i]->semanticType, overload.paramTypes[i])
+            && getNumDims(aparams[i]->semanticType) != getNumDims(overload.paramTypes[i])) {
+            return (int)i;
         }
     }
-
-    state[nodeName] = VISITED;
-    visited.insert(nodeName);
-    currPath.pop_back();
-
-    return isCycle;
+    return -1;
 }
 
 /*
- * Returns the number of dimensions of in a type
- */
-static inline int getNumDims(const std::string &type) {
-    int numDims = 0;
-    for (char c : type) {
-        if (c == '[') {
-            numDims++;
-        }
+ * Looks up a variable used in a function: its locals and params, then for a member function the data members of its
+ * struct and of the struct's ancestors.
+ * */
+static SymbolTableEntry* lookupVarEntryFromFunctionScope(SymbolTable *functionScope, const std::string& lookup, Diagnostics &diags) {
+    auto *varEntry = functionScope->lookup(lookup, "var");
+    if (varEntry != nullptr) {
+        // found it in the function scope
+        return varEntry;
+    }
+
+    // first look if it's a param
+    varEntry = functionScope->lookup(lookup, "param");
+    if (varEntry != nullptr) {
+        return varEntry;
+    } else if (functionScope->level == 1) {
+        diags.error("11.1") << "undeclared variable in free function " << functionScope->name << "::" << lookup;
+        return nullptr;
+    }
+
+    // look in the struct table and its ancestors
+    auto *structTable = functionScope->enclosingStruct;
+    if (structTable == nullptr) {
+        // the impl of an undeclared struct, already reported
+        diags.error("11.2") << "undeclared variable (no inherited structs to look in)" << functionScope->upperScope->name << "::" << functionScope->name << "::" << lookup;
+        return nullptr;
+    }
+    auto *member = structTable->lookupMember(lookup);
+    if (member != nullptr) {
+        return member->entry;
+    }
+
+    if (!structTable->missingAncestors.empty()) {
+        diags.error("11.5") << "undeclared inherited struct " << structTable->missingAncestors.front();
+    } else if (!structTable->ancestors.empty()) {
+        diags.error("11.2") << "undeclared variable (not in inherited structs) " << structTable->name << "::" << functionScope->name << "::" << lookup;
+    } else {
+        // it's not that we didn't find it in the inherited structs, it's that there are no inherited structs
+        diags.error("11.2") << "undeclared variable (no inherited structs to look in)" << structTable->name << "::" << functionScope->name << "::" << lookup;
     }
-    return numDims;
+    return nullptr;
 }
 
 /*
- * Checks if two variable types are equal in type and dimension size
- * Input: two variable types or semantic types
- */
-static inline bool areTwoVarsTypesEqual(std::string &a, std::string &b) {
-    if (trimVariableType(a) != trimVariableType(b)) {
-        return false;
+ * Looks up a data member accessed through the . operator, inherited ones included
+ * */
+static MemberSlot *lookupMemberFromStructTable(SymbolTable *structTable, const std::string &lookup, Diagnostics &diags) {
+    auto *member = structTable->lookupMember(lookup);
+    if (member != nullptr) {
+        return member;
     }
 
-    int numDimsA = getNumDims(a);
-    int numDimsB = getNumDims(b);
+    if (!structTable->missingAncestors.empty()) {
+        diags.error("11.5") << "undeclared inherited struct " << structTable->missingAncestors.front();
+    } else if (!structTable->ancestors.empty()) {
+        diags.error("11.2") << "undeclared member (not in inherited structs) " << structTable->name << "::" << lookup;
+    } else {
+        // it's not that we didn't find it in the inherited structs, it's that there are no inherited structs
+        diags.error("11.2") << "undeclared data member (no inherited structs to look in)" << structTable->name << "::" << lookup;
+    }
+    return nullptr;
+}
+
+/*
+ * Semantic checking and type propagation for a bare id used as a variable in a function scope. The id is a shared
+ * leaf, so what it resolves to goes to the annotation of its occurrence.
+ * */
+static void variableCheck(const ASTNode &id, SymbolTable *functionScope, OperandAnnotation &occurrence, Diagnostics &diags, bool &accept) {
+    auto *varEntry = lookupVarEntryFromFunctionScope(functionScope, id.value, diags);
+    if (varEntry == nullptr) {
+        occurrence.semanticType = TypeId::errorType();
+        accept = false;
+        return;
+    }
 
-    return numDimsA == numDimsB;
+    occurrence.semanticType = varEntry->type;
+    if (occurrence.semanticType == TypeId::errorType()) {
+        accept = false;
+        return;
+    }
+    occurrence.symbolTableEntry = varEntry;
 }
 
 /*
- * Semantic checking and type propagation for a variable node (or id node used as a variable)
+ * Semantic checking and type propagation for a variable node
  * */
-static void variableCheck(ASTNode &node, std::ostream &symerrors, bool &accept) {
+static void variableCheck(ASTNode &node, Diagnostics &diags, bool &accept) {
     auto *functionScope = node.symbolTable;
 
-    std::string id;
-    if (node.type == 22) {
-        id = node.value;
-    } else {
-        id = node.children[0]->value;
-    }
+    std::string id = node.children[0]->value;
 
     // lookup the variable in the symbol table
-    auto *varEntry = functionScope->lookupVarEntryFromFunctionScope(id, symerrors);
+    auto *varEntry = lookupVarEntryFromFunctionScope(functionScope, id, diags);
     if (varEntry == nullptr) {
-        node.semanticType = "errortype";
+        node.semanticType = TypeId::errorType();
         accept = false;
         return;
     }
@@ -117,16 +213,11 @@ static void variableCheck(ASTNode &node, std::ostream &symerrors, bool &accept)
         node.symbolTableEntry = varEntry;
     }
 
-    if (node.semanticType == "errortype") {
+    if (node.semanticType == TypeId::errorType()) {
         accept = false;
         return;
     }
 
-    if (node.type == 22) {
-        node.symbolTableEntry = varEntry;
-        return;
-    }
-
     std::string indiceList;
     for (auto indice : node.children[1]->children) {
         indiceList += "[" + indice->value + "]";
@@ -140,32 +231,27 @@ static void variableCheck(ASTNode &node, std::ostream &symerrors, bool &accept)
     }
 
     if (node.children[1]->children.empty()) { // parent shouldn't be an aparamslist so this isn't a functioncall
-        if (node.semanticType.find('[') != std::string::npos && node.parent->type != 7) {
+        if (node.semanticType.isArray() && node.parent->type != 7) {
             if (varEntry->kind == "param") {
-                symerrors << "13.3 [error] array access " << id << indiceList << " on non-array parameter " << id << " with wrong number of dimensions, in " << scope << std::endl;
+                diags.error("13.3") << "array access " << id << indiceList << " on non-array parameter " << id << " with wrong number of dimensions, in " << scope;
             } else {
-                symerrors << "13.1 [error] array access " << id << indiceList << " on non-array variable " << id << " with wrong number of dimensions, in " << scope << std::endl;
+                diags.error("13.1") << "array access " << id << indiceList << " on non-array variable " << id << " with wrong number of dimensions, in " << scope;
             }
 
-            node.semanticType = "errortype";
+            node.semanticType = TypeId::errorType();
             accept = false;
         }
     } else {
         int numDims = (int)node.children[1]->children.size();
-        int numDimsInType = 0;
-        for (char c : node.semanticType) {
-            if (c == '[') {
-                numDimsInType++;
-            }
-        }
+        int numDimsInType = node.semanticType.numDims();
         if (numDims != numDimsInType) {
             if (varEntry->kind == "param") {
-                symerrors << "13.3 [error] use of array parameter with definition " << node.semanticType << " with wrong number of dimensions " << id << indiceList << " in " << scope << std::endl;
+                diags.error("13.3") << "use of array parameter with definition " << node.semanticType << " with wrong number of dimensions " << id << indiceList << " in " << scope;
             } else {
-                symerrors << "13.1 [error] use of array variable with definition " << node.semanticType << " with wrong number of dimensions " << id << indiceList << " in " << scope << std::endl;
+                diags.error("13.1") << "use of array variable with definition " << node.semanticType << " with wrong number of dimensions " << id << indiceList << " in " << scope;
             }
 
-            node.semanticType = "errortype";
+            node.semanticType = TypeId::errorType();
             accept = false;
         }
     }
@@ -175,14 +261,14 @@ static void variableCheck(ASTNode &node, std::ostream &symerrors, bool &accept)
 /*
  * Semantic checking of a member function declaration or a free function definition
  * */
-static void functionCheck(ASTNode &node, SymbolTableEntry *existingFuncEntry, std::string &funcType, std::string &funcName, std::ostream &symerrors, bool &accept) {
+static void functionCheck(ASTNode &node, SymbolTableEntry *existingFuncEntry, std::string &funcType, std::string &funcName, Diagnostics &diags, bool &accept) {
     // multiply declared
     if (existingFuncEntry != nullptr) {
         if (existingFuncEntry->type == funcType) {
             bool sameFParams = true;
             for (int i = 0; i < node.symbolTable->symList.size(); i++) {
                 if (node.symbolTable->symList[i]->kind != "param") continue;
-                if (node.symbolTable->symList[i]->type != existingFuncEntry->link->symList[i]->type) {
+                if (i >= existingFuncEntry->link->symList.size() || node.symbolTable->symList[i]->type != existingFuncEntry->link->symList[i]->type) {
                     sameFParams = false;
                     break;
                 }
@@ -190,21 +276,21 @@ static void functionCheck(ASTNode &node, SymbolTableEntry *existingFuncEntry, st
 
             if (sameFParams) {
                 if (node.symbolTable->upperScope->level == 0) {
-                    symerrors << "8.2 [error] multiply declared free function " << funcName << std::endl;
+                    diags.error("8.2") << "multiply declared free function " << funcName;
                 } else {
-                    symerrors << "8.3 [error] multiply declared member function " << funcName << std::endl;
+                    diags.error("8.3") << "multiply declared member function " << funcName;
                 }
 
-                node.semanticType = "errortype";
+                node.semanticType = TypeId::errorType();
                 accept = false;
                 return;
             }
         }
 
         if (node.symbolTable->upperScope->level == 0) {
-            symerrors << "9.1 [warning] overloaded free function " << funcName << std::endl;
+            diags.warning("9.1") << "overloaded free function " << funcName;
         } else {
-            symerrors << "9.2 [warning] overloaded member function " << node.symbolTable->upperScope->name  << "::" << funcName << std::endl;
+            diags.warning("9.2") << "overloaded member function " << node.symbolTable->upperScope->name  << "::" << funcName;
         }
     }
 }
@@ -213,7 +299,7 @@ static void functionCheck(ASTNode &node, SymbolTableEntry *existingFuncEntry, st
  * Semantic checking of a variable declaration in a struct member list or member function implementation
  * for shadowing of inherited variables
  * */
-static void inheritanceVariableDeclCheck(ASTNode &node, SymbolTable *structTable, SymbolTable *globalTable, std::ostream &symerrors, bool isLocal, std::string &currentScopeName) {
+static void inheritanceVariableDeclCheck(ASTNode &node, SymbolTable *structTable, SymbolTable *globalTable, Diagnostics &diags, bool isLocal, std::string &currentScopeName) {
     // check for shadowing of inherited variables
     std::vector<std::string> inheritNames = structTable->lookupAllNamesOfKind("inherit");
     if (!inheritNames.empty()) {
@@ -225,13 +311,13 @@ static void inheritanceVariableDeclCheck(ASTNode &node, SymbolTable *structTable
             auto *matchingInheritedVarEntry = inheritedStructTable->lookup(node.children[0]->value, "var");
             if (matchingInheritedVarEntry != nullptr) {
                 if (isLocal) {
-                    symerrors << "8.6 [warning] local variable " << structTable->name << "::" << currentScopeName << "::" << node.children[0]->value
+                    diags.warning("8.6") << "local variable " << structTable->name << "::" << currentScopeName << "::" << node.children[0]->value
                               << " shadows inherited variable " << inheritedStructTable->name << "::"
-                              << node.children[0]->value << std::endl;
+                              << node.children[0]->value;
                 } else {
-                    symerrors << "8.5 [warning] member variable " << structTable->name << "::" << node.children[0]->value
+                    diags.warning("8.5") << "member variable " << structTable->name << "::" << node.children[0]->value
                               << " shadows inherited variable " << inheritedStructTable->name << "::"
-                              << node.children[0]->value << std::endl;
+                              << node.children[0]->value;
                 }
 
             }
@@ -244,15 +330,16 @@ static void inheritanceVariableDeclCheck(ASTNode &node, SymbolTable *structTable
  * Semantic check for a member variable access in a dot node.
  * Assumption: dotParam1 is a valid struct
  * */
-static bool memberVariableCheck(ASTNode *dotParam1, ASTNode *dotParam2, SymbolTable *functionScope, std::ostream &symerrors) {
-    auto *globalScope = functionScope->upperScope;
-    while (globalScope->level != 0) {
-        globalScope = globalScope->upperScope;
-    }
+static bool memberVariableCheck(DotNode &dot, Diagnostics &diags) {
+    auto *dotParam2 = dot.children[1];
+    auto *functionScope = dot.symbolTable;
+    auto *globalScope = functionScope->global;
 
-    auto *structEntry = globalScope->lookup(dotParam1->semanticType, "struct");
+    TypeId &memberType = dot.operandType(1);
+
+    auto *structEntry = globalScope->lookup(dot.operandType(0), "struct");
     if (structEntry == nullptr) {
-        dotParam2->semanticType = "PROGRAM_ERROR";
+        memberType = "PROGRAM_ERROR";
         return false;
     }
 
@@ -265,14 +352,14 @@ static bool memberVariableCheck(ASTNode *dotParam1, ASTNode *dotParam2, SymbolTa
         id = dotParam2->children[0]->value;
     }
 
-    auto *memberEntry = structTable->lookupMemberEntryFromStructTable(id, symerrors);
-    if (memberEntry == nullptr) {
-        dotParam2->semanticType = "errortype";
+    dot.member = lookupMemberFromStructTable(structTable, id, diags);
+    if (dot.member == nullptr) {
+        memberType = TypeId::errorType();
         return false;
     }
 
-    dotParam2->semanticType = memberEntry->type;
-    if (dotParam2->semanticType == "errortype") {
+    memberType = dot.member->entry->type;
+    if (memberType == TypeId::errorType()) {
         return false;
     }
 
@@ -293,22 +380,17 @@ static bool memberVariableCheck(ASTNode *dotParam1, ASTNode *dotParam2, SymbolTa
     bool accepted = true;
 
     if (dotParam2->children[1]->children.empty()) {
-        if (dotParam2->semanticType.find('[') != std::string::npos) {
-            symerrors << "13.2 [error] array access " << id << indiceList << " on non-array member variable " << id << " with wrong number of dimensions, in " << scope << std::endl;
-            dotParam2->semanticType = "errortype";
+        if (memberType.isArray()) {
+            diags.error("13.2") << "array access " << id << indiceList << " on non-array member variable " << id << " with wrong number of dimensions, in " << scope;
+            memberType = TypeId::errorType();
             accepted = false;
         }
     } else {
         int numDims = (int)dotParam2->children[1]->children.size();
-        int numDimsInType = 0;
-        for (char c : dotParam2->semanticType) {
-            if (c == '[') {
-                numDimsInType++;
-            }
-        }
+        int numDimsInType = memberType.numDims();
         if (numDims != numDimsInType) {
-            symerrors << "13.2 [error] use of array member variable with definition " << dotParam2->semanticType << " with wrong number of dimensions " << id << indiceList << " in " << scope << std::endl;
-            dotParam2->semanticType = "errortype";
+            diags.error("13.2") << "use of array member variable with definition " << memberType << " with wrong number of dimensions " << id << indiceList << " in " << scope;
+            memberType = TypeId::errorType();
             accepted = false;
         }
     }
@@ -321,22 +403,33 @@ static bool memberVariableCheck(ASTNode *dotParam1, ASTNode *dotParam2, SymbolTa
 /*
  * Visitor to generate symbol tables for the AST intermediate representation.
  * Also checks for semantic errors such as multiply defined variables, functions, etc.
+ * With deferFunctionBodies, function definitions only get their entry, table and params ; the body (locals and
+ * statements) is scoped later by visitFunctionBody.
  * */
 class SymbolTableCreationVisitor : public ASTNodeVisitor {
 public:
-    std::ostream &symerrors;
+    Diagnostics &diags;
     bool accept;
+    bool deferFunctionBodies;
 
-    explicit SymbolTableCreationVisitor(std::ostream &symerrors) : symerrors(symerrors), accept(true) {}
+    explicit SymbolTableCreationVisitor(Diagnostics &diags, bool deferFunctionBodies = false)
+        : diags(diags), accept(true), deferFunctionBodies(deferFunctionBodies) {}
+
+    void visitFunctionBody(ASTNode &funcDef) {
+        funcDef.children[3]->accept(*this);
+    }
 
     void visit(ProgNode& node) override {
         node.symbolTable = new SymbolTable("global", nullptr, 0);
         // propagate accepting the same visitor to all children
         // this is a depth-first traversal
-        for (auto child : node.children) {
-            child->parent = &node;
-            // set the symbol table of the child to the symbol table of the parent
-            child->symbolTable = node.symbolTable;
+        for (size_t i = 0; i < node.children.size(); i++) {
+            auto *child = node.children[i];
+            // the child gets the symbol table of the parent
+            node.adopt(child);
+            // diagnostics are located at the top-level declaration they come from
+            diags.setLocation(i);
+            if (diags.limitReached()) continue;
             child->accept(*this);
         }
     }
@@ -351,26 +444,25 @@ public:
 
         auto *existingEntry = node.symbolTable->lookup(structName, "struct");
         if (existingEntry != nullptr) {
-            symerrors << "8.1 [error] multiply defined struct " << structName << std::endl;
+            diags.error("8.1") << "multiply defined struct " << structName;
             accept = false;
         }
 
         auto *structTable = new SymbolTable(structName, node.symbolTable, node.symbolTable->level + 1);
+        structTable->enclosingStruct = structTable;
         node.symbolTableEntry = new StructEntry(structName, structName, structTable);
         node.symbolTable->insert(node.symbolTableEntry);
         node.symbolTable = structTable;
 
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(IdNode& node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
@@ -383,16 +475,14 @@ public:
             auto *inheritEntry = new SymbolTableEntry(child->value, "inherit", child->value, nullptr);
             node.symbolTable->insert(inheritEntry);
 
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(MemberListNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
@@ -406,8 +496,7 @@ public:
         auto visibility = node.children[0]->value;
 
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
 
@@ -416,8 +505,7 @@ public:
 
     void visit(VisibilityNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
@@ -440,18 +528,16 @@ public:
         node.symbolTable = funcTable;
 
         for (auto child: node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
 
-        functionCheck(node, existingFuncEntry, funcType, funcName, symerrors, accept);
+        functionCheck(node, existingFuncEntry, funcType, funcName, diags, accept);
     }
 
     void visit(FParamListNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
@@ -473,9 +559,9 @@ public:
         auto *existingParamEntry = node.symbolTable->lookup(paramName, "param");
         if (existingParamEntry != nullptr) {
             if (node.symbolTable->level == 1) {
-                symerrors << "8.4 [error] multiply defined parameter in a free function " << node.symbolTable->name << "::" << paramName << std::endl;
+                diags.error("8.4") << "multiply defined parameter in a free function " << node.symbolTable->name << "::" << paramName;
             } else {
-                symerrors << "8.4 [error] multiply defined parameter in a member function " << node.parent->symbolTable->name << "::" << node.symbolTable->name << "::" << paramName << std::endl;
+                diags.error("8.4") << "multiply defined parameter in a member function " << node.parent->symbolTable->name << "::" << node.symbolTable->name << "::" << paramName;
             }
             accept = false;
         }
@@ -485,32 +571,28 @@ public:
         node.symbolTable->insert(paramEntry);
 
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(TypeNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(ArraySizeListNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(IntlitNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
@@ -533,13 +615,13 @@ public:
         if (existingVarEntry != nullptr) {
             if (node.parent->type == 10) { // VarDeclOrStatBlock
                 if (node.symbolTable->level == 1) {
-                    symerrors << "8.4 [error] multiply defined local variable in a free function " << node.symbolTable->name << "::" << varName << std::endl;
+                    diags.error("8.4") << "multiply defined local variable in a free function " << node.symbolTable->name << "::" << varName;
                 } else {
-                    symerrors << "8.4 [error] multiply defined local variable in a member function " << node.parent->parent->parent->symbolTable->name << "::" << node.symbolTable->name << "::" << varName << std::endl;
+                    diags.error("8.4") << "multiply defined local variable in a member function " << node.parent->parent->parent->symbolTable->name << "::" << node.symbolTable->name << "::" << varName;
                 }
 
             } else {
-                symerrors << "8.3 [error] multiply defined member variable " << node.symbolTable->name << "::" << varName << std::endl;
+                diags.error("8.3") << "multiply defined member variable " << node.symbolTable->name << "::" << varName;
             }
             accept = false;
         }
@@ -547,11 +629,11 @@ public:
         auto *existingParamEntry = node.symbolTable->lookup(varName, "param");
         if (existingParamEntry != nullptr) {
             if (node.symbolTable->level == 1) {
-                symerrors << "8.4 [error] multiply defined identifier in a free function: "
-                          << node.symbolTable->name << "::" << varName << " is a param and a variable" << std::endl;
+                diags.error("8.4") << "multiply defined identifier in a free function: "
+                          << node.symbolTable->name << "::" << varName << " is a param and a variable";
             } else {
-                symerrors << "8.4 [error] multiply defined identifier in a member function "
-                          << node.parent->parent->parent->symbolTable->name << "::" << node.symbolTable->name << "::" << varName << " is a param and a variable " << std::endl;
+                diags.error("8.4") << "multiply defined identifier in a member function "
+                          << node.parent->parent->parent->symbolTable->name << "::" << node.symbolTable->name << "::" << varName << " is a param and a variable ";
             }
             accept = false;
         }
@@ -561,8 +643,7 @@ public:
         node.symbolTable->insert(node.symbolTableEntry);
 
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
@@ -586,18 +667,17 @@ public:
         node.symbolTable = funcTable;
 
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
+            if (deferFunctionBodies && child == node.children[3]) continue;
             child->accept(*this);
         }
 
-        functionCheck(node, existingFuncEntry, funcType, funcName, symerrors, accept);
+        functionCheck(node, existingFuncEntry, funcType, funcName, diags, accept);
     }
 
     void visit(VarDeclOrStatBlockNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
@@ -605,88 +685,77 @@ public:
 
     void visit(IfStatNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(RelExprNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(RelOpNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(AddOpNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(MultOpNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(DotNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(IndiceListNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(AParamsListNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(FloatlitNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(NotNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(SignNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
 
@@ -694,72 +763,63 @@ public:
 
     void visit(StatBlockNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(WhileStatNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(ReadStatNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(WriteStatNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(ReturnStatNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(AssignStatNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(AssignOpNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(FunctionCallNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(VariableNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
 
@@ -767,8 +827,7 @@ public:
 
     void visit(EpsilonNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
@@ -781,21 +840,20 @@ public:
 
         std::string implName = node.children[0]->value;
         auto *implTable = new SymbolTable(implName, node.symbolTable, node.symbolTable->level + 1);
+        implTable->enclosingImpl = implTable;
         node.symbolTableEntry = new ImplEntry(implName, implName, implTable);
         node.symbolTable->insert(node.symbolTableEntry);
         node.symbolTable = implTable;
 
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
 
     void visit(ImplFuncListNode &node) override {
         for (auto child : node.children) {
-            child->parent = &node;
-            child->symbolTable = node.symbolTable;
+            node.adopt(child);
             child->accept(*this);
         }
     }
@@ -804,20 +862,18 @@ public:
 /*
  * Visitor to add the implementation functions to the struct symbol table. This is done after the symbol table creation
  * to allow for forward referencing.
- * Also builds the inheritance graph for the struct symbol tables and the dependency graphs for the struct members.
+ * Only top-level declarations matter here, so it never descends into function definitions.
  * */
 class ImplToStructAddingVisitor : public ASTNodeVisitor {
 public:
-    std::ostream &symerrors;
-    std::map<std::string, std::vector<std::string>> inheritanceGraph;
-    std::map<std::string, std::vector<std::string>> dependencyGraph;
+    Diagnostics &diags;
     bool accept;
 
-    explicit ImplToStructAddingVisitor(std::ostream &symerrors) : symerrors(symerrors), accept(true) {}
+    explicit ImplToStructAddingVisitor(Diagnostics &diags) : diags(diags), accept(true) {}
 
     void visit(ImplDefNode &node) override {
         std::string implName = node.children[0]->value;
-        auto *globalTable = node.symbolTable->upperScope;
+        auto *globalTable = node.symbolTable->global;
         auto *implEntry = globalTable->lookup(implName, "impl");
         auto *structEntry = globalTable->lookup(implName, "struct");
 
@@ -826,14 +882,14 @@ public:
         }
 
         if (structEntry == nullptr) {
-            symerrors << "6.3 [error] undeclared struct definition " << implName << std::endl;
+            diags.error("6.3") << "undeclared struct definition " << implName;
             accept = false;
             return;
         }
 
         globalTable->remove(implEntry);
-        structEntry->link->symList.emplace_back(implEntry);
-        implEntry->link->upperScope = structEntry->link;
+        structEntry->link->insert(implEntry);
+        implEntry->link->reparent(structEntry->link);
         node.symbolTable = structEntry->link;
 
         for (auto child : node.children) {
@@ -842,16 +898,14 @@ public:
     }
 
     void visit(ImplFuncListNode &node) override {
-        auto *structTable = node.symbolTable->upperScope;
+        auto *structTable = node.symbolTable->enclosingStruct;
 
         for (auto child : node.children) {
             auto *funcEntry = structTable->lookup(child->children[0]->value, "func");
             if (funcEntry == nullptr) {
-                symerrors << "6.1 [error] definition provided for undeclared member function " << node.parent->children[0]->value << "::" << child->children[0]->value << std::endl;
+                diags.error("6.1") << "definition provided for undeclared member function " << node.parent->children[0]->value << "::" << child->children[0]->value;
                 accept = false;
             }
-
-            child->accept(*this);
         }
     }
 
@@ -859,22 +913,6 @@ public:
         for (auto child : node.children) {
             child->accept(*this);
         }
-
-        // for circular inheritance check
-        std::string structName = node.children[0]->value;
-        std::vector<std::string> inheritNames = node.symbolTable->lookupAllNamesOfKind("inherit");
-        inheritanceGraph[structName] = inheritNames;
-
-        // for circular dependency check
-        std::vector<std::string> dependencies;
-
-        std::vector<SymbolTableEntry*> varMembers = node.symbolTable->lookupAllOfKind("var");
-        for (auto var : varMembers) {
-            if (var->type == "errortype" || var->type == "integer" || var->type == "float") continue;
-            dependencies.emplace_back(trimVariableType(var->type));
-        }
-
-        dependencyGraph[structName] = dependencies;
     }
 
     void visit(MemberNode &node) override {
@@ -890,8 +928,9 @@ public:
     }
 
     void visit(ProgNode &node) override {
-        for (auto child : node.children) {
-            child->accept(*this);
+        for (size_t i = 0; i < node.children.size() && !diags.limitReached(); i++) {
+            diags.setLocation(i);
+            node.children[i]->accept(*this);
         }
     }
 
@@ -956,9 +995,7 @@ public:
     }
 
     void visit(FuncDefNode &node) override {
-        for (auto child : node.children) {
-            child->accept(*this);
-        }
+        // function bodies hold no declarations the binding needs
     }
 
     void visit(VarDeclOrStatBlockNode &node) override {
@@ -1104,10 +1141,10 @@ public:
  * */
 class SemanticCheckingVisitor : public ASTNodeVisitor {
 public:
-    std::ostream &symerrors;
+    Diagnostics &diags;
     bool accept;
 
-    explicit SemanticCheckingVisitor(std::ostream &symerrors) : symerrors(symerrors), accept(true) {}
+    explicit SemanticCheckingVisitor(Diagnostics &diags) : diags(diags), accept(true) {}
 
     void visit(FuncDeclNode &node) override {
         auto *structTable = node.parent->symbolTable;
@@ -1116,14 +1153,14 @@ public:
         auto *funcEntry =  implEntry->link->lookup(node.children[0]->value, "func");
 
         if (funcEntry == nullptr) {
-            symerrors << "6.2 [error] undefined member function declaration "
-                      << node.parent->parent->children[0]->value << "::" << node.children[0]->value << std::endl;
+            diags.error("6.2") << "undefined member function declaration "
+                      << node.parent->parent->children[0]->value << "::" << node.children[0]->value;
             accept = false;
         } else {
             // check for override
             std::vector<std::string> inheritNames = structTable->lookupAllNamesOfKind("inherit");
             if (!inheritNames.empty()) {
-                auto *globalTable = structTable->upperScope;
+                auto *globalTable = structTable->global;
 
                 for (const auto &inheritName: inheritNames) {
                     // look for the struct in the global table
@@ -1146,10 +1183,10 @@ public:
                             }
 
                             if (sameFParams) {
-                                symerrors << "9.3 [warning] member function "
+                                diags.warning("9.3") << "member function "
                                           << structTable->name << "::" << funcEntry->name
                                           << " overrides inherited function "
-                                          << inheritedStructTable->name << "::" << matchingFuncEntry->name << std::endl;
+                                          << inheritedStructTable->name << "::" << matchingFuncEntry->name;
                             }
                         }
                     }
@@ -1166,34 +1203,30 @@ public:
     void visit(VarDeclNode &node) override {
         // check if class is declared, doesn't matter the current scope we're in
         auto *currentScope = node.symbolTable;
-        auto *globalTable = currentScope;
-        while (globalTable->level != 0) {
-            globalTable = globalTable->upperScope;
-        }
+        auto *globalTable = currentScope->global;
 
         if (node.children[1]->value != "integer" && node.children[1]->value != "float") {
             auto *structEntry = globalTable->lookup(trimVariableType(node.children[1]->value), "struct");
             if (structEntry == nullptr) {
-                symerrors << "11.5 [error] undeclared struct " << node.children[1]->value << " in " << currentScope->name << std::endl;
+                diags.error("11.5") << "undeclared struct " << node.children[1]->value << " in " << currentScope->name;
                 accept = false;
                 return;
             }
         }
 
-        if (node.parent->type == 10 && node.symbolTable->level != 1) {
-            auto *implTable = currentScope->upperScope;
-            auto *structTable = implTable->upperScope;
+        if (node.parent->type == 10 && node.symbolTable->level != 1 && currentScope->enclosingStruct != nullptr) {
+            auto *structTable = currentScope->enclosingStruct;
             auto *matchingVarEntry = structTable->lookup(node.children[0]->value, "var");
             if (matchingVarEntry != nullptr) {
-                symerrors << "8.6 [warning] local variable " << structTable->name << "::" << currentScope->name << "::" << node.children[0]->value
-                          << " shadows member variable " << structTable->name << "::" << node.children[0]->value << std::endl;
+                diags.warning("8.6") << "local variable " << structTable->name << "::" << currentScope->name << "::" << node.children[0]->value
+                          << " shadows member variable " << structTable->name << "::" << node.children[0]->value;
                 accept = false;
             }
 
-            inheritanceVariableDeclCheck(node, structTable, globalTable, symerrors, true, currentScope->name);
+            inheritanceVariableDeclCheck(node, structTable, globalTable, diags, true, currentScope->name);
 
         } else if (node.parent->type == 26) { // Member
-            inheritanceVariableDeclCheck(node, currentScope, globalTable, symerrors, false, currentScope->name);
+            inheritanceVariableDeclCheck(node, currentScope, globalTable, diags, false, currentScope->name);
         }
 
         for (auto child : node.children) {
@@ -1208,7 +1241,7 @@ public:
 
         if (node.parent->type == 12) return; // dot node, perform the check in the dot node visit method
 
-        variableCheck(node, symerrors, accept);
+        variableCheck(node, diags, accept);
     }
 
     void visit(IndiceListNode &node) override {
@@ -1218,8 +1251,8 @@ public:
 
         // all children should be integer
         for (auto child : node.children) {
-            if (child->semanticType != "integer") {
-                symerrors << "13.2 [error] array index " << child->value << " is not an integer at " << node.symbolTable->name << "::" << node.parent->children[0]->value << std::endl;
+            if (child->semanticType != TypeId::integerType()) {
+                diags.error("13.2") << "array index " << child->value << " is not an integer at " << node.symbolTable->name << "::" << node.parent->children[0]->value;
                 accept = false;
             }
         }
@@ -1234,130 +1267,56 @@ public:
         if (node.parent->type != 12) {
             // lookup the function in the symbol table
             auto *functionScope = node.symbolTable;
-            // of course we can call the free function from anywhere so we have to go to global scope
-            auto *globalTable = functionScope->upperScope;
-            while (globalTable->level != 0) {
-                globalTable = globalTable->upperScope;
-            }
-
-            std::vector<SymbolTableEntry*> matchingFuncEntries = globalTable->lookupAll(node.children[0]->value, "func");
-            // look for the function with the right number of parameters
-            if (matchingFuncEntries.empty()) {
-                symerrors << "11.4 [error] undeclared/undefined free function " << node.children[0]->value << std::endl;
-                node.semanticType = "errortype";
-                accept = false;
+            // of course we can call the free function from anywhere so we look in the global scope
+            auto *globalTable = functionScope->global;
+
+            const ASTChildren &aparams = node.children[1]->children;
+            CallResolution resolution = resolveCall(globalTable, node.children[0]->value, aparams);
+            if (resolution.match != nullptr) {
+                node.callee = resolution.match->entry;
+                node.semanticType = node.callee->type;
                 return;
             }
 
-            std::vector<ASTNode*> aparams = node.children[1]->children;
-            if (matchingFuncEntries.size() == 1) {
-                // if the number of matching functions is 1, then we can confidently say that the function call was made with incorrect number of parameters or types
-                // which is why I separate this case from multiple matching functions
-                auto *funcEntry = matchingFuncEntries[0];
-                auto *funcTable = funcEntry->link;
-                std::vector<SymbolTableEntry*> fparams = funcTable->lookupAllOfKind("param");
-                if (aparams.size() != fparams.size()) {
-                    std::string aparamList;
-                    for (auto aparam : aparams) {
-                        aparamList += aparam->semanticType + " ";
-                    }
-
-                    symerrors << "12.1 [error] free function call with wrong number of parameters in " << functionScope->name << ". Params: ( " << aparamList << ")"
-                              << ", call of " << globalTable->name << "::" << funcEntry->name << std::endl;
-                    node.semanticType = "errortype";
-                    accept = false;
-                    return;
-                }
-
-                bool error = false;
-                std::vector<std::pair<std::string, std::string>> incorrectParamPairs;
-                for (int i = 0; i < aparams.size(); i++) {
-                    if (!areTwoVarsTypesEqual(aparams[i]->semanticType, fparams[i]->type)) {
-                        error = true;
-                        incorrectParamPairs.emplace_back(aparams[i]->semanticType, fparams[i]->type);
-                    }
-                }
-
-                if (error) {
-                    std::string aparamList;
-                    for (auto aparam : aparams) {
-                        aparamList += aparam->semanticType + " ";
-                    }
-
-                    for (const auto& pair : incorrectParamPairs) {
-                        if (getNumDims(pair.first) != getNumDims(pair.second)) {
-                            symerrors << "13.3 [error] array parameter (in free function call) using wrong number of dimensions in " << functionScope->name << ". Expected: " << pair.second << ", got: " << pair.first
-                                      << ", call of " << globalTable->name << "::" << funcEntry->name << std::endl;
-                            node.semanticType = "errortype";
-                            accept = false;
-                            return;
-                        }
-                    }
-
-                    symerrors << "12.2 [error] free function call with wrong type of parameters in " << functionScope->name << ". Params: ( " << aparamList << ")"
-                              << ", call of " << globalTable->name << "::" << funcEntry->name << std::endl;
-                    node.semanticType = "errortype";
-                    accept = false;
-                    return;
-                }
-
-                node.semanticType = funcEntry->type;
+            node.semanticType = TypeId::errorType();
+            accept = false;
+            if (resolution.candidates == 0) {
+                diags.error("11.4") << "undeclared/undefined free function " << node.children[0]->value;
                 return;
             }
 
-            node.semanticType = "errortype";
-            for (auto *funcEntry : matchingFuncEntries) {
-               auto *funcTable = funcEntry->link;
-                std::vector<SymbolTableEntry*> fparams = funcTable->lookupAllOfKind("param");
-                if (aparams.size() != fparams.size()) {
-                    continue;
-                }
-
-                bool error = false;
-                std::vector<std::pair<std::string, std::string>> incorrectParamPairs;
-                for (int i = 0; i < aparams.size(); i++) {
-                    if (!areTwoVarsTypesEqual(aparams[i]->semanticType, fparams[i]->type)) {
-                        error = true;
-                        incorrectParamPairs.emplace_back(aparams[i]->semanticType, fparams[i]->type);
-                    }
-                }
-
-                if (error) {
-                    std::string aparamString;
-                    for (auto aparam : aparams) {
-                        aparamString += aparam->semanticType + " ";
-                    }
-
-                    for (const auto& pair : incorrectParamPairs) {
-                        if (getNumDims(pair.first) != getNumDims(pair.second)) {
-                            symerrors << "13.3 [error] array parameter (in free function call) using wrong number of dimensions in " << functionScope->name << ". Expected: " << pair.second << ", got: " << pair.first
-                                      << ", call of " << globalTable->name << "::" << funcEntry->name << std::endl;
-                            accept = false;
-                            return;
-                        }
-                    }
+            std::string aparamList;
+            for (auto aparam : aparams) {
+                aparamList += aparam->semanticType.str() + " ";
+            }
 
-                    symerrors << "12.2 [error] There are overloaded free functions with name " << node.children[0]->value <<
-                              ", there exists a matching function with number of parameters but wrong types of parameters. "
-                              "Params: ( " << aparamString << ") call of " << globalTable->name << "::" << node.children[0]->value << std::endl;
-                    accept = false;
-                    return;
+            if (resolution.nearest == nullptr) {
+                if (resolution.candidates == 1) {
+                    // with a single function of that name, the call was made with the wrong number of parameters
+                    diags.error("12.1") << "free function call with wrong number of parameters in " << functionScope->name << ". Params: ( " << aparamList << ")"
+                              << ", call of " << globalTable->name << "::" << resolution.first->name;
+                } else {
+                    // there is no function with name and good parameters, so I give the generic error message
+                    diags.error("(12.1 OR 12.2)") << "There are overloaded free functions with name " << node.children[0]->value <<
+                                 ", there exists no matching function with the right number and types of parameters "
+                                 "Params: ( " << aparamList << ") call of " << globalTable->name << "::" << node.children[0]->value;
                 }
-
-                node.semanticType = funcEntry->type;
                 return;
             }
 
-            // there is no function with name and good parameters
-            // so I give the generic error message
-            std::string aparamString;
-            for (auto aparam : aparams) {
-                aparamString += aparam->semanticType + " ";
+            auto *funcEntry = resolution.nearest->entry;
+            int mismatch = firstDimsMismatch(*resolution.nearest, aparams);
+            if (mismatch >= 0) {
+                diags.error("13.3") << "array parameter (in free function call) using wrong number of dimensions in " << functionScope->name << ". Expected: " << resolution.nearest->paramTypes[mismatch] << ", got: " << aparams[mismatch]->semanticType
+                          << ", call of " << globalTable->name << "::" << funcEntry->name;
+            } else if (resolution.candidates == 1) {
+                diags.error("12.2") << "free function call with wrong type of parameters in " << functionScope->name << ". Params: ( " << aparamList << ")"
+                          << ", call of " << globalTable->name << "::" << funcEntry->name;
+            } else {
+                diags.error("12.2") << "There are overloaded free functions with name " << node.children[0]->value <<
+                          ", there exists a matching function with number of parameters but wrong types of parameters. "
+                          "Params: ( " << aparamList << ") call of " << globalTable->name << "::" << node.children[0]->value;
             }
-            symerrors << "(12.1 OR 12.2) [error] There are overloaded free functions with name " << node.children[0]->value <<
-                         ", there exists no matching function with the right number and types of parameters "
-                         "Params: ( " << aparamString << ") call of " << globalTable->name << "::" << node.children[0]->value << std::endl;
-            accept = false;
         }
     }
 
@@ -1368,37 +1327,37 @@ public:
 
         auto *dotParam1 = node.children[0];
         auto *dotParam2 = node.children[1]; // member function call or member variable access
+        TypeId &objectType = node.operandType(0);
 
-        if (dotParam1->semanticType == "errortype") {
-            symerrors << "15.1 [error] . operator used on non-struct type " << dotParam1->value << std::endl;
-            node.semanticType = "errortype";
+        if (objectType == TypeId::errorType()) {
+            diags.error("15.1") << ". operator used on non-struct type " << dotParam1->value;
+            node.semanticType = TypeId::errorType();
             accept = false;
             return;
         }
 
-        if (dotParam1->type == 22 || dotParam1->type == 18) {
-            variableCheck(*dotParam1, symerrors, accept);
+        if (dotParam1->type == 22) {
+            variableCheck(*dotParam1, node.symbolTable, node.operands[0], diags, accept);
+        } else if (dotParam1->type == 18) {
+            variableCheck(*dotParam1, diags, accept);
         }
 
-        if (dotParam1->semanticType == "errortype") {
-            node.semanticType = "errortype";
+        if (objectType == TypeId::errorType()) {
+            node.semanticType = TypeId::errorType();
             accept = false;
             return;
-        } else if (dotParam1->semanticType == "integer" || dotParam1->semanticType == "float") {
-            symerrors << "15.1 [error] . operator used on non-struct " << dotParam1->value << " of type " << dotParam1->semanticType << std::endl;
-            node.semanticType = "errortype";
+        } else if (objectType.isBase()) {
+            diags.error("15.1") << ". operator used on non-struct " << dotParam1->value << " of type " << objectType;
+            node.semanticType = TypeId::errorType();
             accept = false;
             return;
         } else if (dotParam1->type != 12) {
             auto *functionScope = node.symbolTable;
-            auto *globalTable = functionScope->upperScope;
-            while (globalTable->level != 0) {
-                globalTable = globalTable->upperScope;
-            }
-            auto *structEntry = globalTable->lookup(dotParam1->semanticType, "struct");
+            auto *globalTable = functionScope->global;
+            auto *structEntry = globalTable->lookup(objectType, "struct");
             if (structEntry == nullptr) {
-                symerrors << "15.1 [error] . operator used on non-struct " << dotParam1->value << " of type " << dotParam1->semanticType << std::endl;
-                node.semanticType = "errortype";
+                diags.error("15.1") << ". operator used on non-struct " << dotParam1->value << " of type " << objectType;
+                node.semanticType = TypeId::errorType();
                 accept = false;
                 return;
             }
@@ -1407,188 +1366,67 @@ public:
         // the result will be the result of the second parameter
         if (dotParam2->type == 22 || dotParam2->type == 18) {
             // id or variable
-            memberVariableCheck(dotParam1, dotParam2, node.symbolTable, symerrors);
-            if (dotParam2->semanticType == "errortype") {
-                node.semanticType = "errortype";
+            memberVariableCheck(node, diags);
+            if (node.operandType(1) == TypeId::errorType()) {
+                node.semanticType = TypeId::errorType();
                 accept = false;
                 return;
             }
-            node.semanticType = dotParam2->semanticType;
+            node.semanticType = node.operandType(1);
         } else if (dotParam2->type == 17) {
-                // is a member function call
-                std::vector<ASTNode*> aparams = dotParam2->children[1]->children;
-                std::string aparamList;
-                for (auto aparam : aparams) {
-                    aparamList += aparam->semanticType + " ";
-                }
-
-                auto *functionScope = node.symbolTable;
-                auto *globalTable = functionScope->upperScope;
-                while (globalTable->level != 0) {
-                    globalTable = globalTable->upperScope;
-                }
-
-                auto *structEntry = globalTable->lookup(dotParam1->semanticType, "struct");
-                auto *structTable = structEntry->link;
-
-                std::vector<SymbolTableEntry*> matchingFuncEntries = structTable->lookupAll(dotParam2->children[0]->value, "func");
-                // in theory we can have overloaded functions in the inherited struct that aren't actually overridden per se
-                // check local
-                if (!matchingFuncEntries.empty()) {
-                    if (matchingFuncEntries.size() == 1) {
-                        auto *funcEntry = matchingFuncEntries[0];
-                        auto *funcTable = funcEntry->link;
-                        std::vector<SymbolTableEntry*> fparams = funcTable->lookupAllOfKind("param");
-                        if (aparams.size() != fparams.size()) {
-                            symerrors << "12.1 [error] member function call with wrong number of parameters at " << functionScope->name << " " << structTable->name << "::" << funcEntry->name
-                                        << ". Params: ( " << aparamList << ")" << std::endl;
-                            node.semanticType = "errortype";
-                            accept = false;
-                            return;
-                        }
-
-                        bool error = false;
-                        std::vector<std::pair<std::string, std::string>> incorrectParamPairs;
-                        for (int i = 0; i < aparams.size(); i++) {
-                            if (!areTwoVarsTypesEqual(aparams[i]->semanticType, fparams[i]->type)) {
-                                error = true;
-                                incorrectParamPairs.emplace_back(aparams[i]->semanticType, fparams[i]->type);
-                            }
-                        }
-
-                        if (error) {
-                            for (auto aparam : aparams) {
-                                aparamList += aparam->semanticType + " ";
-                            }
-
-                            for (const auto& pair : incorrectParamPairs) {
-                                if (getNumDims(pair.first) != getNumDims(pair.second)) {
-                                    symerrors << "13.3 [error] array parameter (in member function call) using wrong number of dimensions at " << functionScope->name << " " << structTable->name << "::" << funcEntry->name
-                                              << ". Expected: " << pair.second << ", got: " << pair.first << std::endl;
-                                    node.semanticType = "errortype";
-                                    accept = false;
-                                    return;
-                                }
-                            }
-
-                            symerrors << "12.2 [error] member function call with wrong type of parameters at " << functionScope->name << " " << structTable->name << "::" << funcEntry->name
-                                         << ". Params: ( " << aparamList << ")" << std::endl;
-                            node.semanticType = "errortype";
-                            accept = false;
-                            return;
-                        }
-
-                        dotParam2->semanticType = funcEntry->type;
-                        node.semanticType = funcEntry->type;
-                        return;
-                    }
-
-                    for (auto *funcEntry : matchingFuncEntries) {
-                        std::vector<SymbolTableEntry*> fparams = funcEntry->link->lookupAllOfKind("param");
-                        if (aparams.size() != fparams.size()) {
-                            continue;
-                        }
-
-                        for (int i = 0; i < aparams.size(); i++) {
-                            if (!areTwoVarsTypesEqual(aparams[i]->semanticType, fparams[i]->type)) {
-                                break;
-                            }
-                        }
-
-                        // found a match
-                        dotParam2->semanticType = funcEntry->type;
-                        node.semanticType = funcEntry->type;
-                        return;
-                    }
-                }
-
-                // check in inherited
-                std::vector<std::string> inheritNames = structTable->lookupAllNamesOfKind("inherit");
-                if (inheritNames.empty()) {
-                    if (matchingFuncEntries.empty())
-                        symerrors << "11.3 [error] undeclared member function " << dotParam1->semanticType << "::" << dotParam2->children[0]->value << std::endl;
-                    else {
-                        symerrors << "12.2 [error] member function call with wrong type of parameters at " << structTable->name << "::" << dotParam2->children[0]->value
-                                  << ". Params: ( " << aparamList << ")" << std::endl;
-                    }
-                    node.semanticType = "errortype";
-                    accept = false;
-                    return;
-                }
-
-                for (const auto &inheritName : inheritNames) {
-                    auto *inheritedStructEntry = globalTable->lookup(inheritName, "struct");
-                    if (inheritedStructEntry == nullptr) return; // already checked for this
-                    auto *inheritedStructTable = inheritedStructEntry->link;
-                    matchingFuncEntries = inheritedStructTable->lookupAll(dotParam2->children[0]->value, "func");
-                    if (!matchingFuncEntries.empty()) {
-                        break;
-                    }
-
-                    if (matchingFuncEntries.size() == 1) {
-                        auto *funcEntry = matchingFuncEntries[0];
-                        auto *funcTable = funcEntry->link;
-                        std::vector<SymbolTableEntry*> fparams = funcTable->lookupAllOfKind("param");
-                        if (aparams.size() != fparams.size()) {
-                            symerrors << "12.1 [error] inherited member function call with wrong number of parameters at " << structTable->name << "." << inheritedStructTable->name << "::" << dotParam2->children[0]->value
-                                        << ". Params: ( " << aparamList << ")" << std::endl;
-                            node.semanticType = "errortype";
-                            accept = false;
-                            return;
-                        }
-
-                        bool error = false;
-                        for (int i = 0; i < aparams.size(); i++) {
-                            if (trimVariableType(aparams[i]->semanticType) != trimVariableType(fparams[i]->type)) {
-                                error = true;
-                            }
-                        }
+            // is a member function call
+            const ASTChildren &aparams = dotParam2->children[1]->children;
 
-                        if (error) {
-                            symerrors << "12.2 [error] inherited member function call with wrong type of parameters at " << structTable->name << "." << inheritedStructTable->name << "::" <<  dotParam2->children[0]->value
-                                    << ". Params: ( " << aparamList << ")" << std::endl;
-                            node.semanticType = "errortype";
-                            accept = false;
-                            return;
-                        }
+            auto *functionScope = node.symbolTable;
+            auto *globalTable = functionScope->global;
 
-                        dotParam2->semanticType = funcEntry->type;
-                        node.semanticType = funcEntry->type;
-                        return;
-                    }
+            auto *structEntry = globalTable->lookup(objectType, "struct");
+            auto *structTable = structEntry->link;
 
-                    for (auto *funcEntry : matchingFuncEntries) {
-                        std::vector<SymbolTableEntry*> fparams = funcEntry->link->lookupAllOfKind("param");
-                        if (aparams.size() != fparams.size()) {
-                            continue;
-                        }
+            // overloads are looked for in the struct, then in its inherited structs
+            CallResolution resolution = resolveCall(structTable, dotParam2->children[0]->value, aparams);
+            if (resolution.match != nullptr) {
+                static_cast<FunctionCallNode*>(dotParam2)->callee = resolution.match->entry;
+                dotParam2->semanticType = resolution.match->entry->type;
+                node.semanticType = resolution.match->entry->type;
+                return;
+            }
 
-                        for (int i = 0; i < aparams.size(); i++) {
-                            if (trimVariableType(aparams[i]->semanticType) != trimVariableType(fparams[i]->type)) {
-                                break;
-                            }
-                        }
+            node.semanticType = TypeId::errorType();
+            accept = false;
+            if (resolution.candidates == 0) {
+                diags.error("11.3") << "undeclared member function " << objectType << "::" << dotParam2->children[0]->value;
+                return;
+            }
 
-                        // found a match
-                        dotParam2->semanticType = funcEntry->type;
-                        node.semanticType = funcEntry->type;
-                        return;
-                    }
-                }
+            std::string aparamList;
+            for (auto aparam : aparams) {
+                aparamList += aparam->semanticType.str() + " ";
+            }
 
-                if (matchingFuncEntries.empty()) {
-                    symerrors << "11.3 [error] undeclared member function " << dotParam1->semanticType << "::" << dotParam2->children[0]->value << std::endl;
+            if (resolution.nearest == nullptr) {
+                if (resolution.candidates == 1) {
+                    diags.error("12.1") << "member function call with wrong number of parameters at " << functionScope->name << " " << structTable->name << "::" << resolution.first->name
+                              << ". Params: ( " << aparamList << ")";
                 } else {
-
-                    symerrors << "12.2 [error] member function call with wrong type of parameters at " << structTable->name << "::" << dotParam2->children[0]->value
-                              << ". Params: ( " << aparamList << ")" << std::endl;
+                    diags.error("12.2") << "member function call with wrong type of parameters at " << structTable->name << "::" << dotParam2->children[0]->value
+                              << ". Params: ( " << aparamList << ")";
                 }
+                return;
+            }
 
-                node.semanticType = "errortype";
-                accept = false;
+            auto *funcEntry = resolution.nearest->entry;
+            int mismatch = firstDimsMismatch(*resolution.nearest, aparams);
+            if (mismatch >= 0) {
+                diags.error("13.3") << "array parameter (in member function call) using wrong number of dimensions at " << functionScope->name << " " << resolution.scope->name << "::" << funcEntry->name
+                          << ". Expected: " << resolution.nearest->paramTypes[mismatch] << ", got: " << aparams[mismatch]->semanticType;
+            } else {
+                diags.error("12.2") << "member function call with wrong type of parameters at " << functionScope->name << " " << resolution.scope->name << "::" << funcEntry->name
+                          << ". Params: ( " << aparamList << ")";
+            }
         } else {
-            symerrors << "15.1 [error] . operator right hand side is not a member function call or member variable access at " << dotParam1->value << "." << dotParam2->value << std::endl;
-            node.semanticType = "errortype";
+            diags.error("15.1") << ". operator right hand side is not a member function call or member variable access at " << dotParam1->value << "." << dotParam2->value;
+            node.semanticType = TypeId::errorType();
             accept = false;
         }
 
@@ -1608,25 +1446,26 @@ public:
         auto *left = node.children[0];
         // middle is assignop node
         auto *right = node.children[2];
+        TypeId &leftType = node.targetType();
 
-        if (left->semanticType == "errortype" || right->semanticType == "errortype") {
-            node.semanticType = "errortype";
-            symerrors << "10.2 [error] assignment of " << left->semanticType << " to " << right->semanticType << " in " << node.symbolTable->name << std::endl;
+        if (leftType == TypeId::errorType() || right->semanticType == TypeId::errorType()) {
+            node.semanticType = TypeId::errorType();
+            diags.error("10.2") << "assignment of " << leftType << " to " << right->semanticType << " in " << node.symbolTable->name;
             accept = false;
             return;
         }
 
         if (left->type == 22) {
-            variableCheck(*left, symerrors, accept);
+            variableCheck(*left, node.symbolTable, node.target, diags, accept);
         }
 
-        std::string leftSemanticTypeTrimmed = trimVariableType(left->semanticType);
-        std::string rightSemanticTypeTrimmed = trimVariableType(right->semanticType);
+        TypeId leftSemanticTypeTrimmed = trimVariableType(leftType);
+        TypeId rightSemanticTypeTrimmed = trimVariableType(right->semanticType);
 
         if (leftSemanticTypeTrimmed != rightSemanticTypeTrimmed) {
-            symerrors << "10.2 [error] assignment of " << left->semanticType << " to " << right->semanticType << " in " << node.symbolTable->name << std::endl;
+            diags.error("10.2") << "assignment of " << leftType << " to " << right->semanticType << " in " << node.symbolTable->name;
             accept = false;
-            node.semanticType = "errortype";
+            node.semanticType = TypeId::errorType();
         }
     }
 
@@ -1635,10 +1474,10 @@ public:
             child->accept(*this);
         }
 
-        std::string type = node.parent->parent->symbolTableEntry->type;
+        TypeId type = node.parent->parent->symbolTableEntry->type;
 
         if (node.children[0]->semanticType != type) {
-            symerrors << "10.3 [error] return type mismatch " << node.children[0]->semanticType << " and " << type << std::endl;
+            diags.error("10.3") << "return type mismatch " << node.children[0]->semanticType << " and " << type;
             accept = false;
         }
     }
@@ -1657,14 +1496,14 @@ public:
         auto *left = node.children[0];
         auto *right = node.children[1];
 
-        if (left->semanticType == "errortype" || right->semanticType == "errortype") {
-            symerrors << "10.1 [error] type mismatch in addition/subtraction operation " << left->semanticType << " and " << right->semanticType << std::endl;
-            node.semanticType = "errortype";
+        if (left->semanticType == TypeId::errorType() || right->semanticType == TypeId::errorType()) {
+            diags.error("10.1") << "type mismatch in addition/subtraction operation " << left->semanticType << " and " << right->semanticType;
+            node.semanticType = TypeId::errorType();
             accept = false;
             return;
         } else if (left->semanticType != right->semanticType) {
-            symerrors << "10.1 [error] type mismatch in addition/subtraction operation " << left->semanticType << " and " << right->semanticType << std::endl;
-            node.semanticType = "errortype";
+            diags.error("10.1") << "type mismatch in addition/subtraction operation " << left->semanticType << " and " << right->semanticType;
+            node.semanticType = TypeId::errorType();
             accept = false;
         } else {
             node.semanticType = left->semanticType;
@@ -1678,14 +1517,14 @@ public:
 
         auto *left = node.children[0];
         auto *right = node.children[1];
-        if (left->semanticType == "errortype" || right->semanticType == "errortype") {
-            symerrors << "10.1 [error] type mismatch in multiplication/division operation " << left->semanticType << " and " << right->semanticType << std::endl;
-            node.semanticType = "errortype";
+        if (left->semanticType == TypeId::errorType() || right->semanticType == TypeId::errorType()) {
+            diags.error("10.1") << "type mismatch in multiplication/division operation " << left->semanticType << " and " << right->semanticType;
+            node.semanticType = TypeId::errorType();
             accept = false;
             return;
         } else if (left->semanticType != right->semanticType) {
-            symerrors << "10.1 [error] type mismatch in multiplication/division operation " << left->semanticType << " and " << right->semanticType << std::endl;
-            node.semanticType = "errortype";
+            diags.error("10.1") << "type mismatch in multiplication/division operation " << left->semanticType << " and " << right->semanticType;
+            node.semanticType = TypeId::errorType();
             accept = false;
         } else {
             node.semanticType = left->semanticType;
@@ -1700,17 +1539,17 @@ public:
         auto *left = node.children[0];
         auto *right = node.children[2];
 
-        if (left->semanticType == "errortype" || right->semanticType == "errortype") {
-            symerrors << "10.1 [error] type mismatch in relational operation " << left->semanticType << " and " << right->semanticType << std::endl;
-            node.semanticType = "errortype";
+        if (left->semanticType == TypeId::errorType() || right->semanticType == TypeId::errorType()) {
+            diags.error("10.1") << "type mismatch in relational operation " << left->semanticType << " and " << right->semanticType;
+            node.semanticType = TypeId::errorType();
             accept = false;
             return;
         } else if (left->semanticType != right->semanticType) {
-            symerrors << "10.1 [error] type mismatch in relational operation " << left->semanticType << " and " << right->semanticType << std::endl;
-            node.semanticType = "errortype";
+            diags.error("10.1") << "type mismatch in relational operation " << left->semanticType << " and " << right->semanticType;
+            node.semanticType = TypeId::errorType();
             accept = false;
         } else {
-            node.semanticType = "integer";
+            node.semanticType = TypeId::integerType();
         }
 
     }
@@ -1741,8 +1580,9 @@ public:
 
     // now for all the other nodes, we just propagate
     void visit(ProgNode &node) override {
-        for (auto child : node.children) {
-            child->accept(*this);
+        for (size_t i = 0; i < node.children.size() && !diags.limitReached(); i++) {
+            diags.setLocation(i);
+            node.children[i]->accept(*this);
         }
     }
 
@@ -1801,7 +1641,6 @@ public:
     }
 
     void visit(IntlitNode &node) override {
-        node.semanticType = "integer";
         for (auto child : node.children) {
             child->accept(*this);
         }
@@ -1815,6 +1654,8 @@ public:
 
     void visit(VarDeclOrStatBlockNode &node) override {
         for (auto child : node.children) {
+            // a single body can hold thousands of statements, so the error limit is also checked between them
+            if (diags.limitReached()) return;
             child->accept(*this);
         }
     }
@@ -1826,7 +1667,7 @@ public:
     }
 
     void visit(FloatlitNode &node) override {
-        node.semanticType = "float";
+        node.semanticType = TypeId::floatType();
         for (auto child : node.children) {
             child->accept(*this);
         }
@@ -0,0 +1,82 @@
+#ifndef COMPILER_WORKPOOL_HPP
+#define COMPILER_WORKPOOL_HPP
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Work-stealing pool for a fixed batch of independent tasks, identified by their index.
+ * Each worker starts with a contiguous slice of the batch in its own deque and takes work from the back of it ;
+ * once it runs dry it steals from the front of the other workers' deques, so a slice holding a few long function
+ * bodies does not leave the other workers idle.
+ * */
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned workers) : workers(workers == 0 ? 1 : workers) {}
+
+    void run(size_t taskCount, const std::function<void(size_t)> &task) {
+        std::vector<std::unique_ptr<WorkQueue>> queues;
+        for (unsigned w = 0; w < workers; w++) {
+            queues.emplace_back(new WorkQueue());
+        }
+        for (size_t i = 0; i < taskCount; i++) {
+            queues[i * workers / taskCount]->tasks.push_back(i);
+        }
+
+        std::vector<std::thread> threads;
+        for (unsigned w = 1; w < workers; w++) {
+            threads.emplace_back([&, w] { work(queues, w, task); });
+        }
+        work(queues, 0, task);
+
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    unsigned workers;
+
+    /* no task spawns other tasks, so a worker that finds every queue empty is done */
+    static void work(std::vector<std::unique_ptr<WorkQueue>> &queues, unsigned self, const std::function<void(size_t)> &task) {
+        size_t index;
+        while (take(*queues[self], false, index) || steal(queues, self, index)) {
+            task(index);
+        }
+    }
+
+    static bool steal(std::vector<std::unique_ptr<WorkQueue>> &queues, unsigned self, size_t &index) {
+        for (size_t offset = 1; offset < queues.size(); offset++) {
+            if (take(*queues[(self + offset) % queues.size()], true, index)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool take(WorkQueue &queue, bool front, size_t &index) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        if (front) {
+            index = queue.tasks.front();
+            queue.tasks.pop_front();
+        } else {
+            index = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        return true;
+    }
+};
+
+#endif //COMPILER_WORKPOOL_HPP
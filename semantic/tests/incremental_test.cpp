@@ -0,0 +1,114 @@
+#include<gtest/gtest.h>
+#include<incremental.hpp>
+#include<sstream>
+
+static std::map<TableKey, ProductionRule> &grammarTable() {
+    static std::map<TableKey, ProductionRule> TT;
+    if (TT.empty()) {
+        parseCSVIntoTT(GRAMMAR_TABLE, TT);
+    }
+    return TT;
+}
+
+static ASTNode *parseSource(const std::string &source, std::shared_ptr<LeafPool> leaves) {
+    std::ofstream devnull("/dev/null");
+    Lexer lexer = lexerNew(source.c_str());
+    ASTNode *root = parse(lexer, grammarTable(), devnull, devnull, devnull, ASTDumpNone, std::move(leaves));
+    lexerFree(&lexer);
+    return root;
+}
+
+static const char *FIRST_VERSION = R"(
+struct POINT {
+    public let x: integer;
+    public let y: integer;
+    public func m() -> integer;
+};
+struct BASE {
+    public let b: integer;
+};
+struct DERIVED inherits BASE {
+    public let d: integer;
+};
+impl POINT {
+    func m() -> integer {
+        return (x + y);
+    }
+}
+func helper(n: integer) -> integer {
+    return (n + 1);
+}
+func main() -> void {
+    let q: POINT;
+    let e: DERIVED;
+    let r: integer;
+    q.x = 1;
+    e.b = 2;
+    r = q.m() + helper(e.b);
+    write(r);
+}
+)";
+
+static std::string edit(std::string source, const std::string &from, const std::string &to) {
+    size_t at = source.find(from);
+    EXPECT_NE(at, std::string::npos) << from;
+    return at == std::string::npos ? source : source.replace(at, from.size(), to);
+}
+
+/* successive versions go through one session, sharing their leaves as in a watch session */
+class IncrementalAnalysisTest : public ::testing::Test {
+protected:
+    std::shared_ptr<LeafPool> leaves = std::make_shared<LeafPool>();
+    IncrementalAnalysis session;
+    std::string log;
+
+    /* analyses the next version, and a fresh copy of it with semanticAnalysis ; the outputs must be the same */
+    void expectSameAsFresh(const std::string &source) {
+        ASTNode *next = parseSource(source, leaves);
+        ASSERT_NE(next, nullptr);
+        std::ostringstream symfile, symerrors, sessionLog;
+        bool accepted = session.analyse(next, symfile, symerrors, sessionLog);
+        log = sessionLog.str();
+
+        ASTNode *fresh = parseSource(source, nullptr);
+        ASSERT_NE(fresh, nullptr);
+        std::ostringstream freshSymfile, freshSymerrors;
+        bool freshAccepted = semanticAnalysis(*fresh, freshSymfile, freshSymerrors);
+        delete fresh;
+
+        EXPECT_EQ(accepted, freshAccepted);
+        EXPECT_EQ(symfile.str(), freshSymfile.str());
+        EXPECT_EQ(symerrors.str(), freshSymerrors.str());
+    }
+};
+
+TEST_F(IncrementalAnalysisTest, EditSequenceMatchesFreshAnalysis) {
+    std::string first = FIRST_VERSION;
+    expectSameAsFresh(first);
+
+    // body-only edit of a method main calls through q.m()
+    std::string body = edit(first, "return (x + y);", "return (x * y + 1);");
+    expectSameAsFresh(body);
+    EXPECT_NE(log.find("re-analysed impl POINT"), std::string::npos) << log;
+    EXPECT_NE(log.find("reused      func main"), std::string::npos) << log;
+
+    std::string member = edit(body, "public let y: integer;", "public let y: float;");
+    expectSameAsFresh(member);
+
+    std::string header = edit(member, "func helper(n: integer) -> integer", "func helper(n: integer, k: integer) -> integer");
+    expectSameAsFresh(header);
+
+    std::string inherits = edit(header, "struct DERIVED inherits BASE", "struct DERIVED");
+    expectSameAsFresh(inherits);
+
+    expectSameAsFresh(first);
+}
+
+TEST_F(IncrementalAnalysisTest, VersionWithOtherLeavesIsAnalysedWhole) {
+    std::string first = FIRST_VERSION;
+    expectSameAsFresh(first);
+
+    leaves = std::make_shared<LeafPool>();
+    expectSameAsFresh(first);
+    EXPECT_EQ(log.find("reused"), std::string::npos) << log;
+}